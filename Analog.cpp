@@ -0,0 +1,152 @@
+/*
+ * Interrupt-driven multi-channel ADC scheduler
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Analog.h"
+
+
+AnalogClass Analog;
+
+
+int8_t AnalogClass::add (uint8_t pin, uint8_t period, uint8_t priority) {
+  Channel_s *c;
+
+  if (numChannels >= ANALOG_MAX_CHANNELS) return -1;
+  if (pin >= A0) pin -= A0;
+
+  c = &ch[numChannels];
+  c->mux       = _BV(REFS0) | (pin & 0x07);  // AVcc reference
+  c->period    = period > 0 ? period : 1;
+  c->priority  = priority;
+  c->threshold = -1;
+  c->countdown = 0;
+  c->head      = 0;
+  c->count     = 0;
+  c->lowFlag   = false;
+
+  return numChannels++;
+}
+
+
+void AnalogClass::setThreshold (uint8_t chan, int16_t threshold) {
+  cli ();
+  ch[chan].threshold = threshold;
+  ch[chan].lowFlag   = false;
+  sei ();
+}
+
+
+void AnalogClass::start (void) {
+  uint8_t i;
+
+  ADCSRA = 0;
+  // discard the stale samples
+  for (i = 0; i < numChannels; i++) {
+    ch[i].countdown = 0;
+    ch[i].count     = 0;
+    ch[i].lowFlag   = false;
+  }
+  select ();
+  ADCSRB = _BV(ADTS2);   // auto-trigger source: Timer0 overflow
+  // enable the ADC with auto-trigger and interrupt, prescaler 128 (conversion time 104 µs at 16 MHz)
+  ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADIF) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+
+void AnalogClass::stop (void) {
+  ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+  while (ADCSRA & _BV(ADSC));  // wait for an ongoing conversion to finish
+  ADCSRA |= _BV(ADIF);
+  ADCSRB  = 0;
+  current = 0xFF;
+}
+
+
+int16_t AnalogClass::read (uint8_t chan) {
+  Channel_s *c = &ch[chan];
+  int16_t val = -1;
+
+  cli ();
+  if (c->count > 0) {
+    val = c->buf[c->head];
+    c->head = (c->head + 1) & (ANALOG_BUFFER_SIZE - 1);
+    c->count--;
+  }
+  sei ();
+  return val;
+}
+
+
+bool AnalogClass::low (uint8_t chan) {
+  bool rv;
+  cli ();
+  rv = ch[chan].lowFlag;
+  ch[chan].lowFlag = false;
+  sei ();
+  return rv;
+}
+
+
+void AnalogClass::select (void) {
+  uint8_t i, next = 0xFF;
+
+  for (i = 0; i < numChannels; i++) {
+    if (ch[i].countdown > 0) ch[i].countdown--;
+    if (ch[i].countdown == 0 && (next == 0xFF || ch[i].priority < ch[next].priority)) next = i;
+  }
+
+  // the new channel selection takes effect upon the next trigger
+  current = next;
+  if (next != 0xFF) {
+    ADMUX = ch[next].mux;
+    ch[next].countdown = ch[next].period;
+  }
+}
+
+
+void AnalogClass::isrHandler (void) {
+  int16_t val = ADC;
+  Channel_s *c;
+
+  if (current != 0xFF) {
+    c = &ch[current];
+    // overwrite the oldest sample if the buffer is full
+    if (c->count >= ANALOG_BUFFER_SIZE) {
+      c->head = (c->head + 1) & (ANALOG_BUFFER_SIZE - 1);
+      c->count--;
+      overruns++;
+    }
+    c->buf[(c->head + c->count) & (ANALOG_BUFFER_SIZE - 1)] = val;
+    c->count++;
+    if (val < c->threshold) c->lowFlag = true;
+  }
+
+  select ();
+}
+
+
+ISR (ADC_vect) {
+  Analog.isrHandler ();
+}
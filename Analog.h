@@ -0,0 +1,140 @@
+/*
+ * Interrupt-driven multi-channel ADC scheduler
+ *
+ * The conversions are auto-triggered by the Timer0 overflow (every 1.024 ms),
+ * the ADC ISR stores each result into the ring buffer of its channel and
+ * selects the next channel that is due according to the sample periods and
+ * priorities, such that the sampling does not depend on the main loop speed.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ANALOG_H
+#define __ANALOG_H
+
+#include <Arduino.h>
+
+/*
+ * Maximum number of analog channels
+ */
+#define ANALOG_MAX_CHANNELS 6
+
+/*
+ * Number of samples held by the ring buffer of every channel (power of two)
+ */
+#define ANALOG_BUFFER_SIZE  4
+
+
+/*
+ * Analog channel scheduler class
+ */
+class AnalogClass {
+
+  public:
+
+    /*
+     * Register an analog channel
+     * must be called before start()
+     * Parameters:
+     *   pin      : analog pin (A0..A7)
+     *   period   : sample period in Timer0 overflows (~ms)
+     *   priority : 0 is the highest priority, resolves the conflicts between channels that are due at the same time
+     * Return value:
+     *   channel index, -1 if no more channels are available
+     */
+    int8_t add (uint8_t pin, uint8_t period, uint8_t priority);
+
+    /*
+     * Set a low threshold for a channel
+     * the ISR latches the low flag as soon as a sample falls below the threshold
+     * Parameters:
+     *   chan      : channel index
+     *   threshold : ADC value (0..1023), -1 disables the threshold
+     */
+    void setThreshold (uint8_t chan, int16_t threshold);
+
+    /*
+     * Start the auto-triggered conversions
+     * the ADC reference is set to AVcc
+     */
+    void start (void);
+
+    /*
+     * Stop the auto-triggered conversions
+     * must be called before using analogRead()
+     */
+    void stop (void);
+
+    /*
+     * Number of unread samples of a channel
+     */
+    uint8_t available (uint8_t chan) { return ch[chan].count; }
+
+    /*
+     * Read the oldest unread sample of a channel
+     * Return value:
+     *   ADC value (0..1023), -1 if no sample is available
+     */
+    int16_t read (uint8_t chan);
+
+    /*
+     * Check and clear the low flag of a channel
+     */
+    bool low (uint8_t chan);
+
+    /*
+     * Number of samples that have been overwritten before being read
+     */
+    volatile uint16_t overruns = 0;
+
+    /*
+     * Conversion complete handler
+     * Must be called from within the ADC ISR
+     */
+    void isrHandler (void);
+
+  private:
+    void select (void);         // select the channel of the next conversion
+    struct Channel_s {
+      uint8_t mux;              // ADMUX channel selection bits
+      uint8_t period;           // sample period in Timer0 overflows
+      uint8_t priority;         // 0 = highest priority
+      int16_t threshold;        // low threshold, -1 if disabled
+      volatile uint8_t countdown;  // Timer0 overflows until the next sample is due
+      volatile uint8_t head;       // index of the oldest sample
+      volatile uint8_t count;      // number of unread samples
+      volatile bool    lowFlag;    // a sample has fallen below the threshold
+      volatile int16_t buf[ANALOG_BUFFER_SIZE];
+    } ch[ANALOG_MAX_CHANNELS];
+    uint8_t numChannels = 0;
+    volatile uint8_t current = 0xFF;  // channel of the ongoing conversion, 0xFF if none
+};
+
+
+/*
+ * Analog channel scheduler object as a singleton
+ */
+extern AnalogClass Analog;
+
+
+#endif // __ANALOG_H
@@ -27,7 +27,7 @@
 #include "Brightness.h"
 #include <EEPROM.h>
 #include <assert.h>
-#include "src/Nvm/Nvm.h"
+#include "EepromQueue.h"
 
 
 #define PWM_STEPS 100
@@ -48,8 +48,9 @@ void BrightnessClass::initialize (uint16_t eepromAddr, uint8_t boostPin) {
   this->boostEnabled = false;
   this->autoEnabled = false;
   this->lutIdx = 0;
+  this->levelSeeded = false;
 
-  ::eepromRead (eepromAddr, (uint8_t *)lut, sizeof(lut));
+  EepromQueue.read (eepromAddr, (uint8_t *)lut, sizeof(lut));
 }
 
 
@@ -58,10 +59,12 @@ void BrightnessClass::initializeLut (void) {
   for (i = 0; i < sizeof(lut); i++) {
     lut[i] = PWM_STEPS - 1;
   }
+  lutChanged = true;
 }
 
 
 void BrightnessClass::autoEnable (bool enable) {
+  if (enable != autoEnabled) levelSeeded = false;  // jump to the new target instead of fading in
   this->autoEnabled = enable;
   if (!enable) lutIdx = 0;
 }
@@ -80,11 +83,34 @@ void BrightnessClass::boostDeactivate (void) {
 
 
 uint8_t BrightnessClass::lightSensorUpdate (int16_t value) {
-  if (autoEnabled) lutIdx = map (value, 0, 1023, 1, BRIGHTNESS_LUT_SIZE - 1); // index 0 is used for disabled auto brightness
-  else             lutIdx = 0;
-  //Serial.print ("lutIdx = ");
-  //Serial.println (lutIdx, DEC);
-  return boost (lut[lutIdx]);
+  uint16_t pos, target;
+  uint8_t idx, frac, val;
+
+  if (autoEnabled) {
+    // position between the LUT elements 1..63 in 8.8 fixed-point (index 0 is used for disabled auto brightness)
+    pos  = ((uint16_t)value * (BRIGHTNESS_LUT_SIZE - 2)) >> 2;
+    idx  = 1 + (pos >> 8);
+    frac = pos & 0xFF;
+    target = (uint16_t)lut[idx] * (256 - frac) + (uint16_t)lut[idx + 1] * frac;
+    lutIdx = idx + (frac >> 7);  // nearest element for the manual adjustment
+  }
+  else {
+    target = (uint16_t)lut[0] << 8;
+    lutIdx = 0;
+  }
+
+  // limit the rate of change, starting from the first target value
+  if (!levelSeeded) {
+    level = target;
+    levelSeeded = true;
+  }
+  if      (target > level + BRIGHTNESS_SLEW) level += BRIGHTNESS_SLEW;
+  else if (level > target + BRIGHTNESS_SLEW) level -= BRIGHTNESS_SLEW;
+  else                                       level  = target;
+
+  val = boost (level >> 8);
+  fraction = val < PWM_STEPS - 1 ? level & 0xFF : 0;
+  return val;
 }
 
 
@@ -99,6 +125,8 @@ uint8_t BrightnessClass::increase (void) {
   }
   lut[lutIdx] = (uint8_t)val;
   if (autoEnabled) interpolate ();
+  lutChanged = true;
+  level = (uint16_t)lut[lutIdx] << 8;
   return boost (lut[lutIdx]);
 }
 
@@ -109,6 +137,8 @@ uint8_t BrightnessClass::decrease (void) {
   if (val < 0) val = 0;
   lut[lutIdx] = (uint8_t)val;
   if (autoEnabled) interpolate ();
+  lutChanged = true;
+  level = (uint16_t)lut[lutIdx] << 8;
   return boost (lut[lutIdx]);
 }
 
@@ -159,5 +189,7 @@ uint8_t BrightnessClass::maximum (void) {
 
 
 void BrightnessClass::eepromWrite (void) {
-  ::eepromWrite (eepromAddr, (uint8_t *)lut, sizeof(lut));
+  if (!lutChanged) return;
+  EepromQueue.write (eepromAddr, (uint8_t *)lut, sizeof(lut));
+  lutChanged = false;
 }
@@ -34,6 +34,11 @@
  */
 #define BRIGHTNESS_LUT_SIZE 64                   
 
+/*
+ * Maximum brightness change per light sensor update in 1/256 steps
+ */
+#define BRIGHTNESS_SLEW 64
+
 
 /*
  * Brightness adjustment class
@@ -77,10 +82,11 @@ class BrightnessClass {
 
     /*
      * Apply new value from light sensor 
+     * interpolates between the LUT elements and limits the rate of change to BRIGHTNESS_SLEW
      * Parameters: 
      *   value : light sensor value [0..1023] (0 = brightest, 1023 = darkest)
      * Returns:
-     *   brightness value [0..99]
+     *   brightness value [0..99], the fractional part is stored in fraction
      */
     uint8_t lightSensorUpdate (int16_t value);
 
@@ -108,8 +114,14 @@ class BrightnessClass {
 
     /*
      * Write-back the lookup table into EEPROM
+     * has no effect if the lookup table has not been changed
      */
     void eepromWrite (void);
+
+    /*
+     * Fractional part of the last brightness value returned by lightSensorUpdate() in 1/256 steps
+     */
+    uint8_t fraction = 0;
     
     
   private:
@@ -120,7 +132,10 @@ class BrightnessClass {
     bool boostEnabled;                          // enables the boost feature
     bool autoEnabled;                           // enables the auto brightness feature
     uint8_t lutIdx;                             // index of the brightness LUT element
+    uint16_t level = 0;                         // current LUT value after slew-rate limiting (8.8 fixed-point)
+    bool levelSeeded = false;                   // level has been set to the first target value
     uint8_t lut[BRIGHTNESS_LUT_SIZE] = { 0 };   // brightness lookup table    
+    bool lutChanged = false;                    // the LUT differs from its EEPROM copy
   
 };
 
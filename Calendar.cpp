@@ -0,0 +1,143 @@
+/*
+ * Calendar arithmetics and daylight saving time rule
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Calendar.h"
+#include "Progmem.h"
+
+
+CalendarClass Calendar;
+
+
+/*
+ * Length of a month in a common year (31 days for odd months until July, then for even months)
+ */
+static constexpr uint8_t monthDays (uint8_t mon) {
+  return mon == 1 ? 28 : 30 + (((mon + 1) + ((mon + 1) >> 3)) & 1);
+}
+
+/*
+ * Days of a common year preceding a month
+ */
+static constexpr uint16_t monthStart (uint8_t mon) {
+  return mon == 0 ? 0 : monthStart (mon - 1) + monthDays (mon - 1);
+}
+
+static_assert (monthStart (12) == 365 && monthStart (2) == 59 && monthDays (7) == 31, "month table generator");
+
+/*
+ * Month offset table generated at compile time (index 12 holds the length of a common year)
+ */
+static const uint16_t monthOffset[13] PROGMEM = {
+  monthStart (0), monthStart (1), monthStart (2),  monthStart (3),  monthStart (4),  monthStart (5), monthStart (6),
+  monthStart (7), monthStart (8), monthStart (9),  monthStart (10), monthStart (11), monthStart (12)
+};
+
+
+bool CalendarClass::leapYear (int16_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+
+uint8_t CalendarClass::monthLength (int16_t year, uint8_t mon) {
+  return progmemRead (&monthOffset[mon + 1]) - progmemRead (&monthOffset[mon]) + (mon == 1 && leapYear (year));
+}
+
+
+uint16_t CalendarClass::dayOfYear (int16_t year, uint8_t mon, uint8_t mday) {
+  return progmemRead (&monthOffset[mon]) + (mon > 1 && leapYear (year)) + mday - 1;
+}
+
+
+int32_t CalendarClass::days (int16_t year, uint8_t mon, uint8_t mday) {
+  int16_t y = year - 2000;
+
+  // leap years within [2000, year), 2000 itself is a leap year
+  return (int32_t)y * 365 + (y + 3) / 4 - (y + 99) / 100 + (y + 399) / 400 + dayOfYear (year, mon, mday);
+}
+
+
+uint8_t CalendarClass::isoWeeks (int16_t year) {
+  // week day of December 31st (0 = Sunday) of the given and of the previous year
+  uint8_t p  = (year + year / 4 - year / 100 + year / 400) % 7;
+  uint8_t p1 = ((year - 1) + (year - 1) / 4 - (year - 1) / 100 + (year - 1) / 400) % 7;
+  return (p == 4 || p1 == 3) ? 53 : 52;
+}
+
+
+void CalendarClass::update (const tm *t, uint8_t weekStart) {
+  int16_t year = t->tm_year + 1900;
+  int16_t yday = dayOfYear (year, t->tm_mon, t->tm_mday);
+  uint8_t wday = (days (year, t->tm_mon, t->tm_mday) + 6) % 7;  // January 1st 2000 was a Saturday
+  int16_t w;
+  uint8_t rel;
+
+  weekDay = (wday == 0 ? 7 : wday);
+
+  // ISO 8601: week 1 contains the first Thursday of the year
+  if (weekStart == 1) {
+    w = (yday + 1 - weekDay + 10) / 7;
+    if      (w < 1)               w = isoWeeks (year - 1);
+    else if (w > isoWeeks (year)) w = 1;
+  }
+  // week 1 contains January 1st, the following weeks begin on weekStart
+  else {
+    rel  = (wday + 7 - weekStart % 7) % 7;  // day index within the current week
+    rel  = (rel + 7 - yday % 7) % 7;        // day index of January 1st within its week
+    w    = (yday + rel) / 7 + 1;
+  }
+  week = (int8_t)w;
+}
+
+
+time_t CalendarClass::lastSunday (int16_t year, uint8_t mon) {
+  int32_t d = days (year, mon, monthLength (year, mon));
+  d -= (d + 6) % 7;
+  return (time_t)d * ONE_DAY + ONE_HOUR;
+}
+
+
+bool CalendarClass::dstUpdate (time_t utc) {
+  int32_t d = utc / ONE_DAY;
+  int16_t year = 2000 + d * 4 / 1461;  // exact until 2099, corrected below otherwise
+  time_t start, end;
+
+  if (d < days (year)) year--;
+  else if (d >= days (year + 1)) year++;
+
+  start = lastSunday (year, 2);
+  end   = lastSunday (year, 9);
+
+  if (utc < start) {
+    dstNext = start;
+    return false;
+  }
+  if (utc < end) {
+    dstNext = end;
+    return true;
+  }
+  dstNext = lastSunday (year + 1, 2);
+  return false;
+}
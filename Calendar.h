@@ -0,0 +1,101 @@
+/*
+ * Calendar arithmetics and daylight saving time rule
+ *
+ * The day counts are derived from a month offset table that is generated
+ * at compile time, the calendar week and the week day are computed in
+ * closed form once per day rather than upon every display request.
+ * The daylight saving time follows the European Union rule (last Sunday
+ * of March and October at 01:00 UTC), the next transition instant is
+ * precomputed such that the rule is only evaluated upon the transition
+ * or after a time jump. The rule is only valid for the European time
+ * zones and serves as a fallback until a DCF77 DST flag is received.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CALENDAR_H
+#define __CALENDAR_H
+
+#include <Arduino.h>
+#include <time.h>
+
+/*
+ * Range of time zones (UTC offset in hours) following the EU daylight saving time rule
+ * (WET, CET and EET)
+ */
+#define CALENDAR_DST_ZONE_MIN 0
+#define CALENDAR_DST_ZONE_MAX 2
+
+
+/*
+ * Calendar class
+ * years are given in full (e.g. 2023), months as 0..11 and month days as 1..31
+ */
+class CalendarClass {
+
+  public:
+
+    /*
+     * Recompute the week day and the calendar week
+     * must be called upon the change of the date or of the week start day
+     * Parameters:
+     *   t         : local time
+     *   weekStart : first day of a calendar week (1 = Monday, 7 = Sunday),
+     *               weeks starting on Monday are numbered according to ISO 8601
+     */
+    void update (const tm *t, uint8_t weekStart);
+
+    /*
+     * Evaluate the EU daylight saving time rule and precompute the next transition
+     * Parameters:
+     *   utc : current UTC time
+     * Return value:
+     *   true if daylight saving time is active
+     */
+    bool dstUpdate (time_t utc);
+
+    int8_t  week    = 1;  // calendar week of the current day (1..53)
+    uint8_t weekDay = 1;  // week day of the current day (1 = Monday, 7 = Sunday)
+    time_t  dstNext = 0;  // UTC time of the next daylight saving time transition
+
+    /*
+     * Calendar helpers
+     */
+    static bool     leapYear (int16_t year);
+    static uint8_t  monthLength (int16_t year, uint8_t mon);
+    static uint16_t dayOfYear (int16_t year, uint8_t mon, uint8_t mday);  // 0 = January 1st
+    static int32_t  days (int16_t year, uint8_t mon = 0, uint8_t mday = 1);  // days since January 1st 2000
+    static uint8_t  isoWeeks (int16_t year);  // number of ISO 8601 weeks in a year (52 or 53)
+
+  private:
+    static time_t lastSunday (int16_t year, uint8_t mon);  // 01:00 UTC on the last Sunday of a month
+};
+
+
+/*
+ * Calendar object as a singleton
+ */
+extern CalendarClass Calendar;
+
+
+#endif // __CALENDAR_H
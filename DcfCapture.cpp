@@ -0,0 +1,89 @@
+/* 
+ * DCF77 second edge capture
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DcfCapture.h"
+#include "DcfStream.h"
+
+
+DcfCaptureClass DcfCapture;
+
+
+void DcfCaptureClass::initialize (uint8_t dcfPin, uint8_t startEdge) {
+  pin        = dcfPin;
+  startLevel = (startEdge == FALLING) ? LOW : HIGH;
+  captured   = false;
+  cli ();
+  *digitalPinToPCMSK (pin) |= _BV(digitalPinToPCMSKbit (pin));
+  PCIFR |= _BV(digitalPinToPCICRbit (pin));
+  PCICR |= _BV(digitalPinToPCICRbit (pin));
+  sei ();
+}
+
+
+void DcfCaptureClass::secondTick (void) {
+  tickUs = micros ();
+}
+
+
+void DcfCaptureClass::isrHandler (void) {
+  uint32_t ts = micros ();
+
+  // only consider the start edges that follow a long enough unmodulated carrier
+  if (digitalRead (pin) == startLevel) {
+    if (ts - changeUs >= DCF_CAPTURE_MIN_IDLE) {
+      edgeUs    = ts;
+      edgePhase = ts - tickUs;
+      edgeTime  = time (NULL);
+      captured  = true;
+      DcfStream.start (ts);
+    }
+  }
+  else {
+    DcfStream.stop (ts);
+  }
+  changeUs = ts;
+}
+
+
+bool DcfCaptureClass::read (time_t *sysTime, uint32_t *phaseUs, uint32_t maxAge) {
+  bool rv;
+
+  cli ();
+  rv       = captured && micros () - edgeUs <= maxAge;
+  *sysTime = edgeTime;
+  *phaseUs = edgePhase;
+  sei ();
+
+  return rv;
+}
+
+
+/*
+ * Pin change interrupt of PORTD
+ */
+ISR (PCINT2_vect) {
+  DcfCapture.isrHandler ();
+}
@@ -0,0 +1,100 @@
+/* 
+ * DCF77 second edge capture
+ *
+ * Timestamps the DCF77 second edges with a resolution of a few µs
+ * relative to the system second tick using the pin change interrupt.
+ * Feeds the pulses into the streaming decoder (see DcfStream.h).
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DCF_CAPTURE_H
+#define __DCF_CAPTURE_H
+
+#include <Arduino.h>
+#include <time.h>
+
+/*
+ * Minimum duration in µs of the unmodulated carrier preceding a valid second edge
+ * shorter intervals are considered as noise
+ */
+#define DCF_CAPTURE_MIN_IDLE 700000
+
+
+/*
+ * DCF77 second edge capture class
+ */
+class DcfCaptureClass {
+
+  public:
+
+    /*
+     * Initialize the pin change interrupt
+     * Parameters:
+     *   dcfPin    : DCF77 receiver pin, must be located on PORTD
+     *   startEdge : FALLING/RISING edge marking the beginning of a DCF77 second
+     */
+    void initialize (uint8_t dcfPin, uint8_t startEdge);
+
+    /*
+     * Stamp the beginning of a system second
+     * Must be called from within the Timer1 ISR after incrementing the system time
+     */
+    void secondTick (void);
+
+    /*
+     * Pin change handler
+     * Must be called from within the PCINT2 ISR
+     */
+    void isrHandler (void);
+
+    /*
+     * Retrieve the latest DCF77 second edge
+     * Parameters:
+     *   sysTime : returns the system time at the moment of the edge
+     *   phaseUs : returns the µs elapsed between the system second tick and the edge
+     *   maxAge  : maximum age of the edge in µs
+     * Return value:
+     *   true if a recent enough edge has been captured
+     */
+    bool read (time_t *sysTime, uint32_t *phaseUs, uint32_t maxAge);
+
+  private:
+    uint8_t pin;
+    uint8_t startLevel;                // pin level following a start edge
+    volatile uint32_t tickUs = 0;      // micros () at the last system second tick
+    volatile uint32_t changeUs = 0;    // micros () at the last pin change
+    volatile uint32_t edgeUs = 0;      // micros () at the last valid start edge
+    volatile uint32_t edgePhase = 0;   // µs between the system second tick and the last valid start edge
+    volatile time_t   edgeTime = 0;    // system time at the last valid start edge
+    volatile bool     captured = false;
+};
+
+
+/*
+ * DCF77 second edge capture object as a singleton
+ */
+extern DcfCaptureClass DcfCapture;
+
+
+#endif // __DCF_CAPTURE_H
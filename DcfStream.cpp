@@ -0,0 +1,327 @@
+/* 
+ * Streaming DCF77 frame decoder
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DcfStream.h"
+
+
+DcfStreamClass DcfStream;
+
+
+/*
+ * Pulse width limits in µs
+ */
+#define PULSE_MIN_0  40000   // bit value 0 (100 ms)
+#define PULSE_MAX_0  140000
+#define PULSE_MIN_1  160000  // bit value 1 (200 ms)
+#define PULSE_MAX_1  260000
+
+/*
+ * Gap lengths between two pulse starts in µs
+ */
+#define PULSE_GAP_HALF 500000  // at least half a second to the next pulse
+#define MARK_MIN_GAP 1500000    // minute mark (missing pulse of second 59)
+#define MARK_MAX_GAP 2500000
+#define MARK_MAX_PHASE 3000000  // deviation of the minute marks from whole minutes
+
+/*
+ * Position of the special bits within the telegram
+ */
+#define BIT_CEST     17
+#define BIT_CET      18
+#define BIT_LEAP     19  // leap second announcement, not predictable
+#define BIT_START    20
+#define BIT_MINUTE   21
+#define BIT_HOUR     29
+#define BIT_DAY      36
+#define BIT_WDAY     42
+#define BIT_MONTH    45
+#define BIT_YEAR     50
+#define BIT_P3       58
+
+#define VOTE(IDX) vote[(IDX) - DCF_STREAM_FIRST_BIT]
+
+
+void DcfStreamClass::start (uint32_t ts) {
+  uint32_t gap = ts - startUs, phase;
+  uint8_t i, idx = 0;
+  bool mark, complete = false;
+
+  startUs = ts;
+  markElapsed = (markElapsed > UINT32_MAX - gap) ? UINT32_MAX : markElapsed + gap;
+  pulse   = true;
+
+  // a gap of two seconds is either the minute mark or a missing pulse
+  mark = gap >= MARK_MIN_GAP && gap < MARK_MAX_GAP;
+
+  // advance the second index, accounting for the missing pulses
+  if (secIdx != 0xFF) {
+    idx = secIdx;
+    while (gap >= PULSE_GAP_HALF && idx <= DCF_STREAM_NUM_BITS + 1) {
+      gap -= gap < 1000000 ? gap : 1000000;  // a start edge up to half a second early
+      idx++;
+    }
+    // the signal has been lost beyond the end of the minute
+    if (gap >= PULSE_GAP_HALF) {
+      idx    = 0;
+      secIdx = 0xFF;
+    }
+    // the minute mark is expected 60 s after the previous one (second 59 carries no pulse),
+    // the pulse of second 0 may be missing as well
+    else if (idx == DCF_STREAM_NUM_BITS + 1 || idx == DCF_STREAM_NUM_BITS + 2) {
+      complete = true;
+      mark     = true;
+      idx     -= DCF_STREAM_NUM_BITS + 1;
+    }
+    // a pulse during second 59 contradicts the assumed minute mark,
+    // restart from this pulse if it might be the actual minute mark
+    else if (idx >= DCF_STREAM_NUM_BITS) {
+      idx    = 0;
+      secIdx = 0xFF;
+    }
+    // a two seconds gap inside the minute is a missing pulse
+    else {
+      mark   = false;
+      secIdx = idx;
+    }
+  }
+
+  if (mark) {
+    // complete the telegram of the last minute
+    if (complete && !frameReady) {
+      for (i = 0; i < 8; i++) {
+        frameBits[i]  = rxBits[i];
+        frameValid[i] = rxValid[i];
+      }
+      frameElapsed = markElapsed - idx * 1000000UL;
+      frameDelay   = idx;
+      frameReady   = true;
+      // a missing pulse taken for the minute mark while resynchronizing puts the minute
+      // marks out of phase, the votes cannot be aligned and are discarded by predict ()
+      phase = frameElapsed % 60000000UL;
+      if (phase > MARK_MAX_PHASE && phase < 60000000UL - MARK_MAX_PHASE) frameElapsed = UINT32_MAX;
+      markElapsed  = idx * 1000000UL;
+    }
+    for (i = 0; i < 8; i++) rxBits[i] = rxValid[i] = 0;
+    secIdx = idx;
+  }
+}
+
+
+void DcfStreamClass::stop (uint32_t ts) {
+  uint32_t width = ts - startUs;
+  uint8_t mask;
+
+  if (!pulse) return;
+  pulse = false;
+  if (secIdx >= DCF_STREAM_NUM_BITS) return;
+
+  mask = 1 << (secIdx & 7);
+  if (width >= PULSE_MIN_0 && width < PULSE_MAX_0) {
+    rxValid[secIdx >> 3] |= mask;
+  }
+  else if (width >= PULSE_MIN_1 && width < PULSE_MAX_1) {
+    rxValid[secIdx >> 3] |= mask;
+    rxBits[secIdx >> 3]  |= mask;
+  }
+}
+
+
+uint8_t DcfStreamClass::getTime (void) {
+  uint8_t bits[8], valid[8], i;
+  uint32_t elapsed;
+  int8_t *v;
+
+  if (!frameReady) return 1;
+
+  cli ();
+  for (i = 0; i < 8; i++) {
+    bits[i]  = frameBits[i];
+    valid[i] = frameValid[i];
+  }
+  elapsed    = frameElapsed;
+  markDelay  = frameDelay;
+  frameReady = false;
+  sei ();
+
+  // align the votes of the previous minutes, then add the new telegram
+  predict (elapsed);
+  for (i = DCF_STREAM_FIRST_BIT; i < DCF_STREAM_NUM_BITS; i++) {
+    if (!getBit (valid, i)) continue;
+    v = &VOTE (i);
+    if (getBit (bits, i)) { if (*v <  DCF_STREAM_VOTE_MAX) (*v)++; }
+    else               { if (*v > -DCF_STREAM_VOTE_MAX) (*v)--; }
+  }
+
+  if (!decode (&currentTm, &cest)) {
+    confidence = 0;
+    return 2;
+  }
+  if (confidence < DCF_STREAM_MIN_VOTES) return 2;
+  return 0;
+}
+
+
+void DcfStreamClass::reset (void) {
+  uint8_t i;
+  for (i = 0; i < DCF_STREAM_NUM_BITS - DCF_STREAM_FIRST_BIT; i++) vote[i] = 0;
+  confidence = 0;
+}
+
+
+bool DcfStreamClass::field (uint8_t first, uint8_t len, uint8_t *value) {
+  static const uint8_t weight[8] = { 1, 2, 4, 8, 10, 20, 40, 80 };
+  uint8_t i;
+
+  *value = 0;
+  for (i = 0; i < len; i++) {
+    if (VOTE (first + i) == 0) return false;
+    if (VOTE (first + i) > 0) *value += weight[i];
+  }
+  return true;
+}
+
+
+bool DcfStreamClass::parity (uint8_t first, uint8_t last) {
+  uint8_t i, p = 0;
+  for (i = first; i < last; i++) {
+    if (VOTE (i) == 0) return false;
+    p ^= VOTE (i) > 0;
+  }
+  return p == 0;
+}
+
+
+bool DcfStreamClass::decode (tm *t, bool *summer) {
+  uint8_t i, minute, hour, day, wday, month, year, conf = 0xFF;
+  int8_t v;
+
+  // every bit must have a definite value
+  for (i = DCF_STREAM_FIRST_BIT; i < DCF_STREAM_NUM_BITS; i++) {
+    if (i == BIT_LEAP) continue;
+    v = VOTE (i);
+    if (v == 0) return false;
+    if (v < 0) v = -v;
+    if ((uint8_t)v < conf) conf = v;
+  }
+
+  // structure and parity checks
+  if ((VOTE (BIT_CEST) > 0) == (VOTE (BIT_CET) > 0) || VOTE (BIT_START) < 0) return false;
+  if (!parity (BIT_MINUTE, BIT_HOUR) || !parity (BIT_HOUR, BIT_DAY) || !parity (BIT_DAY, BIT_P3 + 1)) return false;
+
+  field (BIT_MINUTE, 7, &minute);
+  field (BIT_HOUR,   6, &hour);
+  field (BIT_DAY,    6, &day);
+  field (BIT_WDAY,   3, &wday);
+  field (BIT_MONTH,  5, &month);
+  field (BIT_YEAR,   8, &year);
+  if (minute > 59 || hour > 23 || day < 1 || day > 31 || wday < 1 || wday > 7 ||
+      month < 1 || month > 12 || year > 99) return false;
+
+  *summer      = VOTE (BIT_CEST) > 0;
+  t->tm_sec    = 0;
+  t->tm_min    = minute;
+  t->tm_hour   = hour;
+  t->tm_mday   = day;
+  t->tm_wday   = wday % 7;
+  t->tm_mon    = month - 1;
+  t->tm_year   = year + 100;
+  t->tm_isdst  = (*summer ? 2 : 1) * ONE_HOUR;  // CET is UTC+1, CEST is UTC+2
+  confidence   = conf;
+  return true;
+}
+
+
+void DcfStreamClass::encode (const tm *t, bool summer, uint8_t *bits) {
+  uint8_t i, p;
+
+  for (i = 0; i < 8; i++) bits[i] = 0;
+
+  #define SET(IDX)  bits[(IDX) >> 3] |= 1 << ((IDX) & 7)
+  #define BCD(FIRST, LEN, VALUE) { uint8_t b = (((VALUE) / 10) << 4) | ((VALUE) % 10); \
+    for (i = 0; i < (LEN); i++) if ((b >> i) & 1) SET ((FIRST) + i); }
+
+  if (summer) SET (BIT_CEST);
+  else        SET (BIT_CET);
+  SET (BIT_START);
+  BCD (BIT_MINUTE, 7, t->tm_min);
+  BCD (BIT_HOUR,   6, t->tm_hour);
+  BCD (BIT_DAY,    6, t->tm_mday);
+  BCD (BIT_WDAY,   3, t->tm_wday == 0 ? 7 : t->tm_wday);
+  BCD (BIT_MONTH,  5, t->tm_mon + 1);
+  BCD (BIT_YEAR,   8, t->tm_year - 100);
+
+  #undef BCD
+
+  // even parity bits
+  for (i = BIT_MINUTE, p = 0; i < BIT_HOUR - 1; i++) p ^= getBit (bits, i);
+  if (p) SET (BIT_HOUR - 1);
+  for (i = BIT_HOUR, p = 0; i < BIT_DAY - 1; i++) p ^= getBit (bits, i);
+  if (p) SET (BIT_DAY - 1);
+  for (i = BIT_DAY, p = 0; i < BIT_P3; i++) p ^= getBit (bits, i);
+  if (p) SET (BIT_P3);
+
+  #undef SET
+}
+
+
+void DcfStreamClass::predict (uint32_t elapsedUs) {
+  uint32_t minutes = elapsedUs / 60000000UL + (elapsedUs % 60000000UL >= 30000000UL);  // no overflow when saturated
+  uint8_t bits[8], i, first, last, minute;
+  time_t ts;
+  bool summer;
+  tm t;
+
+  if (minutes == 0) return;
+
+  // the full telegram is known: predict the telegram of the following minute
+  if (minutes <= 60 && decode (&t, &summer)) {
+    ts = mk_gmtime (&t) + minutes * 60;  // local time without time zone conversion
+    gmtime_r (&ts, &t);
+    encode (&t, summer, bits);
+    first = DCF_STREAM_FIRST_BIT;
+    last  = DCF_STREAM_NUM_BITS;
+  }
+  // only the minutes are known: increment the minutes field if no carry occurs
+  else if (minutes == 1 && field (BIT_MINUTE, 7, &minute) && minute < 59 && parity (BIT_MINUTE, BIT_HOUR)) {
+    t.tm_min = minute + 1;
+    t.tm_hour = t.tm_mday = t.tm_mon = t.tm_wday = 0;
+    t.tm_year = 100;
+    encode (&t, false, bits);
+    first = BIT_MINUTE;
+    last  = BIT_HOUR;
+  }
+  // nothing can be predicted
+  else {
+    if (minutes == 1) for (i = BIT_MINUTE; i < BIT_HOUR; i++) VOTE (i) = 0;
+    else              reset ();
+    return;
+  }
+
+  // flip the votes of the bits whose value changes
+  for (i = first; i < last; i++) {
+    if (i != BIT_LEAP && (VOTE (i) > 0) != getBit (bits, i)) VOTE (i) = -VOTE (i);
+  }
+}
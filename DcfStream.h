@@ -0,0 +1,150 @@
+/* 
+ * Streaming DCF77 frame decoder
+ *
+ * Decodes the DCF77 time telegram out of the pulse widths measured by
+ * DcfCapture. The bits of consecutive minutes are accumulated as votes,
+ * the votes of the previous minutes are aligned with the current minute
+ * by predicting the telegram of the following minute. A time is accepted
+ * as soon as every time bit has gathered enough votes, which allows for
+ * decoding noisy telegrams that would fail the parity check on their own.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DCF_STREAM_H
+#define __DCF_STREAM_H
+
+#include <Arduino.h>
+#include <time.h>
+
+/*
+ * Index of the first DCF77 bit considered by the decoder (CEST flag)
+ * the weather and call bits 0..16 are not predictable and are ignored
+ */
+#define DCF_STREAM_FIRST_BIT 17
+
+/*
+ * Number of DCF77 bits per minute, excluding the minute mark
+ */
+#define DCF_STREAM_NUM_BITS  59
+
+/*
+ * Saturation value of the votes of a single bit
+ */
+#define DCF_STREAM_VOTE_MAX  8
+
+/*
+ * Minimum number of net votes of every bit for accepting a time
+ */
+#define DCF_STREAM_MIN_VOTES 2
+
+
+/*
+ * Streaming DCF77 decoder class
+ */
+class DcfStreamClass {
+
+  public:
+
+    /*
+     * Start of a DCF77 pulse
+     * Must be called from within the pin change ISR
+     * Parameters:
+     *   ts : micros () at the start edge
+     */
+    void start (uint32_t ts);
+
+    /*
+     * End of a DCF77 pulse
+     * Must be called from within the pin change ISR
+     * Parameters:
+     *   ts : micros () at the stop edge
+     */
+    void stop (uint32_t ts);
+
+    /*
+     * Process the telegram of the last complete minute
+     * Must be called from within the main loop
+     * Return value:
+     *   0 : a new time has been decoded into currentTm at the latest minute mark,
+     *       which lies markDelay seconds in the past
+     *   1 : no new telegram
+     *   2 : the telegram could not be decoded yet
+     */
+    uint8_t getTime (void);
+
+    /*
+     * Discard all the accumulated votes
+     */
+    void reset (void);
+
+    /*
+     * Decoded DCF77 time
+     * tm_isdst holds the UTC offset in seconds, such that mktime () returns the UTC time
+     */
+    tm currentTm;
+
+    /*
+     * Central European Summer Time flag of the decoded time
+     */
+    bool cest = false;
+
+    /*
+     * Minimum number of net votes among the time bits of the last telegram
+     */
+    uint8_t confidence = 0;
+
+    /*
+     * Seconds elapsed since the minute mark when the last telegram was delivered
+     * (1 if the pulse of second 0 was missing)
+     */
+    uint8_t markDelay = 0;
+
+  private:
+    bool decode (tm *t, bool *summer);                      // decode the telegram out of the votes
+    void encode (const tm *t, bool summer, uint8_t *bits);  // encode a telegram
+    bool field (uint8_t first, uint8_t len, uint8_t *value);  // read a BCD field out of the votes
+    bool parity (uint8_t first, uint8_t last);                // even parity of the definite votes within [first, last)
+    void predict (uint32_t elapsedUs);                        // align the votes with the next telegram
+    static bool getBit (const uint8_t *bits, uint8_t idx) { return (bits[idx >> 3] >> (idx & 7)) & 1; }
+    int8_t vote[DCF_STREAM_NUM_BITS - DCF_STREAM_FIRST_BIT] = { };
+    // written by the ISR
+    uint32_t startUs = 0;              // micros () at the last pulse start
+    uint32_t markElapsed = UINT32_MAX; // µs since the minute mark of the last delivered telegram, saturated
+    uint8_t secIdx = 0xFF;             // current second within the minute, 0xFF if unknown
+    bool pulse = false;                // a pulse is being received
+    uint8_t rxBits[8], rxValid[8];     // bits of the current minute
+    volatile uint8_t frameBits[8], frameValid[8];  // bits of the last complete minute
+    volatile uint32_t frameElapsed = 0;            // µs between the minute marks of the last two delivered telegrams
+    volatile uint8_t frameDelay = 0;               // seconds since the minute mark at the delivery of the last telegram
+    volatile bool frameReady = false;
+};
+
+
+/*
+ * Streaming DCF77 decoder object as a singleton
+ */
+extern DcfStreamClass DcfStream;
+
+
+#endif // __DCF_STREAM_H
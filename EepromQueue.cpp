@@ -0,0 +1,169 @@
+/* 
+ * Non-blocking EEPROM write queue
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EepromQueue.h"
+#include <avr/eeprom.h>
+
+
+EepromQueueClass EepromQueue;
+
+
+void EepromQueueClass::write (uint16_t addr, const uint8_t *buf, uint16_t size) {
+  uint16_t i;
+  for (i = 0; i < size; i++) write (addr + i, buf[i]);
+}
+
+
+void EepromQueueClass::write (uint16_t addr, uint8_t value) {
+  uint8_t idx;
+
+  for (;;) {
+    cli ();
+    // coalesce with the most recent pending write only, such that the
+    // writes to different addresses are committed in FIFO order
+    if (count > 0) {
+      idx = head + count - 1;
+      if (idx >= EEPROM_QUEUE_SIZE) idx -= EEPROM_QUEUE_SIZE;
+      if (queue[idx].addr == addr) {
+        queue[idx].value = value;
+        sei ();
+        return;
+      }
+    }
+    if (count < EEPROM_QUEUE_SIZE) break;
+    sei ();
+    // queue is full: wait for the ISR to commit the oldest write
+  }
+
+  // unchanged bytes are skipped by the ISR
+  idx = head + count;
+  if (idx >= EEPROM_QUEUE_SIZE) idx -= EEPROM_QUEUE_SIZE;
+  queue[idx].addr  = addr;
+  queue[idx].value = value;
+  count++;
+  EECR |= _BV(EERIE);  // the ISR is triggered as soon as the EEPROM is ready
+  sei ();
+}
+
+
+void EepromQueueClass::read (uint16_t addr, uint8_t *buf, uint16_t size) {
+  uint16_t i;
+  for (i = 0; i < size; i++) buf[i] = read (addr + i);
+}
+
+
+uint8_t EepromQueueClass::read (uint16_t addr) {
+  uint8_t i, idx, value;
+  bool found = false;
+
+  // EEAR must not be changed by the ISR during the read access,
+  // wait for an ongoing write with the interrupts enabled
+  for (;;) {
+    eeprom_busy_wait ();
+    cli ();
+    if (!(EECR & _BV(EEPE))) break;
+    sei ();
+  }
+
+  // the most recent pending write to the same address
+  for (i = 0, idx = head; i < count; i++) {
+    if (queue[idx].addr == addr) {
+      value = queue[idx].value;
+      found = true;
+    }
+    if (++idx >= EEPROM_QUEUE_SIZE) idx = 0;
+  }
+  if (!found) value = eeprom_read_byte ((const uint8_t *)addr);
+  sei ();
+  return value;
+}
+
+
+void EepromQueueClass::flush (void) {
+  while (count > 0);
+  eeprom_busy_wait ();
+}
+
+
+void EepromQueueClass::erase (uint16_t addr, uint16_t size) {
+  uint16_t i;
+  flush ();
+  for (i = 0; i < size; i++) direct (addr + i, 0xFF, _BV(EEPM0));
+  eeprom_busy_wait ();
+  EECR &= ~(_BV(EEPM1) | _BV(EEPM0));  // restore the default erase and write mode
+}
+
+
+void EepromQueueClass::program (uint16_t addr, const uint8_t *buf, uint16_t size) {
+  uint16_t i;
+  flush ();
+  for (i = 0; i < size; i++) direct (addr + i, buf[i], _BV(EEPM1));
+  eeprom_busy_wait ();
+  EECR &= ~(_BV(EEPM1) | _BV(EEPM0));  // restore the default erase and write mode
+}
+
+
+void EepromQueueClass::direct (uint16_t addr, uint8_t value, uint8_t mode) {
+  eeprom_busy_wait ();
+  cli ();
+  EEAR = addr;
+  EEDR = value;
+  EECR = (EECR & ~(_BV(EEPM1) | _BV(EEPM0))) | mode;
+  EECR |= _BV(EEMPE);
+  EECR |= _BV(EEPE);
+  sei ();
+}
+
+
+void EepromQueueClass::isrHandler (void) {
+  Entry_s *e;
+
+  while (count > 0) {
+    e = &queue[head];
+    if (++head >= EEPROM_QUEUE_SIZE) head = 0;
+    count--;
+
+    // skip unchanged bytes
+    EEAR = e->addr;
+    EECR |= _BV(EERE);
+    if (EEDR == e->value) continue;
+
+    // erase and write in one operation
+    EEDR = e->value;
+    EECR &= ~(_BV(EEPM1) | _BV(EEPM0));
+    EECR |= _BV(EEMPE);
+    EECR |= _BV(EEPE);
+    return;
+  }
+
+  // nothing left to do
+  EECR &= ~_BV(EERIE);
+}
+
+
+ISR (EE_READY_vect) {
+  EepromQueue.isrHandler ();
+}
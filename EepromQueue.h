@@ -0,0 +1,141 @@
+/* 
+ * Non-blocking EEPROM write queue
+ *
+ * Buffers EEPROM writes in RAM and commits them one byte at a time
+ * from within the EEPROM ready interrupt.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __EEPROM_QUEUE_H
+#define __EEPROM_QUEUE_H
+
+#include <Arduino.h>
+
+/*
+ * Maximum number of pending byte writes
+ */
+#define EEPROM_QUEUE_SIZE 24
+
+
+/*
+ * EEPROM write queue class
+ */
+class EepromQueueClass {
+
+  public:
+
+    /*
+     * Queue a block of data for being written to EEPROM
+     * the bytes are committed in the order they have been queued, bytes
+     * that do not differ from the EEPROM contents are skipped by the ISR
+     * without starting a write cycle
+     * blocks until enough space is available if the queue is full
+     * Parameters:
+     *   addr : EEPROM address
+     *   buf  : data buffer
+     *   size : number of bytes
+     */
+    void write (uint16_t addr, const uint8_t *buf, uint16_t size);
+
+    /*
+     * Queue a single byte for being written to EEPROM
+     * replaces the most recently queued byte if it has the same address
+     * Parameters:
+     *   addr  : EEPROM address
+     *   value : byte value
+     */
+    void write (uint16_t addr, uint8_t value);
+
+    /*
+     * Read a block of data from EEPROM
+     * considers the pending writes
+     * Parameters:
+     *   addr : EEPROM address
+     *   buf  : data buffer
+     *   size : number of bytes
+     */
+    void read (uint16_t addr, uint8_t *buf, uint16_t size);
+
+    /*
+     * Read a single byte from EEPROM
+     * considers the pending writes
+     * Parameters:
+     *   addr : EEPROM address
+     */
+    uint8_t read (uint16_t addr);
+
+    /*
+     * Block until all the pending writes have been committed
+     */
+    void flush (void);
+
+    /*
+     * Erase a block of EEPROM cells to 0xFF using the erase-only mode
+     * blocks until the pending writes and the erase operation have been finished
+     * Parameters:
+     *   addr : EEPROM address
+     *   size : number of bytes
+     */
+    void erase (uint16_t addr, uint16_t size);
+
+    /*
+     * Program a block of previously erased EEPROM cells using the write-only mode
+     * takes about half the time of a regular write (1.8 ms instead of 3.4 ms per byte)
+     * blocks until the pending writes and the program operation have been finished
+     * Parameters:
+     *   addr : EEPROM address
+     *   buf  : data buffer
+     *   size : number of bytes
+     */
+    void program (uint16_t addr, const uint8_t *buf, uint16_t size);
+
+    /*
+     * Number of pending writes
+     */
+    uint8_t pending (void) { return count; }
+
+    /*
+     * EEPROM ready handler
+     * Must be called from within the EE_READY ISR
+     */
+    void isrHandler (void);
+
+  private:
+    void direct (uint16_t addr, uint8_t value, uint8_t mode);  // start an EEPROM operation bypassing the queue
+    struct Entry_s {
+      uint16_t addr;
+      uint8_t value;
+    } queue[EEPROM_QUEUE_SIZE];
+    volatile uint8_t head = 0;   // index of the oldest pending write
+    volatile uint8_t count = 0;  // number of pending writes
+};
+
+
+/*
+ * EEPROM write queue object as a singleton
+ */
+extern EepromQueueClass EepromQueue;
+
+
+#endif // __EEPROM_QUEUE_H
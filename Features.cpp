@@ -26,6 +26,7 @@
 
 #include "Features.h"
 #include "src/MathMf/MathMf.h"
+#include "Progmem.h"
 
 #define TIMER_ALARM_DURATION      (10 * 60000)
 #define TIMER_RESET_TIMEOUT       (10000)
@@ -38,241 +39,325 @@
 
 BuzzerClass Buzzer;
 
+#define BUZZER_UNIT_TICKS 10  // ticks per note duration unit
+
+/*
+ * Note sequences as pairs of volume level and duration
+ */
+static const BuzzerNote_s alarmNotes[] PROGMEM = {
+  { 8, 5 }, { 0, 20 }, { 8, 5 }, { 0, 20 }, { 8, 5 }, { 0, 145 }, { BUZZER_REPEAT, 0 }
+};
+static const BuzzerNote_s timerNotes[] PROGMEM = {
+  { 8, 5 }, { 0, 95 }, { BUZZER_REPEAT, 0 }
+};
+static const BuzzerNote_s clickNotes[] PROGMEM = {
+  { 8, 1 }, { BUZZER_END, 0 }
+};
+static const BuzzerNote_s confirmNotes[] PROGMEM = {
+  { 8, 3 }, { 6, 3 }, { 4, 3 }, { 2, 3 }, { 1, 3 }, { BUZZER_END, 0 }
+};
+
+/*
+ * Sound table: note sequence and volume envelope of every sound
+ */
+static const struct BuzzerSound_s {
+  const BuzzerNote_s *notes;  // note sequence
+  uint8_t volume;             // initial master volume 1..BUZZER_MAX_LEVEL
+  uint8_t volumeStep;         // master volume increase at every repetition
+} buzzerSounds[BUZZER_NUM_SOUNDS] PROGMEM = {
+  { alarmNotes,   2,                1 },  // BUZZER_ALARM
+  { timerNotes,   BUZZER_MAX_LEVEL, 0 },  // BUZZER_TIMER
+  { clickNotes,   BUZZER_MAX_LEVEL, 0 },  // BUZZER_CLICK
+  { confirmNotes, BUZZER_MAX_LEVEL, 0 }   // BUZZER_CONFIRM
+};
+
+#ifdef NIXIE_ISR_MULTIPLEX
+static void buzzerTick (void) {
+  Buzzer.isrHandler ();
+}
+#endif
+
 void BuzzerClass::initialize (uint8_t buzzerPin) {
-  this->buzzerPin = buzzerPin;
   pinMode (buzzerPin, OUTPUT);
   digitalWrite (buzzerPin, LOW);
+  portReg = portOutputRegister (digitalPinToPort (buzzerPin));
+  pinMask = digitalPinToBitMask (buzzerPin);
   active = false;
-  index = 0;
   initialized = true;
+#ifdef NIXIE_ISR_MULTIPLEX
+  Nixie.attachTick (buzzerTick);
+#endif
 }
 
 void BuzzerClass::loopHandler (void) {
-  uint32_t ts;
-  
-  if (!initialized || !active ) return;
-
-  ts = millis ();
-  
-  if (ts - melodyTs > (uint32_t)melody[index]) {
-    digitalWrite (buzzerPin, !digitalRead (buzzerPin));
-    melodyTs = ts;
-    index++;
-    if (melody[index] < 0) index = 0;
-  }
-}
-
-void BuzzerClass::playMelody1 (void) {
-  if (!initialized || active) return;
-  active = true;
-  melody = melody1;
-  melodyTs = millis () - 5000;
-  index = 0;
-}
+#ifndef NIXIE_ISR_MULTIPLEX
+  uint32_t ts = millis ();
 
-void BuzzerClass::playMelody2 (void) {
-  if (!initialized || active) return;
-  active = true;
-  melody = melody2;
-  melodyTs = millis () - 5000;
-  index = 0;
+  // catch up with the elapsed ticks
+  while (tickTs != ts) {
+    isrHandler ();
+    tickTs++;
+  }
+#endif
+}
+
+void BuzzerClass::play (BuzzerSound_e sound) {
+  if (!initialized || sound >= BUZZER_NUM_SOUNDS) return;
+  if (active && this->sound < BUZZER_CLICK) return;
+  BuzzerSound_s s = progmemRead (&buzzerSounds[sound]);
+  cli ();
+  this->sound = sound;
+  notes      = s.notes;
+  note       = s.notes;
+  volume     = s.volume;
+  volumeStep = s.volumeStep;
+  ticks      = 0;
+  phase      = 0;
+  active     = true;
+  sei ();
+#ifndef NIXIE_ISR_MULTIPLEX
+  tickTs = millis ();
+#endif
 }
 
 void BuzzerClass::stop (void) {
+  if (!initialized) return;
+  cli ();
   active = false;
-  index = 0;
-  digitalWrite (buzzerPin, LOW);
-}
-
-
-/*#######################################################################################*/
-
-void ChronoClass::increment10th (void) {
-  tenth++;
-  if (tenth > 9) tenth = 0, second++;
-  if (second > 59) second = 0, minute++;
-  if (minute > 59) minute = 0, hour++;
+  *portReg &= ~pinMask;
+  sei ();
 }
 
-void ChronoClass::increment10sec (void) {
-  second += 10;
-  if (second > 59) second = 0, minute++;
-  if (minute > 59) minute = 0, hour++;
-}
-
-bool ChronoClass::decrement10sec (void) {
-  second -= 10;
-  if (second < 0) second = 59, minute--;
-  if (minute < 0) minute = 59, hour--;
-  if (hour < 0) hour = 0, minute = 0, second = 0;
-  if (hour == 0 && minute == 0 && second == 0) return true;
-  return false;
-}
-
-void ChronoClass::incrementMin (void) {
-  minute++;
-  if (minute > 59) minute = 0, hour++;
-}
+void BuzzerClass::nextNote (void) {
+  BuzzerNote_s n = progmemRead (note);
 
-bool ChronoClass::decrementMin (void) {
-  minute--;
-  if (minute < 0) minute = 59, hour--;
-  if (hour < 0) hour = 0, minute = 0, second = 0;
-  if (hour == 0 && minute == 0 && second == 0) return true;
-  return false;
-}
+  // end of sequence
+  if (n.duration == 0) {
+    if (n.level != BUZZER_REPEAT) {
+      active = false;
+      *portReg &= ~pinMask;
+      return;
+    }
+    // repeat and apply the crescendo
+    volume += volumeStep;
+    if (volume > BUZZER_MAX_LEVEL) volume = BUZZER_MAX_LEVEL;
+    note = notes;
+    n = progmemRead (note);
+  }
 
-void ChronoClass::incrementSec (void) {
-  second++;
-  if (second > 59) second = 0, minute++;
-  if (minute > 59) minute = 0, hour++;
+  note++;
+  ticks = (uint16_t)n.duration * BUZZER_UNIT_TICKS;
+  level = ((uint16_t)n.level * volume + BUZZER_MAX_LEVEL / 2) / BUZZER_MAX_LEVEL;
+  if (n.level > 0 && level == 0) level = 1;
 }
 
-bool ChronoClass::decrementSec (void) {
-  second--;
-  if (second < 0) second = 59, minute--;
-  if (minute < 0) minute = 59, hour--;
-  if (hour < 0) hour = 0, minute = 0, second = 0;
-  if (hour == 0 && minute == 0 && second == 0) return true;
-  return false;
-}
+void BuzzerClass::isrHandler (void) {
+  if (!active) return;
 
-void ChronoClass::reset (void) {
-  tenth = 0;
-  second = 0;
-  minute = 0;
-  hour = 0;
-}
+  if (ticks == 0) {
+    nextNote ();
+    if (!active) return;
+  }
+  ticks--;
 
-void ChronoClass::copy (ChronoClass *tm) {
-  tenth = tm->tenth;
-  second = tm->second;
-  minute = tm->minute;
-  hour = tm->hour;
+  // software PWM volume control
+  if (phase < level) *portReg |=  pinMask;
+  else               *portReg &= ~pinMask;
+  phase++;
+  if (phase >= BUZZER_MAX_LEVEL) phase = 0;
 }
 
-void ChronoClass::roundup (void) {
-  tenth = 0;
-  if (second !=0) second = 0, minute++;
-  if (minute > 59) minute = 0, hour++;
-  if (second == 0 && minute == 0) minute = 1;
-}
 
 /*#######################################################################################*/
 
-void CdTimerClass::initialize (void (*callback)(bool)) {
-  this->callback = callback;
-  defaultTm.tenth = 0;
-  defaultTm.second = 0;
-  defaultTm.minute = 5;
-  defaultTm.hour = 0;
+void CdTimerClass::initialize (void) {
+  uint8_t i;
+
+  for (i = 0; i < CDTIMER_NUM; i++) {
+    timer[i].preset    = CDTIMER_DEFAULT;
+    timer[i].remaining = CDTIMER_DEFAULT;
+    timer[i].flags     = 0;
+  }
+  view = 0;
   reset ();
 }
 
 void CdTimerClass::loopHandler (void) {
-  static uint32_t alarmTs = 0;
-  static uint32_t resetTs = 0;
   uint32_t ts = millis ();
-  
-  if (tickFlag) { 
-    if (!alarm) {
-      alarm = tm.decrementSec (); 
-      if (alarm) {
-        alarmTs = ts;
-        tm.copy (&defaultTm);
+  Timer_s *t;
+  uint8_t i;
+  bool expired = false;
+
+  if (tickFlag) {
+    tickFlag = false;
+    for (i = 0; i < CDTIMER_NUM; i++) {
+      t = &timer[i];
+      if (!(t->flags & CDTIMER_RUNNING)) continue;
+      if (t->flags & CDTIMER_ALARM) {
+        t->remaining++;
+        if (t->remaining - t->preset > TIMER_ALARM_DURATION / 1000) {
+          t->flags &= ~(CDTIMER_ALARM | CDTIMER_RUNNING);
+          expired = true;
+        }
+      }
+      else if (t->remaining > 1) {
+        t->remaining--;
+      }
+      else {
+        t->remaining = t->preset;
+        t->flags |= CDTIMER_ALARM;
+        view  = i;
+        setup = false;
         Nixie.resetBlinking ();
         Nixie.blinkAll (true);
-        Buzzer.playMelody2 ();
+        Buzzer.play (BUZZER_TIMER);
       }
     }
-    else {
-      tm.incrementSec ();
+    update ();
+    // the alarm duration has elapsed
+    if (expired && !alarm) {
+      Nixie.blinkAll (false);
+      Buzzer.stop ();
     }
+    if (!setup) view = priority ();
     displayRefresh ();
-    tickFlag = false;
   }
-  
-  if (alarm && ts - alarmTs > TIMER_ALARM_DURATION) resetAlarm ();
-  
-  if (running) {
+
+  // reset the displayed timer if it remains stopped
+  if ((timer[view].flags & (CDTIMER_ACTIVE | CDTIMER_RUNNING)) != CDTIMER_ACTIVE) {
     resetTs = ts;
   }
-  else if (active && !running) {
-    if (ts - resetTs > TIMER_RESET_TIMEOUT) reset ();
+  else if (ts - resetTs > TIMER_RESET_TIMEOUT) {
+    reset ();
+    view = priority ();
+    displayRefresh ();
   }
 }
 
-void CdTimerClass::tick (void) {
-  if (running) {  
-    tickFlag = true;
+void CdTimerClass::adjust (int16_t seconds) {
+  Timer_s *t = &timer[view];
+  int32_t val;
+  uint8_t i;
+
+  if (t->flags & CDTIMER_ALARM) return;
+
+  // a running timer is left alone, set up a free timer instead
+  if (t->flags & CDTIMER_RUNNING) {
+    for (i = 0; i < CDTIMER_NUM && (timer[i].flags & CDTIMER_ACTIVE); i++);
+    if (i >= CDTIMER_NUM) return;
+    view  = i;
+    setup = true;
+    t = &timer[i];
+    t->remaining = t->preset;
+    displayRefresh ();
+    return;
   }
-}
 
-void CdTimerClass::secondIncrease (void) {
-  tm.increment10sec ();
+  val = (int32_t)t->remaining + seconds;
+  if (val < 0) val = 0;
+  if (val > CDTIMER_MAX) val = CDTIMER_MAX;
+  t->remaining = val;
+  t->preset    = val;
   displayRefresh ();
-  defaultTm.copy (&tm);
 }
 
-void CdTimerClass::secondDecrease (void) {
-  tm.decrement10sec ();
-  displayRefresh ();
-  defaultTm.copy (&tm);
+uint8_t CdTimerClass::priority (void) {
+  uint8_t i, idx = 0xFF;
+
+  for (i = 0; i < CDTIMER_NUM; i++) if (timer[i].flags & CDTIMER_ALARM) return i;
+
+  // keep showing a stopped timer until it is reset
+  if ((timer[view].flags & (CDTIMER_ACTIVE | CDTIMER_RUNNING)) == CDTIMER_ACTIVE) return view;
+
+  for (i = 0; i < CDTIMER_NUM; i++) {
+    if ((timer[i].flags & CDTIMER_RUNNING) && (idx == 0xFF || timer[i].remaining < timer[idx].remaining)) idx = i;
+  }
+  if (idx != 0xFF) return idx;
+  for (i = 0; i < CDTIMER_NUM; i++) if (timer[i].flags & CDTIMER_ACTIVE) return i;
+  return view;
+}
+
+void CdTimerClass::update (void) {
+  uint8_t i, flags = 0;
+
+  for (i = 0; i < CDTIMER_NUM; i++) flags |= timer[i].flags;
+  active  = flags & CDTIMER_ACTIVE;
+  running = flags & CDTIMER_RUNNING;
+  alarm   = flags & CDTIMER_ALARM;
 }
 
-void CdTimerClass::minuteIncrease (void) {
-  tm.incrementMin ();
+void CdTimerClass::select (void) {
+  setup = false;
+  view  = priority ();
+  if (!(timer[view].flags & CDTIMER_ACTIVE)) reset ();
   displayRefresh ();
-  defaultTm.copy (&tm);
 }
 
-void CdTimerClass::minuteDecrease (void) {
-  tm.decrementMin ();
+void CdTimerClass::toggle (void) {
+  Timer_s *t = &timer[view];
+
+  if (t->flags & CDTIMER_RUNNING) {
+    t->flags &= ~CDTIMER_RUNNING;
+    if (t->flags & CDTIMER_ALARM) resetAlarm ();
+  }
+  else if (t->flags & CDTIMER_ACTIVE) {
+    reset ();
+  }
+  else {
+    if (t->remaining == 0) return;
+    t->flags = CDTIMER_ACTIVE | CDTIMER_RUNNING;
+    setup = false;
+  }
+  update ();
   displayRefresh ();
-  defaultTm.copy (&tm);
 }
 
 void CdTimerClass::displayRefresh (void) {
-  digits[0].value = dec2bcdLow  (tm.second);
-  digits[1].value = dec2bcdHigh (tm.second);
-  digits[2].value = dec2bcdLow  (tm.minute);
-  digits[3].value = dec2bcdHigh (tm.minute);
-  digits[4].value = dec2bcdLow  (tm.hour);
-  digits[5].value = dec2bcdHigh (tm.hour); 
-}
+  uint16_t val = timer[view].remaining;
+  uint8_t hour, minute, second, i, n = 0;
 
-void CdTimerClass::start (void) {
-  if (!running) {
-    active = true;
-    running = true;
-    callback (true);
-  }  
-}
+  hour   = val / 3600;
+  val   -= (uint16_t)hour * 3600;
+  minute = val / 60;
+  second = val - minute * 60;
+  digits[0].value = dec2bcdLow  (second);
+  digits[1].value = dec2bcdHigh (second);
+  digits[2].value = dec2bcdLow  (minute);
+  digits[3].value = dec2bcdHigh (minute);
+  digits[4].value = dec2bcdLow  (hour);
+  digits[5].value = dec2bcdHigh (hour);
 
-void CdTimerClass::stop (void) {
-  if (running) {
-    running = false;
-    callback (false);    
-  }
+  // the leftmost comma indicates that other timers are active in the background
+  for (i = 0; i < CDTIMER_NUM; i++) if (i != view && (timer[i].flags & CDTIMER_ACTIVE)) n++;
+  digits[5].comma = (n > 0);
 }
 
 void CdTimerClass::resetAlarm (void) {
-  if (alarm) {
-    alarm = false;
-    Nixie.blinkAll (false);
-    Buzzer.stop ();
-    stop ();
+  uint8_t i;
+
+  if (!alarm) return;
+  for (i = 0; i < CDTIMER_NUM; i++) {
+    if (timer[i].flags & CDTIMER_ALARM) timer[i].flags &= ~(CDTIMER_ALARM | CDTIMER_RUNNING);
   }
+  Nixie.blinkAll (false);
+  Buzzer.stop ();
+  update ();
+  displayRefresh ();
 }
 
 void CdTimerClass::reset (void) {
-  resetAlarm ();
-  active = false;
-  running = false;
+  Timer_s *t = &timer[view];
+
+  if (t->flags & CDTIMER_ALARM) resetAlarm ();
+  t->flags = 0;
+  // round up to whole minutes, at least one minute
+  t->preset = (t->preset + 59) / 60 * 60;
+  if (t->preset == 0) t->preset = 60;
+  if (t->preset > CDTIMER_MAX) t->preset = CDTIMER_MAX;
+  t->remaining = t->preset;
+  setup = false;
+  update ();
   Nixie.resetDigits (digits, NIXIE_NUM_TUBES);
-  callback (false);
-  defaultTm.roundup ();
-  tm.copy (&defaultTm);
   displayRefresh ();
 }
 
@@ -284,27 +369,37 @@ void StopwatchClass::initialize (void (*callback)(bool reset)) {
 }
 
 void StopwatchClass::loopHandler (void) {
-  if (tickFlag) {
-    tm.increment10th ();
-    if (!paused) displayRefresh ();
-    if (tm.hour > 1) {
-      tm.hour = 1; tm.minute = 59; tm.second = 59; tm.tenth = 9;
-      stop ();
-    }
-    tickFlag = false;
+  uint32_t t;
+
+  // lap number timeout --> show the lap time
+  if (banner && millis () - bannerTs >= STOPWATCH_BANNER_DURATION) {
+    banner = false;
+    show (lap (lapView));
   }
-}
 
-void StopwatchClass::tick (void) {
-  if (running) {  
-    tickFlag = true;
+  if (!running) return;
+
+  t = read ();
+  if (t >= STOPWATCH_MAX_TICKS) {
+    cli ();
+    running = false;
+    ticks   = STOPWATCH_MAX_TICKS;
+    sei ();
+    stop ();
+  }
+  else if (!paused && t != shown) {
+    show (t);
   }
 }
 
 void StopwatchClass::start (void) {
+  uint8_t i;
   active = true;
   running = true;
-  callback (true);  
+  banner = false;
+  lapView = -1;
+  for (i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blink = false;
+  callback (true);
 }
 
 void StopwatchClass::stop (void) {
@@ -315,27 +410,62 @@ void StopwatchClass::stop (void) {
 
 void StopwatchClass::pause (bool enable) {
   uint8_t i;
+  uint32_t t;
   if (enable && running) {
     paused = true;
+    // record the split time
+    t = read ();
+    laps[lapHead] = t;
+    lapHead = (lapHead + 1) % STOPWATCH_NUM_LAPS;
+    if (numLaps < STOPWATCH_NUM_LAPS) numLaps++;
+    show (t);
     Nixie.resetBlinking ();
-    for (i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blink = true;  
+    for (i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blink = true;
   }
   else {
     paused = false;
     displayRefresh ();
     for (i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blink = false;
   }
-  
+}
+
+void StopwatchClass::nextLap (void) {
+  uint8_t i;
+  if (!active || running || numLaps == 0) return;
+
+  lapView++;
+  if (lapView >= numLaps) {
+    // back to the final time
+    lapView = -1;
+    banner  = false;
+    for (i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blink = false;
+    show (read ());
+    return;
+  }
+
+  // show the lap number, followed by the blinking lap time
+  for (i = 0; i < NIXIE_NUM_TUBES; i++) {
+    digits[i].blank = (i > 1);
+    digits[i].comma = false;
+    digits[i].blink = true;
+  }
+  digits[1].value = dec2bcdHigh (lapView + 1);
+  digits[0].value = dec2bcdLow  (lapView + 1);
+  Nixie.resetBlinking ();
+  banner   = true;
+  bannerTs = millis ();
+}
+
+void StopwatchClass::toggleResolution (void) {
+  if (active) return;
+  hundredths = !hundredths;
+  displayRefresh ();
 }
 
 void StopwatchClass::displayRefresh (void) {
-  digits[0].value = 0;
-  digits[1].value = dec2bcdLow  (tm.tenth);
-  digits[2].value = dec2bcdLow  (tm.second);
-  digits[3].value = dec2bcdHigh (tm.second);
-  digits[4].value = dec2bcdLow  (tm.minute);
-  digits[5].value = dec2bcdHigh (tm.minute); 
-  if (tm.hour > 0) digits[4].comma = true;
+  if (banner) return;
+  if (lapView >= 0) show (lap (lapView));
+  else              show (read ());
 }
 
 void StopwatchClass::reset (void) {
@@ -343,46 +473,104 @@ void StopwatchClass::reset (void) {
   active = false;
   running = false;
   paused = false;
+  banner = false;
+  lapView = -1;
+  numLaps = 0;
+  lapHead = 0;
   Nixie.resetDigits (digits, NIXIE_NUM_TUBES);
   for (i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blink = false;
-  tm.reset ();
+  cli ();
+  ticks = 0;
+  sei ();
   displayRefresh ();
   callback (false);
 }
 
+uint32_t StopwatchClass::read (void) {
+  uint32_t t;
+  cli ();
+  t = ticks;
+  sei ();
+  return t;
+}
+
+uint32_t StopwatchClass::lap (uint8_t idx) {
+  return laps[(lapHead + STOPWATCH_NUM_LAPS - numLaps + idx) % STOPWATCH_NUM_LAPS];
+}
+
+void StopwatchClass::show (uint32_t t) {
+  uint8_t i, centi, second, minute, hour;
+
+  shown  = t;
+  centi  = t % 100; t /= 100;
+  second = t % 60;  t /= 60;
+  minute = t % 60;
+  hour   = t / 60;
+
+  for (i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blank = false;
+  digits[0].value = hundredths ? dec2bcdLow (centi) : 0;
+  digits[1].value = dec2bcdHigh (centi);
+  digits[2].value = dec2bcdLow  (second);
+  digits[3].value = dec2bcdHigh (second);
+  digits[4].value = dec2bcdLow  (minute);
+  digits[5].value = dec2bcdHigh (minute);
+  digits[4].comma = (hour > 0);
+}
+
 /*#######################################################################################*/
 
-void AlarmClass::initialize (AlarmEeprom_s *settings) {
-  this->settings = settings;
+#define ALARM_NUM_MODES 3
+
+/*
+ * Day-of-week presets selectable by modeIncrease() and modeDecrease()
+ */
+static const uint8_t alarmModes[ALARM_NUM_MODES] PROGMEM = { ALARM_WEEKENDS, ALARM_WEEKDAYS, ALARM_DAILY };
+
+void AlarmClass::initialize (AlarmEeprom_s *settings, uint8_t numAlarms) {
+  uint8_t i;
+  AlarmEeprom_s *s;
+  this->settings  = settings;
+  this->numAlarms = numAlarms;
   alarm = false;
   snoozing = false;
+  sel = 0;
   Nixie.blinkAll (false);
-  if (settings->minute < 0 || settings->minute > 59) settings->minute = 0;
-  if (settings->hour < 0 || settings->hour > 23) settings->hour = 0;
-  if (settings->mode != ALARM_OFF && settings->mode != ALARM_WEEKENDS && 
-      settings->mode != ALARM_WEEKDAYS && settings->mode != ALARM_DAILY) settings->mode = ALARM_OFF;
-  if (settings->lastMode != ALARM_OFF && settings->lastMode != ALARM_WEEKENDS && 
-      settings->lastMode != ALARM_WEEKDAYS && settings->lastMode != ALARM_DAILY) settings->lastMode = ALARM_DAILY;
+  for (i = 0; i < numAlarms; i++) {
+    s = &settings[i];
+    if (s->minute < 0 || s->minute > 59) s->minute = 0;
+    if (s->hour < 0 || s->hour > 23) s->hour = 0;
+    s->days &= ALARM_DAILY;
+    if (s->days == 0) s->days = ALARM_DAILY;
+    if (s->enabled > 1) s->enabled = 0;
+  }
+  pending = true;
   displayRefresh ();
 }
 
-void AlarmClass::loopHandler (int8_t hour, int8_t minute, int8_t wday, bool active) {
+void AlarmClass::loopHandler (time_t now, const tm *localTm, bool active) {
   uint32_t ts = millis();
 
-  if (minute != lastMinute) alarmCondition = false;
-  
-  if (active && !snoozing && settings->mode != ALARM_OFF && !alarmCondition &&
-      minute == settings->minute && hour == settings->hour && 
-      (settings->mode != ALARM_WEEKDAYS || (wday >= 1 && wday <= 5)) && 
-      (settings->mode != ALARM_WEEKENDS || wday == 0 || wday == 6)) {
-    startAlarm (); 
-    alarmCondition = true;
+  if (pending) schedule (now, localTm);
+
+  // the next alarm time has been reached
+  if (now >= nextTime) {
+    if (nextIdx >= 0 && active && !snoozing && now - nextTime < 60) {
+      sel = nextIdx;
+      startAlarm ();
+      lastTime = nextTime;
+      schedule (now, localTm);
+    }
+    // the alarm could not be started within its minute
+    else if (nextIdx < 0 || now - nextTime >= 60) {
+      lastTime = nextTime;
+      schedule (now, localTm);
+    }
   }
 
   if (snoozing && ts - snoozeTs > ALARM_SNOOZE_DURATION) startAlarm ();
 
   if (snoozing && ts - blinkTs > 500) {
-    Nixie.comma[0] = !Nixie.comma[0];
+    Nixie.setComma (0, !Nixie.getComma (0));
     blinkTs = ts;
   }
 
@@ -391,8 +579,56 @@ void AlarmClass::loopHandler (int8_t hour, int8_t minute, int8_t wday, bool acti
   // due to a boundary condition where alarmTs > ts
   // (alarmTs is set within startAlarm() which is called after ts was assigned)
   if (alarm && millis() - alarmTs > ALARM_ALARM_DURATION) resetAlarm ();
+}
+
+void AlarmClass::schedule (time_t now, const tm *localTm) {
+  uint8_t i, d;
+  int16_t minutes;
+  int32_t delta;
+  time_t minuteStart = now - localTm->tm_sec;
+  time_t t;
+  AlarmEeprom_s *s;
+
+  pending  = false;
+  nextIdx  = -1;
+  // nothing due within a week, check again after a week
+  nextTime = minuteStart + (time_t)8 * 24 * 3600;
+
+  for (i = 0; i < numAlarms; i++) {
+    s = &settings[i];
+    if (!s->enabled) continue;
+    minutes = (int16_t)s->hour * 60 + s->minute - ((int16_t)localTm->tm_hour * 60 + localTm->tm_min);
+    // find the first matching day of the week, including the current minute
+    for (d = 0; d <= 7; d++) {
+      if (!(s->days & (1 << ((localTm->tm_wday + d) % 7)))) continue;
+      delta = (int32_t)d * 24 * 60 + minutes;
+      if (delta < 0) continue;
+      t = minuteStart + delta * 60;
+      if (t == lastTime) continue;
+      if (t < nextTime) {
+        nextTime = t;
+        nextIdx  = i;
+      }
+      break;
+    }
+  }
+}
 
-  lastMinute = minute;
+void AlarmClass::selectNext (void) {
+  sel++;
+  if (sel >= numAlarms) sel = 0;
+  displayRefresh ();
+}
+
+void AlarmClass::selectPrevious (void) {
+  if (sel == 0) sel = numAlarms;
+  sel--;
+  displayRefresh ();
+}
+
+void AlarmClass::selectUpcoming (void) {
+  sel = nextIdx >= 0 ? nextIdx : 0;
+  displayRefresh ();
 }
 
 void AlarmClass::startAlarm (void) {
@@ -400,7 +636,7 @@ void AlarmClass::startAlarm (void) {
     alarm = true;
     Nixie.resetBlinking ();
     Nixie.blinkAll (true);
-    Buzzer.playMelody1 ();
+    Buzzer.play (BUZZER_ALARM);
     alarmTs = millis ();
     snoozing = false;
     displayRefresh ();
@@ -429,68 +665,78 @@ void AlarmClass::resetAlarm (void) {
 }
 
 void AlarmClass::modeIncrease (void) {
-  if      (settings->mode == ALARM_OFF)      settings->mode = ALARM_WEEKENDS;
-  else if (settings->mode == ALARM_WEEKENDS) settings->mode = ALARM_WEEKDAYS;
-  else if (settings->mode == ALARM_WEEKDAYS) settings->mode = ALARM_DAILY;
-  else if (settings->mode == ALARM_DAILY)    settings->mode = ALARM_OFF, settings->lastMode = ALARM_DAILY;
-  displayRefresh ();
+  AlarmEeprom_s *s = &settings[sel];
+  int8_t i;
+  // OFF -> WEEKENDS -> WEEKDAYS -> DAILY -> OFF
+  for (i = ALARM_NUM_MODES - 1; i >= 0 && s->days != pgm_read_byte (&alarmModes[i]); i--);
+  if (!s->enabled)                  s->enabled = 1, s->days = pgm_read_byte (&alarmModes[0]);
+  else if (i < 0)                   s->days = pgm_read_byte (&alarmModes[0]);
+  else if (i < ALARM_NUM_MODES - 1) s->days = pgm_read_byte (&alarmModes[i + 1]);
+  else                              s->enabled = 0;
+  changed ();
 }
 
 void AlarmClass::modeDecrease (void) {
-  if      (settings->mode == ALARM_OFF)      settings->mode = ALARM_DAILY;
-  else if (settings->mode == ALARM_DAILY)    settings->mode = ALARM_WEEKDAYS;
-  else if (settings->mode == ALARM_WEEKDAYS) settings->mode = ALARM_WEEKENDS;
-  else if (settings->mode == ALARM_WEEKENDS) settings->mode = ALARM_OFF, settings->lastMode = ALARM_DAILY;
-  displayRefresh ();
+  AlarmEeprom_s *s = &settings[sel];
+  int8_t i;
+  // OFF -> DAILY -> WEEKDAYS -> WEEKENDS -> OFF
+  for (i = ALARM_NUM_MODES - 1; i >= 0 && s->days != pgm_read_byte (&alarmModes[i]); i--);
+  if (!s->enabled)  s->enabled = 1, s->days = pgm_read_byte (&alarmModes[ALARM_NUM_MODES - 1]);
+  else if (i < 0)   s->days = pgm_read_byte (&alarmModes[ALARM_NUM_MODES - 1]);
+  else if (i > 0)   s->days = pgm_read_byte (&alarmModes[i - 1]);
+  else              s->enabled = 0, s->days = pgm_read_byte (&alarmModes[ALARM_NUM_MODES - 1]);
+  changed ();
 }
 
 void AlarmClass::modeToggle (void) {
-  if (settings->mode == ALARM_OFF) {
-    settings->mode = settings->lastMode;
-  }
-  else {
-    settings->lastMode = settings->mode;
-    settings->mode = ALARM_OFF;
-  }
-  displayRefresh ();
+  settings[sel].enabled = !settings[sel].enabled;
+  changed ();
 }
 
 void AlarmClass::minuteIncrease (void) {
-  settings->minute++;
-  if (settings->minute > 59) settings->minute = 0;
-  displayRefresh ();
+  settings[sel].minute++;
+  if (settings[sel].minute > 59) settings[sel].minute = 0;
+  changed ();
 }
 
 void AlarmClass::minuteDecrease (void) {
-  settings->minute--;
-  if (settings->minute < 0) settings->minute = 59;
-  displayRefresh ();
+  settings[sel].minute--;
+  if (settings[sel].minute < 0) settings[sel].minute = 59;
+  changed ();
 }
 
 void AlarmClass::hourIncrease (void) {
-  settings->hour++;
-  if (settings->hour > 23) settings->hour = 0;
-  displayRefresh ();
+  settings[sel].hour++;
+  if (settings[sel].hour > 23) settings[sel].hour = 0;
+  changed ();
 }
 
 void AlarmClass::hourDecrease (void) {
-  settings->hour--;
-  if (settings->hour < 0) settings->hour = 23;
+  settings[sel].hour--;
+  if (settings[sel].hour < 0) settings[sel].hour = 23;
+  changed ();
+}
+
+void AlarmClass::changed (void) {
+  pending = true;
   displayRefresh ();
 }
 
 void AlarmClass::displayRefresh (void) {
+  AlarmEeprom_s *s = &settings[sel];
+  uint8_t days = 0, mask;
+  bool any = false;
   for (uint8_t i = 0; i < NIXIE_NUM_TUBES; i++) digits[i].blank = false;
-  digits[0].value = (uint8_t)settings->mode;
-  Nixie.comma[0] = (bool)settings->mode;
-  digits[1].blank = true;
-  digits[2].value = dec2bcdLow  (settings->minute);
-  digits[3].value = dec2bcdHigh (settings->minute);
-  digits[4].value = dec2bcdLow  (settings->hour);
-  digits[5].value = dec2bcdHigh (settings->hour);   
+  // the mode digit shows the number of alarm days per week of the selected alarm
+  for (mask = s->days; mask; mask &= mask - 1) days++;
+  digits[0].value = s->enabled ? days : 0;
+  // the comma shows whether any of the alarms is enabled
+  for (uint8_t i = 0; i < numAlarms; i++) any = any || settings[i].enabled;
+  Nixie.setComma (0, any);
+  digits[1].value = sel + 1;
+  digits[1].blank = (numAlarms < 2);
+  digits[2].value = dec2bcdLow  (s->minute);
+  digits[3].value = dec2bcdHigh (s->minute);
+  digits[4].value = dec2bcdLow  (s->hour);
+  digits[5].value = dec2bcdHigh (s->hour);
 }
-
-
-
-
-
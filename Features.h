@@ -28,31 +28,96 @@
 #define __FEATURES_H
 
 #include <Arduino.h>
+#include <time.h>
 #include "Nixie.h"
 
 
+/*
+ * Buzzer sounds
+ */
+enum BuzzerSound_e {
+  BUZZER_ALARM = 0,   // alarm clock, crescendo over the repetitions
+  BUZZER_TIMER,       // countdown timer expiry
+  BUZZER_CLICK,       // key click
+  BUZZER_CONFIRM,     // short decaying chirp
+  BUZZER_NUM_SOUNDS
+};
+
+/*
+ * Number of buzzer volume levels
+ * the volume is controlled by software PWM with a period of BUZZER_MAX_LEVEL ticks:
+ * with the 1 ms playback tick the output of the levels below BUZZER_MAX_LEVEL is
+ * switched at 125 Hz, which an active buzzer (having its own oscillator) renders
+ * as its tone chopped into an audible 125 Hz rattle rather than a softer tone
+ */
+#define BUZZER_MAX_LEVEL 8
+
+/*
+ * Terminates a note sequence (level field of a zero duration note)
+ */
+#define BUZZER_END    0
+#define BUZZER_REPEAT 1
+
+/*
+ * Single note of a sound sequence
+ */
+struct BuzzerNote_s {
+  uint8_t level;     // volume level 0..BUZZER_MAX_LEVEL (0 = silence)
+  uint8_t duration;  // duration in 10 ms units, 0 terminates the sequence
+};
+
 /*
  * Buzzer control class
+ * plays note sequences from flash memory, the playback is driven
+ * by the 1 ms display ISR tick if NIXIE_ISR_MULTIPLEX is defined
  */
 class BuzzerClass {
   public:
     void initialize (uint8_t buzzerPin);
+
+    /*
+     * Advance the playback
+     * only needed if NIXIE_ISR_MULTIPLEX is not defined
+     */
     void loopHandler (void);
-    void playMelody1 (void);
-    void playMelody2 (void);
+
+    /*
+     * Start playing a sound
+     * interrupts a key click or confirmation being played,
+     * has no effect while the alarm or timer sound is being played
+     * Parameters:
+     *   sound : sound ID
+     */
+    void play (BuzzerSound_e sound);
+
+    /*
+     * Stop playing
+     */
     void stop (void);
 
-    bool active = false;
-    
+    /*
+     * Playback tick handler (1 ms)
+     */
+    void isrHandler (void);
+
+    volatile bool active = false;
+
   private:
+    void nextNote (void);                 // load the next note of the sequence
     bool initialized = false;
-    uint8_t buzzerPin;
-    uint8_t index = 0;
-    uint32_t melodyTs = 0;
-    int32_t *melody = melody1;
-    //int32_t melody1[9] = { 500, 50, 100, 50, 100, 50, 100, 50, -1 };
-    int32_t melody1[9] = { 1450, 50, 200, 50, 200, 50, -1 };
-    int32_t melody2[3] = { 950, 50, -1 };  
+    volatile uint8_t *portReg;            // output register of the buzzer pin
+    uint8_t pinMask;                      // port bit mask of the buzzer pin
+    const BuzzerNote_s *notes = NULL;     // first note of the current sequence (flash memory)
+    const BuzzerNote_s *note = NULL;      // next note to be played (flash memory)
+    uint16_t ticks = 0;                   // remaining ticks of the current note
+    uint8_t level = 0;                    // PWM duty cycle of the current note
+    uint8_t phase = 0;                    // PWM phase
+    uint8_t volume = 0;                   // master volume (envelope)
+    uint8_t volumeStep = 0;               // master volume increase at every repetition
+    BuzzerSound_e sound = BUZZER_ALARM;   // sound being played
+#ifndef NIXIE_ISR_MULTIPLEX
+    uint32_t tickTs = 0;                  // timestamp of the last tick in ms
+#endif
 };
 
 /*
@@ -61,119 +126,203 @@ class BuzzerClass {
 extern BuzzerClass Buzzer;
 
 /*
- * Class for performing simple timekeeping operations
- * can be used for a chronometer or countdown timer
+ * Countdown timer parameters
  */
-class ChronoClass {
-  public:
-    void increment10th (void);
-    void increment10sec (void);
-    bool decrement10sec (void);
-    void incrementMin (void);
-    bool decrementMin (void);
-    void incrementSec (void);
-    bool decrementSec (void);
-    void reset (void);
-    void copy (ChronoClass *);
-    void roundup (void);
-
-    int8_t tenth = 0;
-    int8_t second = 0;
-    int8_t minute = 0;
-    int8_t hour = 0;
-    
-  private:
-};
-
+#define CDTIMER_NUM          4                               // number of countdown timers in the pool
+#define CDTIMER_DEFAULT      (5 * 60)                        // default timer value in seconds
+#define CDTIMER_MAX          (18 * 3600)                     // maximum timer value in seconds (fits into 16 bits)
+#define CDTIMER_ACTIVE       _BV(0)                          // timer has been started and not yet reset
+#define CDTIMER_RUNNING      _BV(1)                          // timer is counting
+#define CDTIMER_ALARM        _BV(2)                          // timer has expired and the alarm is sounding
 
 /*
  * Countdown timer implementation class
+ * manages a pool of timers that are all decremented by the same 1 s tick,
+ * every timer only holds its remaining seconds, its default value and its flags;
+ * the display shows the timer that expires soonest unless another timer is being set up
+ * the aggregated flags active, running and alarm are set if any of the timers is in the respective state
  */
 class CdTimerClass {
   public:
-    void initialize (void (*callback)(bool start));
+    void initialize (void);
     void loopHandler (void);
-    void tick (void);
-    void secondIncrease (void);
-    void secondDecrease (void);
-    void minuteIncrease (void);
-    void minuteDecrease (void);
+
+    /*
+     * 1 s tick, called from within the timekeeping ISR
+     */
+    void tick (void) { tickFlag = true; }
+
+    /*
+     * Adjust the displayed timer
+     * if the displayed timer is running, a free timer is selected for being set up instead
+     */
+    void secondIncrease (void) { adjust (10); }
+    void secondDecrease (void) { adjust (-10); }
+    void minuteIncrease (void) { adjust (60); }
+    void minuteDecrease (void) { adjust (-60); }
+
+    /*
+     * Select the timer that expires soonest for being displayed
+     * an inactive timer is reset to its default value
+     */
+    void select (void);
+
+    /*
+     * Start/stop the displayed timer
+     * a running timer is stopped, a stopped timer is reset, an inactive timer is started
+     */
+    void toggle (void);
+
     void displayRefresh (void);
-    void start (void);
-    void stop (void);
-    void resetAlarm (void);
-    void reset (void);
-    
+    void resetAlarm (void);   // reset the alarm of all timers
+    void reset (void);        // reset the displayed timer
+
     bool active = false;
     bool running = false;
     bool alarm = false;
-    NixieDigit_s digits[NIXIE_NUM_TUBES]; 
-  
+    NixieDigit_s digits[NIXIE_NUM_TUBES];
+
   private:
-    ChronoClass defaultTm;
-    ChronoClass tm;
-    volatile bool tickFlag = false; 
-    void (*callback)(bool) = NULL;
+    struct Timer_s {
+      uint16_t remaining;     // remaining time in seconds, time since expiry while the alarm is on
+      uint16_t preset;        // default value in seconds
+      uint8_t  flags;         // CDTIMER_ACTIVE | CDTIMER_RUNNING | CDTIMER_ALARM
+    } timer[CDTIMER_NUM];
+    void adjust (int16_t seconds);
+    uint8_t priority (void);  // index of the timer that expires soonest
+    void update (void);       // update the aggregated flags
+    uint8_t view = 0;         // index of the displayed timer
+    bool setup = false;       // the displayed timer is being set up, no automatic selection
+    uint32_t resetTs = 0;
+    volatile bool tickFlag = false;
 };
 
 
+/*
+ * Stopwatch parameters
+ */
+#define STOPWATCH_NUM_LAPS        8                               // size of the lap/split ring buffer
+#define STOPWATCH_MAX_TICKS       ((uint32_t)2 * 3600 * 100 - 1)  // maximum stopwatch value (1:59:59.99)
+#define STOPWATCH_BANNER_DURATION 1000                            // duration of the lap number display in ms
+
 /*
  * Stopwatch implementation class
+ * counts 1/100 s ticks, the time is only formatted when displayed
  */
 class StopwatchClass {
   public:
     void initialize (void (*callback)(bool start));
     void loopHandler (void);
-    void tick (void);
+
+    /*
+     * 1/100 s tick
+     * Must be called from within the Timer1 ISR
+     */
+    void tick (void) { if (running) ticks++; }
+
     void start (void);
     void stop (void);
+
+    /*
+     * Freeze/unfreeze the display while running
+     * freezing the display records the current time as a lap/split
+     */
     void pause (bool enable);
+
+    /*
+     * Browse the recorded laps while stopped
+     * cycles through the laps from the oldest to the newest, then back to the final time
+     */
+    void nextLap (void);
+
+    /*
+     * Toggle between the 1/10 s and 1/100 s display resolution
+     * has no effect if the stopwatch is active
+     */
+    void toggleResolution (void);
+
     void displayRefresh (void);
     void reset (void);
 
     bool active = false;
     bool running = false;
     bool paused = false;
+    bool hundredths = false;     // 1/100 s display resolution
+    uint8_t numLaps = 0;         // number of recorded laps
     NixieDigit_s digits[NIXIE_NUM_TUBES];
-    
+
   private:
-    ChronoClass tm;
-    volatile bool tickFlag = false;
+    uint32_t read (void);        // atomic copy of the tick counter
+    uint32_t lap (uint8_t idx);  // recorded lap, 0 = oldest
+    void show (uint32_t t);      // format a tick count into the display digits
+    volatile uint32_t ticks = 0; // elapsed time in 1/100 s
+    uint32_t shown = 0;          // tick count currently displayed
+    uint32_t laps[STOPWATCH_NUM_LAPS];  // lap/split ring buffer
+    uint8_t lapHead = 0;         // next lap slot
+    int8_t lapView = -1;         // lap being browsed, -1 = final time
+    bool banner = false;         // lap number being displayed
+    uint32_t bannerTs = 0;       // lap number display timestamp
     void (*callback)(bool) = NULL;
 };
 
 
 /*
- * Alarm modes
+ * Number of alarms
  */
-enum AlarmMode_e {
-  ALARM_OFF = 0,
-  ALARM_WEEKENDS = 2,
-  ALARM_WEEKDAYS = 5,
-  ALARM_DAILY = 7
-};
+#define ALARM_NUM 4
+
+/*
+ * Alarm day-of-week bit masks (bit 0 = Sunday ... bit 6 = Saturday, as tm_wday)
+ */
+#define ALARM_WEEKENDS 0x41
+#define ALARM_WEEKDAYS 0x3E
+#define ALARM_DAILY    0x7F
 
 /*
  * Alarm settings to be stored in EEPROM
  */
 struct AlarmEeprom_s {
-  int8_t hour;
-  int8_t minute;
-  AlarmMode_e mode;
-  AlarmMode_e lastMode;
+  int8_t  hour;
+  int8_t  minute;
+  uint8_t days;     // day-of-week bit mask
+  uint8_t enabled;  // 1 = enabled, 0 = disabled (the day-of-week mask is kept)
 };
 
 /*
  * Alarm clock implementation class
+ * handles several alarms, the next alarm time is precomputed
+ * whenever an alarm setting changes or the time jumps
  */
 class AlarmClass {
   public:
-    void initialize (AlarmEeprom_s * settings);
-    void loopHandler (int8_t hour, int8_t minute, int8_t wday, bool active);
+    void initialize (AlarmEeprom_s *settings, uint8_t numAlarms);
+
+    /*
+     * Main loop handler
+     * Parameters:
+     *   now     : current system time
+     *   localTm : current local time matching now
+     *   active  : alarms are allowed to start
+     */
+    void loopHandler (time_t now, const tm *localTm, bool active);
+
+    /*
+     * Recompute the next alarm time upon the next call of loopHandler()
+     * must be called whenever the time jumps or the time offset changes
+     */
+    void reschedule (void) { pending = true; }
+
+    /*
+     * Select the alarm to be displayed and edited
+     */
+    void selectNext (void);
+    void selectPrevious (void);
+    void selectUpcoming (void);  // the alarm that is due next, or the first alarm if none is enabled
+
     void startAlarm (void);
     void snooze (void);
     void resetAlarm (void);
-    void modeIncrease (void); 
+    void modeIncrease (void);
     void modeDecrease (void);
     void modeToggle (void);
     void minuteIncrease (void);
@@ -184,18 +333,22 @@ class AlarmClass {
 
     bool alarm = false;
     bool snoozing = false;
+    uint8_t sel = 0;               // selected alarm
+    time_t nextTime = 0;           // start time of the next alarm
+    int8_t nextIdx = -1;           // index of the next alarm, -1 if none
     NixieDigit_s digits[NIXIE_NUM_TUBES];
-    AlarmEeprom_s *settings = NULL;
 
   private:
-    uint32_t snoozeTs = 0; 
-    uint32_t alarmTs = 0;    
-    int8_t lastMinute = 0;
+    void schedule (time_t now, const tm *localTm);
+    void changed (void);           // a setting of the selected alarm has been changed
+    AlarmEeprom_s *settings = NULL;
+    uint8_t numAlarms = 0;
+    bool pending = true;           // the next alarm time needs to be recomputed
+    time_t lastTime = 0;           // start time of the last alarm, never starts twice
+    uint32_t snoozeTs = 0;
+    uint32_t alarmTs = 0;
     uint32_t blinkTs = 0;
-    bool alarmCondition = false;
 };
 
 
-
-
 #endif // __FEATURES_H
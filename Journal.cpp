@@ -0,0 +1,213 @@
+/* 
+ * Journaled and wear-leveled EEPROM storage
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Journal.h"
+#include <EEPROM.h>
+#include <assert.h>
+#include <util/crc16.h>
+#include "EepromQueue.h"
+
+
+/*
+ * Journal area layout:
+ *   header : epoch, start slot, check byte
+ *   slots  : records of RECORD_SIZE bytes
+ * Record layout:
+ *   epoch tag, offset within the data structure, value, check byte
+ * The check byte is a CRC-8 (CCITT polynomial 0x07), such that swapped or compensating
+ * byte errors of a torn record write are detected as well.
+ * Records are valid if tagged with the current epoch and if their check byte matches,
+ * compaction invalidates all records at once by incrementing the epoch.
+ * All writes go through the EEPROM write queue, its FIFO order ensures that
+ * the base copy is complete before the header of the new epoch is written.
+ */
+#define HEADER_SIZE      3
+#define RECORD_SIZE      4
+#define EPOCH_MAX        0xFE   // 0xFF is reserved for erased EEPROM cells
+#define COMPACT_THRESHOLD(n) ((n) / 2)  // number of records that triggers the background compaction
+#define CHECK_INIT       0xA5   // non-zero initial value, such that all-zero slots are invalid
+
+
+JournalClass Journal;
+
+
+/*
+ * Check byte over the three data bytes of a header or a record
+ */
+static uint8_t check (uint8_t a, uint8_t b, uint8_t c) {
+  uint8_t crc = CHECK_INIT;
+  crc = _crc8_ccitt_update (crc, a);
+  crc = _crc8_ccitt_update (crc, b);
+  crc = _crc8_ccitt_update (crc, c);
+  return crc;
+}
+
+
+void JournalClass::initialize (uint16_t baseAddr, uint16_t journalAddr, uint16_t journalSize, uint8_t *data, uint8_t size) {
+  uint8_t header[HEADER_SIZE];
+  uint8_t rec[RECORD_SIZE];
+  uint8_t i, slot;
+
+  assert (size <= JOURNAL_MAX_DATA_SIZE);
+  assert (baseAddr + size <= journalAddr && journalAddr + journalSize <= EEPROM.length ());
+  this->baseAddr    = baseAddr;
+  this->journalAddr = journalAddr;
+  this->numSlots    = (journalSize - HEADER_SIZE) / RECORD_SIZE;
+  this->data        = data;
+  this->size        = size;
+
+  EepromQueue.read (baseAddr, data, size);
+
+  // first-time boot or corrupted header
+  EepromQueue.read (journalAddr, header, HEADER_SIZE);
+  if (header[0] > EPOCH_MAX || header[1] >= numSlots || header[2] != check (header[0], header[1], 0)) {
+    format ();
+  }
+  else {
+    epoch = header[0];
+    start = header[1];
+    count = 0;
+
+    // replay the records of the current epoch in order of appearance
+    for (i = 0; i < numSlots; i++) {
+      slot = start + i;
+      if (slot >= numSlots) slot -= numSlots;
+      EepromQueue.read (recordAddr (slot), rec, RECORD_SIZE);
+      if (rec[0] != epoch || rec[1] >= size || rec[3] != check (rec[0], rec[1], rec[2])) break;
+      data[rec[1]] = rec[2];
+      count++;
+    }
+  }
+
+  for (i = 0; i < size; i++) shadow[i] = data[i];
+  compacting = false;
+}
+
+
+void JournalClass::write (void) {
+  uint8_t i;
+
+  for (i = 0; i < size; i++) {
+    if (data[i] != shadow[i]) {
+      // no free slot left: complete the compaction before appending
+      if (count >= numSlots) compact ();
+      append (i, data[i]);
+    }
+  }
+}
+
+
+void JournalClass::loopHandler (void) {
+  if (!compacting) {
+    if (count < COMPACT_THRESHOLD (numSlots)) return;
+    compacting = true;
+    compactIdx = 0;
+  }
+  if (compactStep ()) {
+    writeHeader (epoch >= EPOCH_MAX ? 0 : epoch + 1, start + count >= numSlots ? start + count - numSlots : start + count);
+    compacting = false;
+  }
+}
+
+
+void JournalClass::append (uint8_t offset, uint8_t value) {
+  uint8_t rec[RECORD_SIZE];
+  uint8_t slot = start + count;
+
+  if (slot >= numSlots) slot -= numSlots;
+  rec[0] = epoch;
+  rec[1] = offset;
+  rec[2] = value;
+  rec[3] = check (epoch, offset, value);
+  EepromQueue.write (recordAddr (slot), rec, RECORD_SIZE);
+  shadow[offset] = value;
+  count++;
+
+  // a pending compaction must re-check the updated byte
+  compactIdx = 0;
+}
+
+
+bool JournalClass::compactStep (void) {
+  uint16_t addr;
+
+  while (compactIdx < size) {
+    addr = baseAddr + compactIdx;
+    compactIdx++;
+    if (EepromQueue.read (addr) != shadow[compactIdx - 1]) {
+      EepromQueue.write (addr, shadow[compactIdx - 1]);
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void JournalClass::compact (void) {
+  compactIdx = 0;
+  while (!compactStep ());
+  writeHeader (epoch >= EPOCH_MAX ? 0 : epoch + 1, start + count >= numSlots ? start + count - numSlots : start + count);
+  compacting = false;
+}
+
+
+void JournalClass::writeHeader (uint8_t epoch, uint8_t start) {
+  uint8_t header[HEADER_SIZE];
+
+  // stale records might carry the same tag after the epoch wraps around
+  if (epoch == 0) {
+    format ();
+    return;
+  }
+  this->epoch = epoch;
+  this->start = start;
+  this->count = 0;
+  header[0] = epoch;
+  header[1] = start;
+  header[2] = check (epoch, start, 0);
+  EepromQueue.write (journalAddr, header, HEADER_SIZE);
+}
+
+
+void JournalClass::format (void) {
+  uint8_t header[HEADER_SIZE];
+  uint8_t slot;
+
+  // the base copy is up to date at this point, erase the record tags
+  for (slot = 0; slot < numSlots; slot++) EepromQueue.write (recordAddr (slot), 0xFF);
+  epoch = 0;
+  start = 0;
+  count = 0;
+  header[0] = epoch;
+  header[1] = start;
+  header[2] = check (epoch, start, 0);
+  EepromQueue.write (journalAddr, header, HEADER_SIZE);
+}
+
+
+uint16_t JournalClass::recordAddr (uint8_t slot) {
+  return journalAddr + HEADER_SIZE + (uint16_t)slot * RECORD_SIZE;
+}
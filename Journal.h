@@ -0,0 +1,102 @@
+/* 
+ * Journaled and wear-leveled EEPROM storage
+ *
+ * Changes to a data structure are appended to a ring of small log records
+ * instead of rewriting the whole structure in place. The log is replayed
+ * on startup and compacted into the base copy in the background.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+#include <Arduino.h>
+
+/*
+ * Maximum size of the journaled data structure in bytes
+ */
+#define JOURNAL_MAX_DATA_SIZE 64
+
+
+/*
+ * Journal class
+ */
+class JournalClass {
+
+  public:
+
+    /*
+     * Initialize the journal
+     * reads the base copy of the data structure from EEPROM and replays the journal
+     * formats the journal area upon first-time boot
+     * Parameters:
+     *   baseAddr    : EEPROM address of the base copy of the data structure
+     *   journalAddr : EEPROM address of the journal area
+     *   journalSize : size of the journal area in bytes
+     *   data        : pointer to the data structure
+     *   size        : size of the data structure in bytes (max. JOURNAL_MAX_DATA_SIZE)
+     */
+    void initialize (uint16_t baseAddr, uint16_t journalAddr, uint16_t journalSize, uint8_t *data, uint8_t size);
+
+    /*
+     * Append the changed bytes of the data structure to the journal
+     * compacts the journal immediately if it runs full
+     */
+    void write (void);
+
+    /*
+     * Background compaction of the journal into the base copy
+     * queues at most one byte write per call
+     * must be called periodically from within the main loop
+     */
+    void loopHandler (void);
+
+  private:
+    void append (uint8_t offset, uint8_t value);  // append a single record
+    bool compactStep (void);                      // copy the next changed byte to the base copy, returns true when done
+    void compact (void);                          // complete the compaction
+    void writeHeader (uint8_t epoch, uint8_t start);  // start a new journal epoch
+    void format (void);                           // erase the journal area
+    uint16_t recordAddr (uint8_t slot);           // EEPROM address of a record slot
+    uint16_t baseAddr;                            // EEPROM address of the base copy
+    uint16_t journalAddr;                         // EEPROM address of the journal area
+    uint8_t numSlots;                             // number of record slots within the journal area
+    uint8_t *data;                                // pointer to the data structure
+    uint8_t size;                                 // size of the data structure
+    uint8_t shadow[JOURNAL_MAX_DATA_SIZE];        // data structure contents as stored in EEPROM
+    uint8_t epoch = 0;                            // current epoch, tags the valid records
+    uint8_t start = 0;                            // first record slot of the current epoch
+    uint8_t count = 0;                            // number of records within the current epoch
+    uint8_t compactIdx = 0;                       // next byte to be checked by the background compaction
+    bool compacting = false;                      // background compaction is in progress
+};
+
+
+/*
+ * Journal object as a singleton
+ */
+extern JournalClass Journal;
+
+
+#endif // __JOURNAL_H
@@ -24,120 +24,252 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <avr/wdt.h>
 #include "Nixie.h"
+#include "NixiePinMap.h"
+#include "Progmem.h"
 
 
-#define DIGIT_PERIOD        3000
+#ifdef NIXIE_ISR_MULTIPLEX
+#define MAX_ON_DURATION     2800  // shorter margin thanks to the hardware timed turn-off
+#else
 #define MAX_ON_DURATION     2680
+#endif
 #define BLINK_PERIOD        500000
 #define SCROLL_PERIOD_1     1000000
 #define SCROLL_PERIOD_2     300000
 #define SLOT_MACHINE_PERIOD 40000
 #define CPP_PERIOD          200000
 #define NUM_BCD_PINS        4
+#define NUM_DEC_DIGITS      10                           // maximum number of decimal digits of a 32-bit value
+#define MAX_ON_TICKS        (MAX_ON_DURATION / NIXIE_TIMER0_TICK) // maximum anode on-time in Timer0 ticks
+#define NUM_BRIGHTNESS      100                          // number of brightness values (see setBrightness())
+
+
+/*
+ * Perceptual brightness curve: display duty cycle of every brightness value
+ * duty = 10 + 990 * ((brightness - 1) / 98) ^ 2.2, brightness 0 turns the display off
+ */
+static const uint16_t gammaDuty[NUM_BRIGHTNESS] PROGMEM = {
+     0,   10,   10,   10,   10,   11,   11,   12,   13,   14,
+    15,   17,   18,   20,   22,   24,   26,   28,   31,   34,
+    37,   40,   43,   47,   51,   55,   59,   63,   68,   73,
+    78,   83,   89,   94,  100,  106,  113,  119,  126,  133,
+   140,  148,  156,  163,  172,  180,  189,  198,  207,  216,
+   225,  235,  245,  256,  266,  277,  288,  299,  311,  322,
+   334,  346,  359,  372,  385,  398,  411,  425,  439,  453,
+   468,  482,  497,  512,  528,  544,  560,  576,  592,  609,
+   626,  643,  661,  679,  697,  715,  734,  753,  772,  791,
+   811,  831,  851,  872,  892,  913,  935,  956,  978, 1000
+};
 
 
 NixieClass Nixie;
 
 
+/*
+ * Slot machine effect: initial and maximum iteration counts of every tube
+ */
+const uint8_t NixieClass::slotMachineCntStart[NIXIE_NUM_TUBES] PROGMEM = {  0, 11,  5, 13,  9, 15 };
+const uint8_t NixieClass::slotMachineCntMax[NIXIE_NUM_TUBES]   PROGMEM = { 20, 50, 30, 60, 40, 70 };
+
+
+/*
+ * Runtime pin map: port access through the port bit masks derived by initialize()
+ * used by the multiplexing templates unless NIXIE_DRIVER() instantiates them for
+ * a compile-time pin map
+ */
+class NixieRuntimePins {
+  public:
+    static void portWrite (const uint8_t *frame) {
+      uint8_t p;
+      // set the BCD and comma pins first, then turn on the anode
+      for (p = 0; p < NIXIE_NUM_PORTS; p++) *Nixie.portReg[p] = (*Nixie.portReg[p] & ~Nixie.clearMask[p]) | (frame[p] & ~Nixie.anodesMask[p]);
+      for (p = 0; p < NIXIE_NUM_PORTS; p++) *Nixie.portReg[p] |= frame[p] & Nixie.anodesMask[p];
+    }
+    static void portOff (void) {
+      uint8_t p;
+      for (p = 0; p < NIXIE_NUM_PORTS; p++) *Nixie.portReg[p] &= ~Nixie.offMask[p];
+    }
+    static void portClear (void) {
+      uint8_t p;
+      for (p = 0; p < NIXIE_NUM_PORTS; p++) *Nixie.portReg[p] &= ~Nixie.clearMask[p];
+    }
+};
+
+
+/*
+ * Runtime pin map versions of the display driver, weak such that NIXIE_DRIVER() replaces them
+ */
+#ifdef NIXIE_ISR_MULTIPLEX
+ISR (TIMER0_COMPA_vect, __attribute__ ((weak))) {
+  Nixie.isrHandler<NixieRuntimePins> ();
+}
+
+ISR (TIMER0_COMPB_vect, __attribute__ ((weak))) {
+  Nixie.isrCutHandler<NixieRuntimePins> ();
+}
+#else
+__attribute__ ((weak)) void NixieClass::refresh (void) {
+  poll<NixieRuntimePins> ();
+}
+#endif
+
+__attribute__ ((weak)) void NixieClass::blank (void) {
+  cli ();
+  NixieRuntimePins::portClear ();
+  sei ();
+}
+
+
+/*
+ * Add the port bit mask of a digital pin to a port mask array
+ */
+static void addPinMask (uint8_t pin, uint8_t *mask) {
+  uint8_t port = digitalPinToPort (pin);
+  if (port >= PB && port < PB + NIXIE_NUM_PORTS) mask[port - PB] |= digitalPinToBitMask (pin);
+}
+
+
 void NixieClass::initialize ( uint8_t anodePin0, uint8_t anodePin1, uint8_t anodePin2, uint8_t anodePin3, 
         uint8_t anodePin4, uint8_t anodePin5, uint8_t bcdPin0, uint8_t bcdPin1, uint8_t bcdPin2, 
         uint8_t bcdPin3, uint8_t commaPin, NixieDigit_s *digits, uint8_t numDigits, uint8_t brightness) {
 
-  uint8_t i;
-  this->anodePin[0] = anodePin0;
-  this->anodePin[1] = anodePin1;
-  this->anodePin[2] = anodePin2;
-  this->anodePin[3] = anodePin3;
-  this->anodePin[4] = anodePin4;
-  this->anodePin[5] = anodePin5;
-  this->bcdPin[0] = bcdPin0;
-  this->bcdPin[1] = bcdPin1;
-  this->bcdPin[2] = bcdPin2;
-  this->bcdPin[3] = bcdPin3;
-  this->commaPin = commaPin;
-  this->digits = digits;
-  this->numDigits = numDigits;
-  this->digitOnDuration = map (brightness, 0, 255, 0, MAX_ON_DURATION);
+  uint8_t i, p;
+  const uint8_t anodePin[NIXIE_NUM_TUBES] = { anodePin0, anodePin1, anodePin2, anodePin3, anodePin4, anodePin5 };
+  const uint8_t bcdPin[NUM_BCD_PINS] = { bcdPin0, bcdPin1, bcdPin2, bcdPin3 };
 
-  // initialize output pins
+  // initialize output pins and derive their port bit masks
   for (i = 0; i < NIXIE_NUM_TUBES; i++) {
     pinMode (anodePin[i], OUTPUT);
     digitalWrite (anodePin[i], LOW);
+    addPinMask (anodePin[i], anodeMask[i]);
+    addPinMask (anodePin[i], anodesMask);
   }
   for (i = 0; i < NUM_BCD_PINS; i++) {
     pinMode (bcdPin[i], OUTPUT);
     digitalWrite (bcdPin[i], LOW);
+    addPinMask (bcdPin[i], bcdMask[i]);
+    addPinMask (bcdPin[i], clearMask);
   }
   pinMode (commaPin, OUTPUT);
   digitalWrite (commaPin, LOW); 
+  addPinMask (commaPin, commaMask);
+
+  for (p = 0; p < NIXIE_NUM_PORTS; p++) {
+    portReg[p]    = portOutputRegister (PB + p);
+    offMask[p]    = anodesMask[p] | commaMask[p];
+    clearMask[p] |= offMask[p];
+  }
+
+  begin (digits, numDigits, brightness);
+}
+
+
+void NixieClass::begin (NixieDigit_s *digits, uint8_t numDigits, uint8_t brightness) {
+  this->digits = digits;
+  this->numDigits = numDigits;
+  for (uint8_t i = 0; i < NIXIE_NUM_TUBES; i++) frameKey[i] = 0xFF;  // force compiling every tube
+  setDuty (map (brightness, 0, 255, 0, NIXIE_DUTY_MAX));
+
+#ifdef NIXIE_ISR_MULTIPLEX
+  // Timer0 is shared with millis(): switch it from fast PWM to normal mode
+  // for the compare match registers to be updated immediately (no analogWrite() on pins 5 and 6)
+  // the overflow period of 256 ticks remains unchanged
+  cli ();
+  TCCR0A &= ~(_BV(WGM01) | _BV(WGM00));
+  OCR0A   = TCNT0 + NIXIE_ISR_QUANTUM;
+  TIFR0   = _BV(OCF0A) | _BV(OCF0B);
+  TIMSK0 &= ~_BV(OCIE0B);
+  TIMSK0 |= _BV(OCIE0A);
+  sei ();
+#endif
 }
 
 
 void NixieClass::setDigits (NixieDigit_s *digits, uint8_t numDigits) {
+  cli ();
   this->digits = digits;
   this->numDigits = numDigits;
+  blinkOverlay = 0;
+  sei ();
+}
+
+
+void NixieClass::setComma (uint8_t tube, bool enable) {
+  cli ();
+  if (enable) commaOverlay |=  (1 << tube);
+  else        commaOverlay &= ~(1 << tube);
+  sei ();
+}
+
+
+
+#ifdef NIXIE_ISR_MULTIPLEX
+void NixieClass::attachTick (void (*callback)(void)) {
+  cli ();
+  tickCallback = callback;
+  sei ();
+}
+#endif
+
+
+void NixieClass::slotStats (uint32_t ts) {
+  uint32_t gap = ts - slotTs;
+  if (gap > maxSlotGap) maxSlotGap = gap;
+  if (gap >= 2 * NIXIE_DIGIT_PERIOD) missedSlots++;
+  slotTs = ts;
+}
+
+
+void NixieClass::resetStats (void) {
+  cli ();
+  maxSlotGap  = 0;
+  missedSlots = 0;
+  sei ();
 }
 
-void NixieClass::refresh (void) {
 
-  uint8_t bcdVal;
+void NixieClass::compile (uint8_t tube) {
+
+  uint8_t p, b, val, bcdVal, key, dim = 0;
   bool commaVal, anodeVal;
-  uint32_t ts = micros ();
+  NixieDigit_s *d = &digits[tube + scrollOffset];  // base view within the scroll window
 
-  // display disabled
-  if (!enabled) {
-    wdt_reset ();
-    // keep rotating digits to avoid delayed "Slot Machine" effect
-    digit++;
-    if (digit >= NIXIE_NUM_TUBES) digit = 0;   
-  }
-  
-  // display multiplexing by switching digits
-  else if (ts - lastTs >= DIGIT_PERIOD) {
-    
-    wdt_reset (); // reset the watchdog timer
-    
-    digitalWrite (anodePin[digit], LOW); 
-    
-    digit++;
-    if (digit >= NIXIE_NUM_TUBES) digit = 0;
-    
-    bcdVal = digits[digit + scrollOffset].value;
-
-    if (slotMachineEnabled[digit] || cppEnabled) {
-      // produce "Slot Machine" or CPP effect 
-      bcdVal += slotMachineCnt[digit] + cppCnt;
-      while (bcdVal > 9) bcdVal -= 10; 
-    }
+  bcdVal = d->value;
 
-    commaVal = digits[digit + scrollOffset].comma || comma[digit] || cppEnabled || slotMachineEnabled[digit];
-    anodeVal = !(blinkFlag && (digits[digit + scrollOffset].blink || blinkAllEnabled || blinkCount)) && !digits[digit + scrollOffset].blank;
-
-    // decimal point shall never be blanked
-    // reduce brightness by dimFactor for decimal points without digits
-    if (commaVal && !anodeVal) dimFactor = 2, anodeVal = true, bcdVal = 10;
-    
-    digitalWrite (bcdPin[0],  bcdVal       & 1);
-    digitalWrite (bcdPin[1], (bcdVal >> 1) & 1);
-    digitalWrite (bcdPin[2], (bcdVal >> 2) & 1);
-    digitalWrite (bcdPin[3], (bcdVal >> 3) & 1);
-    digitalWrite (commaPin, commaVal);
-    digitalWrite (anodePin[digit], anodeVal);
-     
-    lastTs = ts;
+  if (slotMachineEnabled[tube] || cppEnabled) {
+    // produce "Slot Machine" or CPP effect 
+    bcdVal += slotMachineCnt[tube] + cppCnt;
+    while (bcdVal > 9) bcdVal -= 10; 
   }
-  
-  // turn off all opto-coupler controlled pins ahead of time, this avoids ghost numbers
-  // also control brightness by reducing anode on time
-  // reduce on duration by dimFactor for decimal points without digits
-  else if (ts - lastTs >= (digitOnDuration >> dimFactor)) {
-    
-    digitalWrite (anodePin[digit], LOW);  
-    digitalWrite (commaPin, LOW); 
-    dimFactor = 0;
+
+  // apply the overlay layers
+  commaVal = d->comma || ((commaOverlay >> tube) & 1) || cppEnabled || slotMachineEnabled[tube];
+  anodeVal = !(blinkFlag && (d->blink || ((blinkOverlay >> tube) & 1) || blinkAllEnabled || blinkCount)) && !d->blank;
+
+  // decimal point shall never be blanked
+  // reduce brightness by dimFactor for decimal points without digits
+  if (commaVal && !anodeVal) dim = 2, anodeVal = true, bcdVal = 10;
+
+  // the port values only need to be recompiled if the composited tube has changed
+  key = bcdVal | (commaVal << 4) | (anodeVal << 5) | ((dim > 0) << 6);
+  if (key == frameKey[tube]) return;
+  frameKey[tube] = key;
+
+  for (p = 0; p < NIXIE_NUM_PORTS; p++) {
+    val = 0;
+    for (b = 0; b < NUM_BCD_PINS; b++) {
+      if ((bcdVal >> b) & 1) val |= bcdMask[b][p];
+    }
+    if (commaVal) val |= commaMask[p];
+    if (anodeVal) val |= anodeMask[tube][p];
+    frame[tube][p] = val;
   }
+  frameDim[tube] = dim;
+}
+
+
+void NixieClass::effects (uint32_t ts) {
 
   // toggle blinking digits
   if (ts - blinkTs > BLINK_PERIOD / (1 + (blinkCount > 0))) {
@@ -150,7 +282,7 @@ void NixieClass::refresh (void) {
   if (slotMachineEnabled[digit]) { 
     if (ts - slotMachineTs[digit] > slotMachineDelay[digit]) {
       slotMachineCnt[digit]++;
-      if (slotMachineCnt[digit] >= slotMachineCntMax[digit]) {
+      if (slotMachineCnt[digit] >= progmemRead (&slotMachineCntMax[digit])) {
         slotMachineEnabled[digit] = false;
         slotMachineCnt[digit] = 0;
       }
@@ -179,8 +311,34 @@ void NixieClass::refresh (void) {
 }
 
 
-void NixieClass::setBrightness (uint8_t brightness) {
-  this->digitOnDuration = map (brightness, 0, 99, 0, MAX_ON_DURATION);
+void NixieClass::setBrightness (uint8_t brightness, uint8_t fraction) {
+  uint16_t duty, next;
+  if (brightness >= NUM_BRIGHTNESS - 1) {
+    brightness = NUM_BRIGHTNESS - 1;
+    fraction   = 0;
+  }
+  duty = pgm_read_word (&gammaDuty[brightness]);
+  // linear interpolation towards the next brightness value
+  if (fraction > 0) {
+    next  = pgm_read_word (&gammaDuty[brightness + 1]);
+    duty += ((next - duty) * fraction) >> 8;  // 16-bit product, adjacent values differ by less than 256
+  }
+  setDuty (duty);
+}
+
+void NixieClass::setDuty (uint16_t duty) {
+  if (duty > NIXIE_DUTY_MAX) duty = NIXIE_DUTY_MAX;
+  // precompute the on-time outside of the time critical section
+  uint32_t duration = (uint32_t)duty * MAX_ON_DURATION / NIXIE_DUTY_MAX;
+#ifdef NIXIE_ISR_MULTIPLEX
+  uint16_t ticks = (uint32_t)duty * MAX_ON_TICKS / NIXIE_DUTY_MAX;
+#endif
+  cli ();
+  this->digitOnDuration = duration;
+#ifdef NIXIE_ISR_MULTIPLEX
+  this->dutyTicks = ticks;
+#endif
+  sei ();
 }
 
 void NixieClass::blinkAll (bool enable) {
@@ -193,72 +351,127 @@ void NixieClass::blinkOnce (void) {
 }
 
 void NixieClass::resetBlinking (void) {
-  blinkTs = micros ();
+  uint32_t ts = micros ();
+  cli ();
+  blinkTs = ts;
   blinkFlag = false;
+  sei ();
 }
 
 void NixieClass::slotMachine (void) {
   uint8_t i;
+  cli ();
   for (i = 0; i < NIXIE_NUM_TUBES; i++) {
     slotMachineEnabled[i] = true;
-    slotMachineCnt[i] = slotMachineCntStart[i];
+    slotMachineCnt[i] = progmemRead (&slotMachineCntStart[i]);
     slotMachineDelay[i] = 0;
   }
+  sei ();
 }
 
 void NixieClass::cathodePoisonPrevent (void) {
+  uint32_t ts = micros ();
+  cli ();
   cppEnabled = true;
   cppCnt = 0;
-  cppTs = micros () - CPP_PERIOD;
+  cppTs = ts - CPP_PERIOD;
+  sei ();
 }
 
 void NixieClass::scroll (void) {
+  uint32_t ts = micros ();
+  cli ();
   if (numDigits > NIXIE_NUM_TUBES) scrollOffset = numDigits - NIXIE_NUM_TUBES;
-  scrollTs = micros ();
+  scrollTs = ts;
+  sei ();
 }
 
 void NixieClass::cancelScroll (void) {
   scrollOffset = 0;
 }
 
-void NixieClass::blank (void) {
-  uint8_t i;
-  for (i = 0; i < NIXIE_NUM_TUBES; i++) digitalWrite (anodePin[i], LOW); 
-  for (i = 0; i < NUM_BCD_PINS;    i++) digitalWrite (bcdPin[i],   LOW);
-  digitalWrite (commaPin, LOW);
-}
-
 void NixieClass::enable (bool enable) {
   enabled = enable;
   if (!enabled) blank ();
 }
 
-void NixieClass::dec2bcd (uint32_t value, NixieDigit_s* output, uint8_t outputSize, uint8_t numDigits) {
-  uint8_t i, n;
-  uint64_t p = 1;
-  //bool leadingZero = true; 
-  
-  if (numDigits > outputSize) numDigits = outputSize;
-  n = numDigits;
+void NixieClass::dec2bcd (uint32_t value, NixieDigit_s* output, uint8_t outputSize, uint8_t numDigits, bool leadingBlank) {
+  static const uint32_t pow10[NUM_DEC_DIGITS] PROGMEM =
+      { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+  int8_t i;
+  uint8_t d;
+  uint32_t p;
+  bool leading = leadingBlank;
 
-  for (i = 0; i < n; i++) output[i].value = 0;
-  for (i = 0; i < n; i++) p = p * 10;    
+  if (numDigits > outputSize) numDigits = outputSize;
 
-  while (value >= p) value -= p;
+  for (i = numDigits - 1; i >= NUM_DEC_DIGITS; i--) {
+    output[i].value = 0;
+    if (leadingBlank) output[i].blank = true;
+  }
 
-  for (i = 0; i < n; i++) {
-    p = p / 10;
+  // division-free conversion by successive subtraction of the powers of ten
+  // digits above numDigits are discarded
+  for (i = NUM_DEC_DIGITS - 1; i >= 0; i--) {
+    d = 0;
+    p = progmemRead (&pow10[i]);
     while (value >= p) {
       value -= p;
-      output[n - i - 1].value++;
+      d++;
+    }
+    if (d > 0 || i == 0) leading = false;
+    if (i < numDigits) {
+      output[i].value = d;
+      if (leadingBlank) output[i].blank = leading;
     }
-    //if (output->value[i] > 0) leadingZero = false;
-    //if (leadingZero) output->blank[i] = true;
-    //else output->blank[i] = false;
   }
 }
 
 
+void NixieClass::formatSigned (int32_t value, NixieDigit_s *output, uint8_t outputSize, uint8_t numDigits, bool leadingBlank) {
+  uint8_t i;
+
+  if (numDigits > outputSize) numDigits = outputSize;
+  dec2bcd (value < 0 ? (uint32_t)(-value) : (uint32_t)value, output, outputSize, numDigits, leadingBlank);
+  for (i = 0; i < numDigits; i++) output[i].comma = (value < 0);
+}
+
+
+void NixieClass::formatId (NixieDigit_s *output, uint8_t numDigits, uint8_t id) {
+  output[numDigits - 1].value = id;
+  output[numDigits - 1].comma = true;
+  output[numDigits - 2].blank = true;
+}
+
+
+void NixieClass::formatDate (NixieDigit_s *output, uint8_t day, uint8_t month, uint8_t year) {
+  bcd2 (day,   &output[4]);
+  bcd2 (month, &output[2]);
+  bcd2 (year,  &output[0]);
+  output[4].comma = true;
+  output[2].comma = true;
+}
+
+
+void NixieClass::formatTime (NixieDigit_s *output, uint8_t hour, uint8_t minute, uint8_t second) {
+  bcd2 (hour,   &output[4]);
+  bcd2 (minute, &output[2]);
+  bcd2 (second, &output[0]);
+}
+
+
+void NixieClass::bcd2 (uint8_t value, NixieDigit_s *output) {
+  uint8_t high = 0;
+  while (value >= 100) value -= 100;
+  while (value >= 10) {
+    value -= 10;
+    high++;
+  }
+  output[1].value = high;
+  output[0].value = value;
+}
+
+
 void NixieClass::resetDigits (NixieDigit_s *output, uint8_t outputSize) {
   int8_t i;
 
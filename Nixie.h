@@ -34,6 +34,32 @@
  */
 #define NIXIE_NUM_TUBES 6
 
+/*
+ * Drive the display multiplexing from the Timer0 compare match A interrupt
+ * instead of polling refresh() from within the main loop
+ * comment out in order to revert to the polled display multiplexing
+ */
+#define NIXIE_ISR_MULTIPLEX
+
+/*
+ * Maximum value of the display duty cycle (see setDuty())
+ */
+#define NIXIE_DUTY_MAX 1000
+
+/*
+ * Number of I/O ports that can be used for driving the display (PORTB, PORTC and PORTD)
+ */
+#define NIXIE_NUM_PORTS 3
+
+/*
+ * Display multiplexing timing
+ */
+#define NIXIE_DIGIT_PERIOD  3000                   // digit slot period in µs
+#define NIXIE_TIMER0_TICK   (64000000UL / F_CPU)   // duration of a Timer0 tick in µs (Arduino prescaler = 64)
+#define NIXIE_ISR_QUANTUM   250                    // Timer0 ticks between two compare match A events (1 ms)
+#define NIXIE_SLOT_QUANTA   (NIXIE_DIGIT_PERIOD / NIXIE_TIMER0_TICK / NIXIE_ISR_QUANTUM)  // digit period in compare match A events
+#define NIXIE_CUT_LEAD      2                      // minimum Timer0 ticks needed for arming the compare match B
+
 
 /*
  * Nixie tube digit structure
@@ -55,6 +81,7 @@ class NixieClass {
 
     /*
      * Initialize the hardware
+     * the port bit masks of the pins are derived at runtime
      * Parameters:
      *   anodePin0..5 : anode control pins
      *   bcdPin0..5   : pins connected to the BCD to decimal anode driver decoder chip (74141, K155ID1)
@@ -80,8 +107,22 @@ class NixieClass {
             uint8_t brightness = 255
             );
 
+    /*
+     * Initialize the hardware using a compile-time pin map (opt-in alternative to the above)
+     * the port accessing functions are instantiated for the pin map by NIXIE_DRIVER(),
+     * which replaces the runtime pin map versions of the ISRs, refresh() and blank()
+     * (requires including NixiePinMap.h)
+     * Parameters:
+     *   PinMap     : pin map type NixiePinMap<anodePin0..5, bcdPin0..3, commaPin>
+     *   digits     : pointer to the Nixie digits array
+     *   numDigits  : number of Nixie digits
+     *   brightness : default brightness value (0.255)
+     */
+    template <class PinMap> void initialize (NixieDigit_s *digits, uint8_t numDigits, uint8_t brightness = 255);
+
     /* 
      * Set the pointer to the Nixie digits structure
+     * the digits array is displayed in place (base view), the blink overlay is cleared
      * Parameters:
      *   digits    : array of Nixie tube display digits
      *   numDigits : number of Nixie digits
@@ -91,16 +132,78 @@ class NixieClass {
     /* 
      * Refresh the display
      * This function must be called from within a very fast loop
+     * has no effect if NIXIE_ISR_MULTIPLEX is defined
      */
+#ifdef NIXIE_ISR_MULTIPLEX
+    void refresh (void) { }
+#else
     void refresh (void);
+#endif
+
+#ifdef NIXIE_ISR_MULTIPLEX
+    /*
+     * Display multiplexing handler
+     * Must be called from within the Timer0 compare match A ISR (see NIXIE_DRIVER())
+     */
+    template <class PinMap> void isrHandler (void);
+
+    /*
+     * Anode turn-off handler
+     * Must be called from within the Timer0 compare match B ISR (see NIXIE_DRIVER())
+     */
+    template <class PinMap> void isrCutHandler (void);
+
+    /*
+     * Register a function to be called at every display ISR tick (1 ms)
+     * the function is executed in interrupt context and must be short
+     * Parameters:
+     *   callback : tick function, NULL to detach
+     */
+    void attachTick (void (*callback)(void));
+#endif
 
     /*
      * Set display brightness
+     * the brightness is mapped to the duty cycle through a perceptual gamma curve
      * Parameters:
      *   brightness : 0..99
+     *   fraction   : fractional part of the brightness in 1/256 steps
+     */
+    void setBrightness (uint8_t brightness, uint8_t fraction = 0);
+
+    /*
+     * Set display brightness with a finer resolution
+     * the anode on-time is terminated by the Timer0 compare match B
+     * with a resolution of one Timer0 tick if NIXIE_ISR_MULTIPLEX is defined
+     * Parameters:
+     *   duty : 0..NIXIE_DUTY_MAX
      */
-    void setBrightness (uint8_t brightness);
+    void setDuty (uint16_t duty);
     
+    /*
+     * Set the blink overlay
+     * blinks the selected tubes on top of the base view, cleared by setDigits()
+     * Parameters:
+     *   mask : bit mask of the blinking tubes (bit 0 = tube 0)
+     */
+    void setBlink (uint8_t mask) { blinkOverlay = mask; }
+
+    /*
+     * Set the decimal point of a specific tube within the comma overlay
+     * disregarding the base view and the scroll effect
+     * Parameters:
+     *   tube   : tube index
+     *   enable : decimal point state
+     */
+    void setComma (uint8_t tube, bool enable);
+
+    /*
+     * Get the decimal point state of a specific tube within the comma overlay
+     * Parameters:
+     *   tube : tube index
+     */
+    bool getComma (uint8_t tube) { return (commaOverlay >> tube) & 1; }
+
     /*
      * Force blink all digits disregarding the individual digit selecten
      * Parameters:
@@ -145,8 +248,47 @@ class NixieClass {
      *   output     : pointer to the Nixie digits array
      *   outputSize : size of the Nixie digits array
      *   numDigits  : number of BCD digits to be converted
+     *   leadingBlank : blank the leading zeros
+     */
+    void dec2bcd (uint32_t value, NixieDigit_s *output, uint8_t outputSize, uint8_t numDigits, bool leadingBlank = false);
+
+    /*
+     * Convert a signed decimal value to Nixie digits BCD format
+     * negative values are indicated by activating the decimal points of all digits
+     * Parameters:
+     *   see dec2bcd()
+     */
+    void formatSigned (int32_t value, NixieDigit_s *output, uint8_t outputSize, uint8_t numDigits, bool leadingBlank = false);
+
+    /*
+     * Display an ID followed by a decimal point and a blank digit
+     * in front of a value (e.g. service menu item number)
+     * Parameters:
+     *   output    : pointer to the Nixie digits array
+     *   numDigits : total number of digits including the ID
+     *   id        : ID value (0..9)
+     */
+    void formatId (NixieDigit_s *output, uint8_t numDigits, uint8_t id);
+
+    /*
+     * Display a date in the DD.MM.YY format on 6 digits
+     * Parameters:
+     *   output : pointer to the Nixie digits array
+     *   day    : day of the month
+     *   month  : month
+     *   year   : year (only the last two digits are displayed)
+     */
+    void formatDate (NixieDigit_s *output, uint8_t day, uint8_t month, uint8_t year);
+
+    /*
+     * Display a time in the HHMMSS format on 6 digits
+     * Parameters:
+     *   output : pointer to the Nixie digits array
+     *   hour   : hours
+     *   minute : minutes
+     *   second : seconds
      */
-    void dec2bcd (uint32_t value, NixieDigit_s *output, uint8_t outputSize, uint8_t numDigits);
+    void formatTime (NixieDigit_s *output, uint8_t hour, uint8_t minute, uint8_t second);
 
     /*
      * Reset a Nixie Digit array
@@ -185,20 +327,55 @@ class NixieClass {
     uint8_t numDigits;
 
     /*
-     * Activate decimal point of a specific digit 
-     * disregarding the scroll effect
+     * Status of the CPP feature
      */
-    bool comma[NIXIE_NUM_TUBES] = { false };
+    bool cppEnabled = false;
 
     /*
-     * Status of the CPP feature
+     * Display multiplexing statistics
+     * maximum time between the beginning of two digit slots in µs
+     * and number of digits slots that have been delayed by more than one slot period
      */
-    bool cppEnabled = false;
+    volatile uint32_t maxSlotGap = 0;
+    volatile uint16_t missedSlots = 0;
+
+    /*
+     * Reset the display multiplexing statistics
+     */
+    void resetStats (void);
 
   private:
-    uint8_t anodePin [NIXIE_NUM_TUBES];
-    uint8_t bcdPin [4];
-    uint8_t commaPin;
+    void begin (NixieDigit_s *digits, uint8_t numDigits, uint8_t brightness);  // common initialization
+    template <class PinMap> void switchDigit (void);  // turn-off the current digit and turn-on the next one
+    template <class PinMap> void turnOff (void);      // turn-off the current digit ahead of time
+#ifndef NIXIE_ISR_MULTIPLEX
+    template <class PinMap> void poll (void);         // polled display multiplexing (see refresh())
+#endif
+    void compile (uint8_t tube);    // composite the layers and precompute the port values of a single tube
+    void effects (uint32_t ts);     // process the blinking, scrolling, "Slot Machine" and CPP effects
+    void bcd2 (uint8_t value, NixieDigit_s *output);  // convert the last two decimal digits of a value
+    void slotStats (uint32_t ts);   // update the display multiplexing statistics
+    uint32_t slotTs = 0;            // beginning of the last digit slot in µs
+#ifdef NIXIE_ISR_MULTIPLEX
+    template <class PinMap> void isrCut (uint8_t base, uint16_t ticks);  // arm the compare match B for turning-off the digit
+    uint16_t dutyTicks = 0;                      // anode on-time in Timer0 ticks
+    uint16_t isrCutTicks = 0xFFFF;               // Timer0 ticks from the current quantum until turning-off the digit
+    uint8_t isrQuantum = 0;                      // index of the current quantum within the digit slot
+    void (*volatile tickCallback)(void) = NULL;  // function called at every tick
+#endif
+    friend class NixieRuntimePins;                             // port access of the runtime pin map
+    volatile uint8_t *portReg[NIXIE_NUM_PORTS] = { &PORTB, &PORTC, &PORTD };  // output registers of the display ports
+    uint8_t anodeMask[NIXIE_NUM_TUBES][NIXIE_NUM_PORTS] = { }; // port bit masks of every anode pin
+    uint8_t bcdMask[4][NIXIE_NUM_PORTS] = { };                 // port bit masks of every BCD pin
+    uint8_t commaMask[NIXIE_NUM_PORTS] = { };                  // port bit mask of the comma pin
+    uint8_t anodesMask[NIXIE_NUM_PORTS] = { };                 // runtime pin map: port bit mask of all the anode pins
+    uint8_t offMask[NIXIE_NUM_PORTS] = { };                    // runtime pin map: port bit mask of all the anode and comma pins
+    uint8_t clearMask[NIXIE_NUM_PORTS] = { };                  // runtime pin map: port bit mask of all the display pins
+    uint8_t frame[NIXIE_NUM_TUBES][NIXIE_NUM_PORTS] = { };     // compiled port values of every tube
+    uint8_t frameDim[NIXIE_NUM_TUBES] = { 0 };                 // compiled dimFactor of every tube
+    uint8_t frameKey[NIXIE_NUM_TUBES];                         // composited state of every tube, the port values are only recompiled on change
+    volatile uint8_t commaOverlay = 0;                         // comma overlay layer as a bit mask of the tubes
+    volatile uint8_t blinkOverlay = 0;                         // blink overlay layer as a bit mask of the tubes
     uint32_t digitOnDuration;
     uint32_t lastTs = 0;
     uint32_t dimFactor = 0;
@@ -211,8 +388,8 @@ class NixieClass {
     uint32_t slotMachineTs[NIXIE_NUM_TUBES] = { 0 };
     uint8_t slotMachineCnt[NIXIE_NUM_TUBES] = { 0 };
     uint32_t slotMachineDelay[NIXIE_NUM_TUBES] = { 0 };
-    uint8_t slotMachineCntStart[NIXIE_NUM_TUBES] = {  0, 11,  5, 13,  9, 15 };
-    uint8_t slotMachineCntMax[NIXIE_NUM_TUBES]   = { 20, 50, 30, 60, 40, 70 };
+    static const uint8_t slotMachineCntStart[NIXIE_NUM_TUBES];  // stored in flash memory
+    static const uint8_t slotMachineCntMax[NIXIE_NUM_TUBES];
     uint32_t cppTs = 0;
     uint8_t cppCnt = 0;
     uint32_t scrollTs = 0;
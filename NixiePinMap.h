@@ -0,0 +1,331 @@
+/*
+ * Compile-time pin map for the Nixie tube display driver
+ *
+ * Resolves the Arduino pin numbers of the display into port registers
+ * and bit masks at compile time, the resulting port access functions
+ * consist of straight-line code with immediate masks.
+ * The multiplexing ISRs are instantiated for the pin map by NIXIE_DRIVER(),
+ * such that the port writes compile into direct I/O instructions.
+ * Assumes the standard ATmega328P Arduino pin mapping.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2019 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIXIE_PIN_MAP_H
+#define __NIXIE_PIN_MAP_H
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+#include "Nixie.h"
+
+
+/*
+ * Port index of an Arduino pin (0 = PORTB, 1 = PORTC, 2 = PORTD)
+ */
+constexpr uint8_t nixiePinPort (uint8_t pin) {
+  return pin < 8 ? 2 : (pin < 14 ? 0 : 1);
+}
+
+/*
+ * Port bit mask of an Arduino pin
+ */
+constexpr uint8_t nixiePinBit (uint8_t pin) {
+  return (uint8_t)(1 << (pin < 8 ? pin : (pin < 14 ? pin - 8 : pin - 14)));
+}
+
+/*
+ * Bit mask of an Arduino pin within a given port index, 0 if the pin belongs to another port
+ */
+constexpr uint8_t nixiePinMask (uint8_t pin, uint8_t port) {
+  return nixiePinPort (pin) == port ? nixiePinBit (pin) : 0;
+}
+
+
+/*
+ * Pin map class
+ * Parameters:
+ *   Anode0..5 : anode control pins
+ *   Bcd0..3   : BCD decoder pins
+ *   Comma     : comma pin
+ */
+template <uint8_t Anode0, uint8_t Anode1, uint8_t Anode2, uint8_t Anode3, uint8_t Anode4, uint8_t Anode5,
+          uint8_t Bcd0, uint8_t Bcd1, uint8_t Bcd2, uint8_t Bcd3, uint8_t Comma>
+class NixiePinMap {
+
+  static_assert (Anode0 < 20 && Anode1 < 20 && Anode2 < 20 && Anode3 < 20 && Anode4 < 20 && Anode5 < 20 &&
+                 Bcd0 < 20 && Bcd1 < 20 && Bcd2 < 20 && Bcd3 < 20 && Comma < 20, "Nixie pins must be digital pins 0..19");
+
+  public:
+
+    /*
+     * Bit mask of an anode pin within a port
+     */
+    static constexpr uint8_t anode (uint8_t tube, uint8_t port) {
+      return nixiePinMask (tube == 0 ? Anode0 : tube == 1 ? Anode1 : tube == 2 ? Anode2 : tube == 3 ? Anode3 : tube == 4 ? Anode4 : Anode5, port);
+    }
+
+    /*
+     * Bit mask of a BCD pin within a port
+     */
+    static constexpr uint8_t bcd (uint8_t idx, uint8_t port) {
+      return nixiePinMask (idx == 0 ? Bcd0 : idx == 1 ? Bcd1 : idx == 2 ? Bcd2 : Bcd3, port);
+    }
+
+    /*
+     * Bit mask of the comma pin within a port
+     */
+    static constexpr uint8_t comma (uint8_t port) {
+      return nixiePinMask (Comma, port);
+    }
+
+    /*
+     * Bit mask of all the anode pins within a port
+     */
+    static constexpr uint8_t anodes (uint8_t port) {
+      return anode (0, port) | anode (1, port) | anode (2, port) | anode (3, port) | anode (4, port) | anode (5, port);
+    }
+
+    /*
+     * Bit mask of all the anode and comma pins within a port
+     */
+    static constexpr uint8_t off (uint8_t port) {
+      return anodes (port) | comma (port);
+    }
+
+    /*
+     * Bit mask of all the display pins within a port
+     */
+    static constexpr uint8_t clear (uint8_t port) {
+      return off (port) | bcd (0, port) | bcd (1, port) | bcd (2, port) | bcd (3, port);
+    }
+
+    /*
+     * Apply the compiled port values of a tube
+     * set the BCD and comma pins first, then turn on the anode
+     */
+    static void portWrite (const uint8_t *frame) {
+      if (clear (0))  PORTB = (PORTB & ~clear (0)) | (frame[0] & ~anodes (0));
+      if (clear (1))  PORTC = (PORTC & ~clear (1)) | (frame[1] & ~anodes (1));
+      if (clear (2))  PORTD = (PORTD & ~clear (2)) | (frame[2] & ~anodes (2));
+      if (anodes (0)) PORTB |= frame[0] & anodes (0);
+      if (anodes (1)) PORTC |= frame[1] & anodes (1);
+      if (anodes (2)) PORTD |= frame[2] & anodes (2);
+    }
+
+    /*
+     * Turn-off the anode and comma pins
+     */
+    static void portOff (void) {
+      if (off (0)) PORTB &= ~off (0);
+      if (off (1)) PORTC &= ~off (1);
+      if (off (2)) PORTD &= ~off (2);
+    }
+
+    /*
+     * Turn-off all the display pins
+     */
+    static void portClear (void) {
+      if (clear (0)) PORTB &= ~clear (0);
+      if (clear (1)) PORTC &= ~clear (1);
+      if (clear (2)) PORTD &= ~clear (2);
+    }
+
+    /*
+     * Configure all the display pins as low outputs
+     */
+    static void portInit (void) {
+      portClear ();
+      if (clear (0)) DDRB |= clear (0);
+      if (clear (1)) DDRC |= clear (1);
+      if (clear (2)) DDRD |= clear (2);
+    }
+};
+
+
+template <class PinMap>
+void NixieClass::initialize (NixieDigit_s *digits, uint8_t numDigits, uint8_t brightness) {
+  uint8_t i, p;
+
+  PinMap::portInit ();
+
+  // the mask tables are only required for compiling the frame
+  for (p = 0; p < NIXIE_NUM_PORTS; p++) {
+    for (i = 0; i < NIXIE_NUM_TUBES; i++) anodeMask[i][p] = PinMap::anode (i, p);
+    for (i = 0; i < 4; i++) bcdMask[i][p] = PinMap::bcd (i, p);
+    commaMask[p] = PinMap::comma (p);
+  }
+
+  begin (digits, numDigits, brightness);
+}
+
+
+template <class PinMap>
+void NixieClass::switchDigit (void) {
+  uint8_t next;
+
+  digit++;
+  if (digit >= NIXIE_NUM_TUBES) digit = 0;
+
+  // time critical section: apply the precompiled port values
+  PinMap::portWrite (frame[digit]);
+  dimFactor = frameDim[digit];
+
+  // precompile the next tube outside of the time critical section
+  next = digit + 1;
+  if (next >= NIXIE_NUM_TUBES) next = 0;
+  compile (next);
+}
+
+
+template <class PinMap>
+void NixieClass::turnOff (void) {
+  PinMap::portOff ();
+  dimFactor = 0;
+}
+
+
+#ifdef NIXIE_ISR_MULTIPLEX
+template <class PinMap>
+void NixieClass::isrHandler (void) {
+
+  uint8_t base = OCR0A;  // Timer0 tick of the current compare match
+  uint32_t ts = micros ();
+
+  // strict 1 ms cadence, relative to the last compare match in order to avoid jitter accumulation
+  OCR0A = base + NIXIE_ISR_QUANTUM;
+
+  // beginning of a new slot: display multiplexing by switching digits
+  if (isrQuantum == 0) {
+    slotStats (ts);
+    if (enabled) {
+      switchDigit<PinMap> ();
+      // control brightness by reducing anode on time
+      // reduce on duration by dimFactor for decimal points without digits
+      isrCutTicks = dutyTicks >> dimFactor;
+    }
+    else {
+      // keep rotating digits to avoid delayed "Slot Machine" effect
+      digit++;
+      if (digit >= NIXIE_NUM_TUBES) digit = 0;
+    }
+  }
+
+  // end of the on-time falls within the current quantum
+  if (isrCutTicks < NIXIE_ISR_QUANTUM) {
+    isrCut<PinMap> (base, isrCutTicks);
+    isrCutTicks = 0xFFFF;
+  }
+  else if (isrCutTicks != 0xFFFF) {
+    isrCutTicks -= NIXIE_ISR_QUANTUM;
+  }
+
+  isrQuantum++;
+  if (isrQuantum >= NIXIE_SLOT_QUANTA) isrQuantum = 0;
+
+  effects (ts);
+
+  if (tickCallback != NULL) tickCallback ();
+}
+
+
+template <class PinMap>
+void NixieClass::isrCut (uint8_t base, uint16_t ticks) {
+  uint8_t elapsed = TCNT0 - base;
+
+  // too late for the compare match B: turn off the digit immediately
+  if (ticks < (uint16_t)elapsed + NIXIE_CUT_LEAD) {
+    turnOff<PinMap> ();
+    return;
+  }
+  OCR0B   = base + ticks;
+  TIFR0   = _BV(OCF0B);
+  TIMSK0 |= _BV(OCIE0B);
+}
+
+
+template <class PinMap>
+void NixieClass::isrCutHandler (void) {
+  // turn off the digit ahead of time, this avoids ghost numbers
+  TIMSK0 &= ~_BV(OCIE0B);
+  turnOff<PinMap> ();
+}
+
+#else
+
+template <class PinMap>
+void NixieClass::poll (void) {
+
+  uint32_t ts = micros ();
+
+  // display disabled
+  if (!enabled) {
+    wdt_reset ();
+    // keep rotating digits to avoid delayed "Slot Machine" effect
+    digit++;
+    if (digit >= NIXIE_NUM_TUBES) digit = 0;
+  }
+
+  // display multiplexing by switching digits
+  else if (ts - lastTs >= NIXIE_DIGIT_PERIOD) {
+
+    wdt_reset (); // reset the watchdog timer
+
+    slotStats (ts);
+    switchDigit<PinMap> ();
+
+    lastTs = ts;
+  }
+
+  // turn off all opto-coupler controlled pins ahead of time, this avoids ghost numbers
+  // also control brightness by reducing anode on time
+  // reduce on duration by dimFactor for decimal points without digits
+  else if (ts - lastTs >= (digitOnDuration >> dimFactor)) {
+
+    turnOff<PinMap> ();
+  }
+
+  effects (ts);
+}
+#endif // NIXIE_ISR_MULTIPLEX
+
+
+/*
+ * Instantiate the display driver for a pin map
+ * defines the Timer0 ISRs (or refresh() if NIXIE_ISR_MULTIPLEX is not defined) and blank(),
+ * must be used exactly once at file scope
+ * Parameters:
+ *   PinMap : pin map type NixiePinMap<anodePin0..5, bcdPin0..3, commaPin>
+ */
+#ifdef NIXIE_ISR_MULTIPLEX
+#define NIXIE_DRIVER(PinMap) \
+  ISR (TIMER0_COMPA_vect) { Nixie.isrHandler<PinMap> (); } \
+  ISR (TIMER0_COMPB_vect) { Nixie.isrCutHandler<PinMap> (); } \
+  void NixieClass::blank (void) { cli (); PinMap::portClear (); sei (); }
+#else
+#define NIXIE_DRIVER(PinMap) \
+  void NixieClass::refresh (void) { poll<PinMap> (); } \
+  void NixieClass::blank (void) { cli (); PinMap::portClear (); sei (); }
+#endif
+
+
+#endif // __NIXIE_PIN_MAP_H
@@ -0,0 +1,90 @@
+/*
+ * Typed accessors for constant data stored in flash memory
+ *
+ * The AVR keeps const data in SRAM unless it is declared PROGMEM, in which
+ * case it must be read using the LPM instruction. The templates below
+ * select the matching pgm_read_*() primitive according to the data type,
+ * falling back to memcpy_P() for structures.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PROGMEM_H
+#define __PROGMEM_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+
+/*
+ * Read a value of any type from flash memory
+ * Parameters:
+ *   addr : flash address of the value (e.g. &table[i] or &table[i].field)
+ * Return value:
+ *   copy of the value
+ */
+template <typename T> inline T progmemRead (const T *addr) {
+  T val;
+  memcpy_P (&val, addr, sizeof (T));
+  return val;
+}
+
+template <> inline uint8_t progmemRead (const uint8_t *addr) {
+  return pgm_read_byte (addr);
+}
+
+template <> inline int8_t progmemRead (const int8_t *addr) {
+  return (int8_t)pgm_read_byte (addr);
+}
+
+template <> inline bool progmemRead (const bool *addr) {
+  return pgm_read_byte (addr) != 0;
+}
+
+template <> inline uint16_t progmemRead (const uint16_t *addr) {
+  return pgm_read_word (addr);
+}
+
+template <> inline int16_t progmemRead (const int16_t *addr) {
+  return (int16_t)pgm_read_word (addr);
+}
+
+template <> inline uint32_t progmemRead (const uint32_t *addr) {
+  return pgm_read_dword (addr);
+}
+
+template <> inline int32_t progmemRead (const int32_t *addr) {
+  return (int32_t)pgm_read_dword (addr);
+}
+
+
+/*
+ * Read a pointer stored in flash memory
+ * (the pointer itself is in flash, the pointed object is not)
+ */
+template <typename T> inline T *progmemRead (T * const *addr) {
+  return (T *)pgm_read_ptr (addr);
+}
+
+
+#endif // __PROGMEM_H
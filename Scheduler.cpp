@@ -0,0 +1,86 @@
+/* 
+ * Cooperative task scheduler 
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Scheduler.h"
+#include <avr/sleep.h>
+
+
+SchedulerClass Scheduler;
+
+
+bool SchedulerClass::add (SchedulerTask_t task, uint16_t period, uint8_t events) {
+  if (numTasks >= SCHEDULER_MAX_TASKS) return false;
+  this->task[numTasks].func   = task;
+  this->task[numTasks].period = period;
+  this->task[numTasks].events = events;
+  this->task[numTasks].ts     = (uint16_t)millis ();
+  numTasks++;
+  return true;
+}
+
+
+void SchedulerClass::signal (uint8_t events) {
+  uint8_t sreg = SREG;  // preserve the interrupt state when called from within an ISR
+  cli ();
+  pending |= events;
+  SREG = sreg;
+}
+
+
+void SchedulerClass::run (void) {
+  uint8_t i, events;
+  uint16_t ts;
+  Task_s *t;
+
+  cli ();
+  events  = pending;
+  pending = 0;
+  sei ();
+
+  for (i = 0; i < numTasks; i++) {
+    t  = &task[i];
+    ts = (uint16_t)millis ();
+    if ( (t->events & events) ||
+         (t->period == 0 && t->events == 0) ||
+         (t->period > 0 && (uint16_t)(ts - t->ts) >= t->period) ) {
+      t->ts = ts;
+      t->func ();
+    }
+  }
+}
+
+
+void SchedulerClass::idle (void) {
+  set_sleep_mode (SLEEP_MODE_IDLE);
+  cli ();
+  if (pending == 0) {
+    sleep_enable ();
+    sei ();        // the instruction following sei is executed before any pending interrupt
+    sleep_cpu ();
+    sleep_disable ();
+  }
+  sei ();
+}
@@ -0,0 +1,109 @@
+/* 
+ * Cooperative task scheduler 
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ * 
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *   
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+#include <Arduino.h>
+
+/*
+ * Maximum number of tasks
+ */
+#define SCHEDULER_MAX_TASKS 12
+
+/*
+ * Wake-up events
+ */
+#define SCHEDULER_SECOND _BV(0)  // Timer1 second tick
+#define SCHEDULER_TENTH  _BV(1)  // Timer1 1/10 second tick (countdown timer and stopwatch)
+#define SCHEDULER_INPUT  _BV(2)  // button press or release
+
+
+/*
+ * Task function type
+ */
+typedef void (*SchedulerTask_t)(void);
+
+
+/*
+ * Scheduler class
+ */
+class SchedulerClass {
+
+  public:
+
+    /*
+     * Add a task to the scheduler
+     * a task is executed upon the expiry of its period or upon one of its wake-up events
+     * Parameters:
+     *   task   : task function
+     *   period : execution period in milliseconds
+     *            0 = execute on every scheduler pass (unless events is set)
+     *   events : bit mask of wake-up events (SCHEDULER_SECOND, SCHEDULER_TENTH...)
+     * Returns:
+     *   true on success, false if the task table is full
+     */
+    bool add (SchedulerTask_t task, uint16_t period, uint8_t events = 0);
+
+    /*
+     * Signal one or more wake-up events
+     * may be called from within an ISR
+     * Parameters:
+     *   events : bit mask of wake-up events
+     */
+    void signal (uint8_t events);
+
+    /*
+     * Execute all the due tasks once
+     * must be called from within the main loop
+     */
+    void run (void);
+
+    /*
+     * Sleep until the next interrupt unless a wake-up event is pending
+     * the display multiplexing interrupt ensures a wake-up every millisecond
+     */
+    void idle (void);
+
+  private:
+    struct Task_s {
+      SchedulerTask_t func;   // task function
+      uint16_t period;        // execution period in ms
+      uint8_t events;         // bit mask of wake-up events
+      uint16_t ts;            // millis() of the last execution
+    } task[SCHEDULER_MAX_TASKS];
+    uint8_t numTasks = 0;
+    volatile uint8_t pending = 0;  // wake-up events signalled since the last scheduler pass
+};
+
+
+/*
+ * Scheduler object as a singleton
+ */
+extern SchedulerClass Scheduler;
+
+
+#endif // __SCHEDULER_H
@@ -0,0 +1,173 @@
+/*
+ * Non-blocking serial telemetry and command interface
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Telemetry.h"
+
+#ifdef SERIAL_TELEMETRY
+
+#include <avr/pgmspace.h>
+
+#define TX_MASK (TELEMETRY_TX_SIZE - 1)
+
+static_assert ((TELEMETRY_TX_SIZE & TX_MASK) == 0 && TELEMETRY_TX_SIZE <= 128, "TELEMETRY_TX_SIZE must be a power of two up to 128");
+
+
+TelemetryClass Telemetry;
+
+
+void TelemetryClass::initialize (uint32_t baud) {
+  UCSR0B  = 0;
+  txHead  = 0;
+  txCount = 0;
+  rxLen   = 0;
+  rxReady = false;
+  rxError = false;
+  UBRR0   = (F_CPU / 4 / baud - 1) / 2;           // double speed mode, same rounding as the Arduino core
+  UCSR0A  = _BV(U2X0);
+  UCSR0C  = _BV(UCSZ01) | _BV(UCSZ00);            // 8 data bits, no parity, 1 stop bit
+  UCSR0B  = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+
+void TelemetryClass::lineBegin (char tag) {
+  // the end of the queued data does not move while the ISR transmits
+  cli ();
+  lineTail = (txHead + txCount) & TX_MASK;
+  sei ();
+  lineLen      = 0;
+  lineOverflow = false;
+  put (tag);
+}
+
+
+void TelemetryClass::put (char c) {
+  // txCount may only decrease in the meantime, the free space is never overestimated
+  if (lineOverflow || txCount + lineLen >= TELEMETRY_TX_SIZE) {
+    lineOverflow = true;
+    return;
+  }
+  txBuf[(lineTail + lineLen) & TX_MASK] = c;
+  lineLen++;
+}
+
+
+void TelemetryClass::field (const char *name, int32_t value) {
+  char buf[10];
+  uint32_t val;
+  uint8_t i = 0;
+  char c;
+
+  put (' ');
+  while ((c = pgm_read_byte (name++)) != 0) put (c);
+  put ('=');
+
+  if (value < 0) {
+    put ('-');
+    val = -(uint32_t)value;
+  }
+  else {
+    val = value;
+  }
+  do {
+    buf[i++] = '0' + val % 10;
+    val /= 10;
+  } while (val > 0);
+  while (i > 0) put (buf[--i]);
+}
+
+
+bool TelemetryClass::lineEnd (void) {
+  put ('\n');
+  if (lineOverflow) {
+    dropped++;
+    return false;
+  }
+  cli ();
+  txCount += lineLen;
+  UCSR0B  |= _BV(UDRIE0);
+  sei ();
+  return true;
+}
+
+
+void TelemetryClass::commandDone (void) {
+  rxLen   = 0;
+  rxReady = false;
+}
+
+
+void TelemetryClass::loopDuration (uint32_t duration) {
+  if (duration > loopMax) loopMax = duration;
+  loopAvg = loopAvg - (loopAvg >> 4) + duration;  // IIR low-pass filter
+}
+
+
+void TelemetryClass::txHandler (void) {
+  if (txCount > 0) {
+    UDR0   = txBuf[txHead];
+    txHead = (txHead + 1) & TX_MASK;
+    txCount--;
+  }
+  if (txCount == 0) UCSR0B &= ~_BV(UDRIE0);
+}
+
+
+void TelemetryClass::rxHandler (void) {
+  bool error = (UCSR0A & (_BV(FE0) | _BV(DOR0))) != 0;
+  char c = UDR0;
+
+  // the previous command has not yet been processed
+  if (rxReady) return;
+
+  if (c == '\n' || c == '\r') {
+    if (rxLen > 0 && !rxError) {
+      rxBuf[rxLen] = 0;
+      rxReady = true;
+    }
+    else {
+      rxLen = 0;
+    }
+    rxError = false;
+  }
+  else if (error || rxLen >= TELEMETRY_RX_SIZE - 1) {
+    rxError = true;
+  }
+  else {
+    rxBuf[rxLen++] = c;
+  }
+}
+
+
+ISR (USART_UDRE_vect) {
+  Telemetry.txHandler ();
+}
+
+
+ISR (USART_RX_vect) {
+  Telemetry.rxHandler ();
+}
+
+#endif // SERIAL_TELEMETRY
@@ -0,0 +1,145 @@
+/*
+ * Non-blocking serial telemetry and command interface
+ *
+ * Line-based ASCII protocol over the hardware USART: every line consists of
+ * a single character tag followed by space separated name=value fields.
+ * Outgoing lines are composed directly inside an interrupt-driven TX ring
+ * buffer and are either enqueued as a whole or dropped if the buffer lacks
+ * the space, such that writing never waits for the serial port.
+ * Incoming command lines are collected by the RX interrupt and handed over
+ * to the main loop one at a time.
+ *
+ * The serial pins are shared with the buzzer and the brightness boost
+ * feature, which are disabled while SERIAL_TELEMETRY is defined.
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include <Arduino.h>
+
+/*
+ * Enable the serial telemetry and command interface
+ * (cannot be combined with SERIAL_DEBUG)
+ */
+//#define SERIAL_TELEMETRY
+
+/*
+ * Serial baud rate
+ */
+#define TELEMETRY_BAUD    115200
+
+/*
+ * Size of the TX ring buffer in bytes (power of two, at most 128)
+ */
+#define TELEMETRY_TX_SIZE 128
+
+/*
+ * Maximum length of a received command line including the terminating zero
+ */
+#define TELEMETRY_RX_SIZE 24
+
+
+#ifdef SERIAL_TELEMETRY
+
+/*
+ * Telemetry class
+ */
+class TelemetryClass {
+
+  public:
+
+    /*
+     * Initialize the USART in 8N1 mode
+     * must be called again after the USART has been powered down
+     * Parameters:
+     *   baud : baud rate
+     */
+    void initialize (uint32_t baud);
+
+    /*
+     * Compose an outgoing line
+     * lineBegin() reserves the line inside the TX ring buffer, field() appends
+     * a name=value pair and lineEnd() enqueues the complete line for transmission
+     * Parameters:
+     *   tag   : line tag character
+     *   name  : field name stored in flash memory (PSTR)
+     *   value : field value
+     * Return value:
+     *   lineEnd() returns false if the line has been dropped for lack of buffer space
+     */
+    void lineBegin (char tag);
+    void field (const char *name, int32_t value);
+    bool lineEnd (void);
+
+    /*
+     * Get the last received command line
+     * no further command is accepted until commandDone() is called
+     * Return value:
+     *   zero terminated command line without the line ending, NULL if none
+     */
+    char *command (void) { return rxReady ? rxBuf : NULL; }
+    void commandDone (void);
+
+    /*
+     * Record the duration of a main loop pass in µs
+     */
+    void loopDuration (uint32_t duration);
+
+    uint32_t loopMax = 0;           // maximum loop duration in µs since the last reset
+    uint32_t loopAvg = 0;           // average loop duration in 1/16 µs
+    uint16_t dropped = 0;           // number of dropped outgoing lines
+
+    /*
+     * USART interrupt handlers
+     * must be called from within the respective ISRs
+     */
+    void txHandler (void);
+    void rxHandler (void);
+
+  private:
+    void put (char c);              // append a character to the current line
+    uint8_t txBuf[TELEMETRY_TX_SIZE];
+    volatile uint8_t txHead  = 0;   // index of the next byte to be transmitted
+    volatile uint8_t txCount = 0;   // number of bytes enqueued for transmission
+    uint8_t lineTail = 0;           // index of the first byte of the current line
+    uint8_t lineLen  = 0;           // length of the current line
+    bool lineOverflow = false;      // the current line does not fit into the buffer
+    char rxBuf[TELEMETRY_RX_SIZE];
+    volatile uint8_t rxLen = 0;     // length of the command line being received
+    volatile bool rxReady = false;  // a complete command line is available
+    volatile bool rxError = false;  // the command line being received is discarded
+};
+
+
+/*
+ * Telemetry object as a singleton
+ */
+extern TelemetryClass Telemetry;
+
+#endif // SERIAL_TELEMETRY
+
+
+#endif // __TELEMETRY_H
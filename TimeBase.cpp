@@ -0,0 +1,145 @@
+/*
+ * Timer1 time base and crystal drift compensation
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimeBase.h"
+
+
+TimeBaseClass TimeBase;
+
+
+/*
+ * Multiply by an unsigned Q16 fixed point factor up to 1.0
+ * the result is rounded and does not overflow for any 32-bit operand
+ */
+static uint32_t mulQ16 (uint32_t a, uint32_t q) {
+  return (a >> 16) * q + (((a & 0xFFFF) * q + 0x8000) >> 16);
+}
+
+
+void TimeBaseClass::initialize (uint32_t *timerPeriod, uint32_t timer1Step) {
+  this->timerPeriod = timerPeriod;
+  this->timer1Step  = timer1Step;
+  calculate ();
+}
+
+
+void TimeBaseClass::calculate (void) {
+  uint32_t f, mod, low;
+
+  if (*timerPeriod < TIMER_MIN_PERIOD) *timerPeriod = TIMER_MIN_PERIOD;
+  if (*timerPeriod > TIMER_MAX_PERIOD) *timerPeriod = TIMER_MAX_PERIOD;
+
+  timerPeriodUs    = *timerPeriod / TIMER1_DIVIDER;
+  timerPeriodFract = *timerPeriod % TIMER1_DIVIDER;
+
+  // split the tick period into a multiple of timer1Step and a remainder for the phase accumulator
+  mod = (uint32_t)TIMER1_DIVIDER * TIMER1_TICKS * timer1Step;
+  f   = *timerPeriod % mod;
+  low = (*timerPeriod - f) / ((uint32_t)TIMER1_DIVIDER * TIMER1_TICKS);
+
+  cli ();
+  tickPhaseInc   = f;
+  tickPhaseMod   = mod;
+  tickPeriodLow  = low;
+  tickPeriodHigh = low + timer1Step;
+  sei ();
+}
+
+
+void TimeBaseClass::calibrate (time_t measDuration, int32_t timeOffsetUs) {
+  uint32_t measVar, sum, var, gain, q;
+  int32_t drift;
+
+  // measured drift in timerPeriod units, computed in two steps to avoid an overflow
+  drift = (timeOffsetUs / (int32_t)measDuration) * TIMER1_DIVIDER +
+          (timeOffsetUs % (int32_t)measDuration) * TIMER1_DIVIDER / (int32_t)measDuration;
+  if (drift < -(int32_t)(TIMER_DEFAULT_PERIOD / 100)) drift = -(int32_t)(TIMER_DEFAULT_PERIOD / 100);
+  if (drift >  (int32_t)(TIMER_DEFAULT_PERIOD / 100)) drift =  (int32_t)(TIMER_DEFAULT_PERIOD / 100);
+
+  // variance of the measured drift (two edges are involved), the standard deviation q
+  // is computed in 1/4 timerPeriod units, such that 2 * q^2 yields 1/16 units squared
+  // (does not overflow for measurement durations above one minute)
+  q       = ((uint32_t)DCF_EDGE_JITTER * TIMER1_DIVIDER * 4 + (uint32_t)measDuration / 2) / (uint32_t)measDuration;
+  measVar = 2 * q * q;
+
+  // the estimate degrades with the crystal aging since the last calibration
+  driftVar += ((uint32_t)measDuration << DRIFT_VAR_SHIFT) / DRIFT_AGING_PERIOD;
+  if (driftVar > DRIFT_VAR_INIT) driftVar = DRIFT_VAR_INIT;
+
+  // Kalman gain in Q16, both operands are scaled down to 16 bits for the division
+  var = driftVar;
+  sum = driftVar + measVar;
+  while (sum > 0xFFFF) {
+    sum >>= 1;
+    var >>= 1;
+  }
+  gain = (sum > 0) ? (var << 16) / sum : 0;
+
+  if (drift < 0) drift = -(int32_t)mulQ16 (-drift, gain);
+  else           drift =  (int32_t)mulQ16 ( drift, gain);
+  driftVar = mulQ16 (driftVar, 0x10000 - gain);
+
+  correction    = drift;
+  *timerPeriod += drift;
+  calculate ();
+  syncIntervalUpdate ();
+}
+
+
+void TimeBaseClass::reset (void) {
+  driftVar = DRIFT_VAR_INIT;
+  syncIntervalUpdate ();
+}
+
+
+/*
+ * Derive the DCF77 synchronization interval
+ * from the uncertainty of the crystal drift estimate
+ * such that the predicted time deviation stays below DCF_SYNC_MAX_ERROR
+ * the predicted deviation after t seconds is t * sqrt (driftVar) / (4 * TIMER1_DIVIDER) µs,
+ * the squared condition is evaluated for the interval in minutes m:
+ *   m^2 <= DCF_SYNC_MAX_ERROR^2 * 16 * TIMER1_DIVIDER^2 / (3600 * driftVar)
+ * both sides are divided by 64 in order to fit into 32 bits
+ */
+void TimeBaseClass::syncIntervalUpdate (void) {
+  constexpr uint64_t k = (uint64_t)DCF_SYNC_MAX_ERROR * DCF_SYNC_MAX_ERROR * (1 << DRIFT_VAR_SHIFT) *
+                         TIMER1_DIVIDER * TIMER1_DIVIDER / 3600 / 64;
+  static_assert (k <= UINT32_MAX && (uint64_t)DCF_SYNC_MAX_INTERVAL * DCF_SYNC_MAX_INTERVAL <= UINT32_MAX, "syncIntervalUpdate overflow");
+  uint32_t limit, lo, hi, mid;
+
+  lo = DCF_SYNC_MIN_INTERVAL;
+  hi = DCF_SYNC_MAX_INTERVAL;
+  if (driftVar > 0) {
+    limit = (uint32_t)k / driftVar;
+    // largest interval satisfying the condition by bisection
+    while (lo < hi) {
+      mid = (lo + hi + 1) / 2;
+      if ((mid * mid) / 64 <= limit) lo = mid;
+      else                           hi = mid - 1;
+    }
+  }
+  syncInterval = hi;
+}
@@ -0,0 +1,118 @@
+/*
+ * Timer1 time base and crystal drift compensation
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TIME_BASE_H
+#define __TIME_BASE_H
+
+#include <Arduino.h>
+#include <time.h>
+
+/*
+ * Timer1 time base
+ */
+#define TIMER1_DIVIDER         64            // resolution of timerPeriod in fractions of a µs
+#define TIMER1_TICKS           100           // Timer1 ticks per second (10 ms time base, equals the stopwatch resolution)
+#define TIMER_DEFAULT_PERIOD   (1000000 * TIMER1_DIVIDER)  // default value of timerPeriod (total is 1 second)
+#define TIMER_MIN_PERIOD       (TIMER_DEFAULT_PERIOD - TIMER_DEFAULT_PERIOD / 100)  // minimum allowed value of timerPeriod
+#define TIMER_MAX_PERIOD       (TIMER_DEFAULT_PERIOD + TIMER_DEFAULT_PERIOD / 100)  // maximum allowed value of timerPeriod
+
+/*
+ * Crystal drift estimation
+ */
+#define DCF_EDGE_JITTER        10000         // standard deviation of the DCF77 second edge timing in µs
+#define DRIFT_VAR_SHIFT        4             // number of fractional bits of the drift variance (TimeBase.driftVar)
+#define DRIFT_VAR_INIT         ((uint32_t)40000000 << DRIFT_VAR_SHIFT)  // initial variance of the crystal drift estimate (timerPeriod units squared, ~100 ppm)
+#define DRIFT_AGING_PERIOD     2000          // crystal aging as a random walk of the drift estimate (one timerPeriod unit squared every 2000 s)
+#define DCF_SYNC_MAX_ERROR     100000        // maximum predicted time deviation in µs before a DCF77 synchronization is due
+#define DCF_SYNC_MIN_INTERVAL  (24*60)       // minimum DCF77 synchronization interval in minutes
+#define DCF_SYNC_MAX_INTERVAL  (7*24*60)     // maximum DCF77 synchronization interval in minutes
+
+
+/*
+ * Time base class
+ * derives the Timer1 tick periods out of the virtual 1 second period
+ * and calibrates the latter against the DCF77 time
+ */
+class TimeBaseClass {
+
+  public:
+
+    /*
+     * Initialize the time base parameters
+     * Parameters:
+     *   timerPeriod : virtual period of the Timer1 time base in 1/TIMER1_DIVIDER µs (equivalent to 1 second),
+     *                 adjusted by calibrate()
+     *   timer1Step  : minimum adjustment step for Timer1 in µs
+     */
+    void initialize (uint32_t *timerPeriod, uint32_t timer1Step);
+
+    /*
+     * Derive the Timer1 tick periods
+     * must be called whenever the timer period has been changed
+     */
+    void calculate (void);
+
+    /*
+     * Calibrate the timer period in order to compensate for the crystal drift
+     * the measured drift is weighted against the confidence of the current
+     * estimate using a scalar Kalman filter, such that short or noisy
+     * measurements have less influence than long ones
+     * Parameters:
+     *   measDuration : time elapsed since the last synchronization in seconds
+     *   timeOffsetUs : deviation of the system time from the DCF77 time in µs
+     */
+    void calibrate (time_t measDuration, int32_t timeOffsetUs);
+
+    /*
+     * Discard the confidence of the drift estimate
+     * must be called upon a manual adjustment of the timer period
+     */
+    void reset (void);
+
+    uint32_t timerPeriodUs    = 0;   // integer part of timerPeriod in µs (equivalent to 1 second)
+    uint32_t timerPeriodFract = 0;   // fractional part of timerPeriod in 1/TIMER1_DIVIDER µs
+    uint32_t tickPeriodLow    = 0;   // Timer1 tick period rounded down to the multiple of timer1Step (µs)
+    uint32_t tickPeriodHigh   = 0;   // Timer1 tick period rounded up to the multiple of timer1Step (µs)
+    uint32_t tickPhaseInc     = 0;   // phase accumulator increment per tick (remainder of the rounded-down period)
+    uint32_t tickPhaseMod     = 1;   // phase accumulator modulus (one timer1Step per tick)
+    uint32_t syncInterval     = 0;   // DCF77 synchronization interval in minutes, adapted to the crystal drift stability (0 until calibrated)
+    int32_t  correction       = 0;   // timer period correction applied by the last calibrate() in 1/TIMER1_DIVIDER µs
+    uint32_t driftVar = DRIFT_VAR_INIT;  // variance of the crystal drift estimate in 1/16 timerPeriod units squared
+
+  private:
+    void syncIntervalUpdate (void);
+    uint32_t *timerPeriod = NULL;
+    uint32_t timer1Step = 1;
+};
+
+
+/*
+ * Time base object as a singleton
+ */
+extern TimeBaseClass TimeBase;
+
+
+#endif // __TIME_BASE_H
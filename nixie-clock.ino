@@ -4,19 +4,21 @@
  * Features:
  * - 6 IN-8-2 Nixie featuring 0-9 digits and decimal points
  * - Multiplexed display, requires one single K155ID1 Nixie driver chip
+ * - Interrupt driven display multiplexing for a flicker-free operation
+ * - Cooperative task scheduler with wake-up events
  * - Synchronization with the DCF77 time signal
  * - Automatic crystal drift compensation using DCF77 time
  * - Power saving mode for running on a backup super-capacitor
- * - Dual timers: Timer1 used for timekeeping and Timer2 for countdown timer / stopwatch
+ * - Unified 10 ms time base on Timer1 for timekeeping, countdown timer and stopwatch
  * - Automatic and manual display brightness adjustment
  * - Menu navigation using 3 push-buttons
- * - Alarm clock with the weekday and weekend options
+ * - 4 alarms with individual day-of-week masks
  * - Countdown timer
  * - Stopwatch
  * - Service menu
  * - Cathode poisoning prevention and the "Slot Machine" effect
  * - Screen blanking with dual time intervals
- * - Settings are stored to EEPROM
+ * - Settings are stored to EEPROM using a wear-leveling journal
  * - and more...
  *
  * This source file is part of the Nixie Clock Arduino firmware
@@ -55,20 +57,31 @@
 #include <avr/power.h>
 #include <avr/wdt.h>
 #include "src/TimerOne/TimerOne.h"
-#include "src/TimerTwo/TimerTwo.h"
 #include "src/Button/Button.h"
 #include "src/Dcf/Dcf.h"
-#include "src/Adc/Adc.h"
-#include "src/Nvm/Nvm.h"
 #include "src/MathMf/MathMf.h"
 #include "Nixie.h"
+#include "NixiePinMap.h"
 #include "Brightness.h"
 #include "Features.h"
+#include "Scheduler.h"
+#include "Journal.h"
+#include "EepromQueue.h"
+#include "DcfCapture.h"
+#include "DcfStream.h"
+#include "Analog.h"
+#include "Progmem.h"
+#include "Telemetry.h"
+#include "Calendar.h"
+#include "TimeBase.h"
 //#include "BuildDate.h"
 
 
 //#define SERIAL_DEBUG  // activate debug printing over RS232
 //#define DEBUG_VALUES  // activate the debug values within the service menu
+//#define PROFILE_VALUES  // activate the loop latency and display jitter profiling values within the service menu
+#define WDT_CALIBRATE     // calibrate the watchdog timer against Timer1 for accurate time-keeping during deep sleep
+#define BUTTON_CLICK      // play a key click upon every button press
 
 
 #ifdef SERIAL_DEBUG
@@ -84,6 +97,10 @@
   #define PRINTLN(...)
 #endif
 
+#if defined (SERIAL_DEBUG) && defined (SERIAL_TELEMETRY)
+  #error "SERIAL_DEBUG and SERIAL_TELEMETRY (see Telemetry.h) cannot be enabled at the same time"
+#endif
+
 
 // reset the Nixie tube uptime to NIXIE_UPTIME_RESET_VALUE
 //#define NIXIE_UPTIME_RESET
@@ -96,6 +113,9 @@
 // upon the absence of this string in EEPROM all the settings will be reset to default
 #define SETTINGS_RESET_CODE 0xDEADBEEF
 
+// version of the settings structure layout, settings stored using an older layout are migrated upon booting
+#define SETTINGS_LAYOUT 2
+
 // anode control pins
 #define ANODE0_PIN 12
 #define ANODE1_PIN 11
@@ -113,6 +133,13 @@
 // pin controlling the comma
 #define COMMA_PIN 13
 
+// compile-time pin map of the Nixie tube display
+typedef NixiePinMap<ANODE0_PIN, ANODE1_PIN, ANODE2_PIN, ANODE3_PIN, ANODE4_PIN, ANODE5_PIN,
+        BCD0_PIN, BCD1_PIN, BCD2_PIN, BCD3_PIN, COMMA_PIN> NixiePins;
+
+// instantiate the display multiplexing for the above pin map
+NIXIE_DRIVER (NixiePins)
+
 // DCF77 settings
 #define DCF_PIN        3        // DCF77 digital pin
 #define DCF_START_EDGE FALLING  // trigger the start of a DCF bit on FALLING/RISING edge of DCF_PIN
@@ -124,41 +151,79 @@
 #define BRIGHTNESS_PIN 0
 
 // analog pins
-#define NUM_APINS      5   // total number of hardware analog pins in use for non-blocking ADC
+#define NUM_APINS      5   // total number of hardware analog pins sampled by the ADC scheduler
 #define BUTTON0_APIN   A2  // button 0 - "mode"
 #define BUTTON1_APIN   A3  // button 1 - "increase"
 #define BUTTON2_APIN   A1  // button 2 - "decrease"
 #define LIGHTSENS_APIN A0  // light sensor
 #define EXTPWR_APIN    A6  // measures external power voltage
 #define VOLTAGE_APIN   A7  // measures the retention super capacitor voltage
+#define LIGHTSENS_CHAN 3   // ADC scheduler channel of the light sensor
+#define EXTPWR_CHAN    4   // ADC scheduler channel of the external power voltage
+
+// ADC scheduler sample periods in ms and priorities (0 = highest)
+#define EXTPWR_SAMPLE_PERIOD     2
+#define EXTPWR_SAMPLE_PRIORITY   0
+#define BUTTON_SAMPLE_PERIOD     8
+#define BUTTON_SAMPLE_PRIORITY   1
+#define LIGHTSENS_SAMPLE_PERIOD  150
+#define LIGHTSENS_SAMPLE_PRIORITY 2
+#define EXTPWR_THRESHOLD         512  // external power is considered lost below this ADC value
 
 // various constants
-#define TIMER1_DIVIDER         64            // (Timer1 period) = TIMER_DEFAULT_PERIOD / TIMER1_DIVIDER
-#define TIMER2_DIVIDER         40            // (Timer2 period) = (Timer1 period) / TIMER2_DIVIDER
-#define TIMER_DEFAULT_PERIOD   (1000000 * TIMER1_DIVIDER)  // default value of timerPeriod (total is 1 second)
-#define TIMER_MIN_PERIOD       (TIMER_DEFAULT_PERIOD - TIMER_DEFAULT_PERIOD / 100)  // minimum allowed value of timerPeriod
-#define TIMER_MAX_PERIOD       (TIMER_DEFAULT_PERIOD + TIMER_DEFAULT_PERIOD / 100)  // maximum allowed value of timerPeriod
 #define WDT_TIMEOUT            WDTO_4S       // watcchdog timer timeout setting
 #define EEPROM_SETTINGS_ADDR   0             // EEPROM address of the settngs structure
 #define EEPROM_BRIGHTNESS_ADDR (EEPROM_SETTINGS_ADDR + sizeof (Settings))  // EEPROM address of the display brightness lookup table
+#define EEPROM_JOURNAL_ADDR    512           // EEPROM address of the settings journal
+#define EEPROM_JOURNAL_SIZE    512           // size of the settings journal in bytes
+#define EEPROM_CHECKPOINT_ADDR (EEPROM_JOURNAL_ADDR - sizeof (Checkpoint_t))  // EEPROM address of the power-fail checkpoint
 #define MENU_ORDER_LIST_SIZE   3             // size of the dynamic menu ordering list
 #define SETTINGS_LUT_SIZE      17            // size of the settings lookup table
+#define CALENDAR_CARRY_SEC     0             // calendarIncrement() carry levels
+#define CALENDAR_CARRY_MIN     1
+#define CALENDAR_CARRY_HOUR    2
+#define CALENDAR_CARRY_DAY     3
+#define CALENDAR_CARRY_YEAR    4
+#define WDT_NOMINAL_PERIOD     1000000       // nominal watchdog period during deep sleep in µs (128K oscillator cycles)
+#define WDT_CALIB_CYCLES       32            // number of 16 ms watchdog periods (2K oscillator cycles) measured by wdtCalibrate()
+#define WDT_CORRECTION_MAX     30000         // maximum absolute value of Settings.wdtCorrection in µs
+#define WDT_REFINE_MIN_CYCLES  600           // minimum number of deep sleep watchdog periods for refining Settings.wdtCorrection
+#define DCF_SYNC_TIMEOUT       (20*60)       // abort a DCF77 reception attempt after this many seconds, retry at the next hour
+#define DCF_RATE_INIT          128           // initial value of the per-hour DCF77 reception success rate (0..255)
 #ifdef DEBUG_VALUES
   #define NUM_DEBUG_VALUES     3             // total number of debug values shown in the service menu
   #define NUM_DEBUG_DIGITS     7             // number of digits for the debug values shown in the service menu
 #else
   #define NUM_DEBUG_VALUES     0
 #endif
-#define NUM_SERVICE_VALUES     (5 + NUM_DEBUG_VALUES)  // total number of values inside the service menu
+#ifdef PROFILE_VALUES
+  #define NUM_PROFILE_VALUES   8             // total number of profiling values shown in the service menu
+  #define NUM_PROFILE_DIGITS   7             // number of digits for the profiling values shown in the service menu
+  #define PROFILE_LOOP_MAX     0             // maximum loop duration in µs
+  #define PROFILE_LOOP_AVG     1             // average loop duration in µs
+  #define PROFILE_SLOT_GAP     2             // maximum time between two display multiplexing slots in µs
+  #define PROFILE_SLOT_MISSED  3             // number of missed display multiplexing slots
+  #define PROFILE_SYNC_TO_DCF  4             // worst case duration of syncToDcf() in µs
+  #define PROFILE_SETTINGS     5             // worst case duration of settingsMenu() in µs
+  #define PROFILE_ADC_READ     6             // worst case duration of adcRead() in µs
+  #define PROFILE_EEPROM_WRITE 7             // worst case duration of eepromWriteSettings() in µs
+  // measure the duration of a function call
+  #define PROFILE(IDX, CALL) { uint32_t profileTs = micros (); CALL; Profile.update (IDX, micros () - profileTs); }
+#else
+  #define NUM_PROFILE_VALUES   0
+  #define PROFILE(IDX, CALL) CALL
+#endif
+#define NUM_SYSTEM_VALUES      7             // number of system values inside the service menu
+#define NUM_SERVICE_VALUES     (NUM_SYSTEM_VALUES + NUM_PROFILE_VALUES + NUM_DEBUG_VALUES)  // total number of values inside the service menu
 
 /*
  * Enumerations for the states of the menu navigation state machine
- * the program relies on the exact order of the below definitions
+ * indices of the menu state descriptor table (see MenuTable)
  */
-enum MenuState_e { SHOW_TIME_E, SHOW_DATE_E,    SHOW_WEEK_E, SHOW_ALARM_E, SHOW_TIMER_E, SHOW_STOPWATCH_E, SHOW_SERVICE_E, SHOW_BLANK_E,
-                   SET_ALARM_E, SET_SETTINGS_E, SET_HOUR_E,  SET_MIN_E,    SET_SEC_E,    SET_DAY_E,        SET_MONTH_E,    SET_YEAR_E,   SET_WEEK_E,
-                   SHOW_TIME,   SHOW_DATE,      SHOW_WEEK,   SHOW_ALARM,   SHOW_TIMER,   SHOW_STOPWATCH,   SHOW_SERVICE,   SHOW_BLANK,
-                   SET_ALARM,   SET_SETTINGS,   SET_HOUR,    SET_MIN,      SET_SEC,      SET_DAY,          SET_MONTH,      SET_YEAR,     SET_WEEK  };
+enum MenuState_e { SHOW_TIME, SHOW_DATE,    SHOW_WEEK, SHOW_ALARM, SHOW_TIMER, SHOW_STOPWATCH, SHOW_SERVICE, SHOW_BLANK,
+                   SET_ALARM, SET_SETTINGS, SET_HOUR,  SET_MIN,    SET_SEC,    SET_DAY,        SET_MONTH,    SET_YEAR,   SET_WEEK,
+                   NUM_MENU_STATES };
+#define MENU_NONE 0xFF  // no menu state
 
 
 #ifdef DEBUG_VALUES
@@ -182,11 +247,42 @@ class DebugClass {
 } Debug;
 #endif
 
+
+#ifdef PROFILE_VALUES
+// Class for storing profiling values
+class ProfileClass {
+  public:
+    uint32_t values[NUM_PROFILE_VALUES] = { 0 };
+    uint32_t loopAvg = 0;  // average loop duration in 1/16 µs
+    void reset (void) {
+      for (uint8_t i = 0; i < NUM_PROFILE_VALUES; i++) values[i] = 0;
+      loopAvg = 0;
+      Nixie.resetStats ();
+    }
+    // keep the worst case value
+    void update (uint8_t index, uint32_t value) {
+      if (index < NUM_PROFILE_VALUES && value > values[index]) values[index] = value;
+    }
+    void loopDuration (uint32_t duration) {
+      update (PROFILE_LOOP_MAX, duration);
+      loopAvg = loopAvg - (loopAvg >> 4) + duration;  // IIR low-pass filter
+      values[PROFILE_LOOP_AVG] = loopAvg >> 4;
+    }
+    // copy the display multiplexing statistics
+    void display (void) {
+      cli ();
+      values[PROFILE_SLOT_GAP]    = Nixie.maxSlotGap;
+      values[PROFILE_SLOT_MISSED] = Nixie.missedSlots;
+      sei ();
+    }
+} Profile;
+#endif
+
 /*
  * Structure that holds the settings to be stored in EEPROM
  */
 struct Settings_t {
-  uint32_t timerPeriod;           // virtual period of Timer1/Timer2 (equivalent to 1 second)
+  uint32_t timerPeriod;           // virtual period of the Timer1 time base (equivalent to 1 second)
   volatile uint32_t nixieUptime;  // stores the nixie tube uptime in seconds
   uint8_t  reserved[2];           // reserved for future use
   int8_t   timeZone;              // time difference between UTC and local time
@@ -200,7 +296,7 @@ struct Settings_t {
   uint8_t  cathodePoisonPrevent;  // enables cathode poisoning prevention measure by cycling through all digits (1 = on preset time, 2 = "Slot Machine" every minute, 3 = "Slot Machine" every 10 min)
   uint8_t  cppStartHr;            // start hour for the cathode poisoning prevention measure
   int8_t   clockDriftCorrect;     // manual clock drift correction
-  uint8_t  reserved0;             // reserved for future use
+  uint8_t  settingsLayout;        // version of the settings structure layout (see SETTINGS_LAYOUT)
   bool     brightnessAutoAdjust;  // enables the brightness auto-adjustment feature
   bool     brightnessBoost;       // enables the brightness boosting feature
   uint8_t  blankScreenMode2;      // turn-off display during a time interval in order to reduce tube wear (second profile) (1 = every day, 2 = on weekdays, 3 = on weekends)
@@ -208,16 +304,30 @@ struct Settings_t {
   uint8_t  blankScreenFinishHr2;  // finish hour for disabling the display (second profile)
   uint8_t  reserved1[1];          // reserved for future use
   uint32_t settingsResetCode;     // all settings will be reset to default if this value is different than the value of SETTINGS_RESET_CODE
-  AlarmEeprom_s alarm;            // alarm clock settings
+  uint8_t  legacyAlarm[6];        // single alarm clock settings of the initial layout (see settingsMigrate())
   int8_t   weekStartDay;          // the first day of a calendar week (1 = Monday, 7 = Sunday)
   int8_t   calWeekAdjust;         // calendar week compensation value
-  uint8_t  reserved2[2];          // reserved for future use
+  int16_t  wdtCorrection;         // deep sleep watchdog period correction in µs, learned from the DCF77 time deviation after a power failure
+  AlarmEeprom_s alarm[ALARM_NUM]; // alarm clock settings
 } Settings;
 
+static_assert (sizeof (Settings) <= JOURNAL_MAX_DATA_SIZE, "the settings structure exceeds the journal capacity");
+
+
+/*
+ * Power-fail checkpoint structure
+ * stored in a dedicated pre-erased EEPROM slot (see checkpointWrite())
+ */
+struct Checkpoint_t {
+  uint32_t nixieUptime;   // copy of Settings.nixieUptime
+  uint32_t timerPeriod;   // copy of Settings.timerPeriod
+  uint8_t  check;         // checksum
+};
+
 
 /*
  * Lookup table that maps the individual system settings
- * to their ranges and IDs
+ * to their ranges and IDs (stored in flash memory)
  */
 const struct SettingsLut_t {
   int8_t *value;     // pointer to the value variable
@@ -226,7 +336,7 @@ const struct SettingsLut_t {
   int8_t minVal;     // minimum value
   int8_t maxVal;     // maximum value
   int8_t defaultVal; // default value
-} SettingsLut[SETTINGS_LUT_SIZE] =
+} SettingsLut[SETTINGS_LUT_SIZE] PROGMEM =
 {
   { (int8_t *)&Settings.timeZone,               1, 1,   -11,   14,     1 }, // time difference between UTC and local time
   { (int8_t *)&Settings.dstEnabled,             1, 2,     0,    2,     2 }, // daylight saving time (0 = disabled, 1 = enabled, 2 = automatic)
@@ -247,48 +357,62 @@ const struct SettingsLut_t {
   { (int8_t *)&Settings.brightnessBoost,        6, 2, false, true, false }  //  - brighntess boost
 };
 
+/*
+ * Read a field of the settings lookup table from flash memory
+ */
+#define SETTINGS_FIELD(IDX, NAME) progmemRead (&SettingsLut[IDX].NAME)
+
 /*
  * Global variables
  */
 struct G_t {
-  uint32_t timer1Step;                         // minimum adjustment step for Timer1 in µs
-  uint32_t timer1Period;                       // Timer1 period = timerPeriod / TIMER1_DIVIDER
-  uint32_t timer1PeriodFH;                     // Timer1 high fractional part
-  uint32_t timer1PeriodFL;                     // Timer1 low fractional part
-  uint32_t timer1PeriodLow;                    // Timer1 period rounded down to the multiple of timer1Step (µs)
-  uint32_t timer1PeriodHigh;                   // Timer1 period rounded up to the multiple of timer1Step (µs)
-  uint32_t timer2Step;                         // minimum adjustment step for Timer2 in µs
-  uint32_t timer2PeriodFH;                     // Timer2 high fractional part
-  uint32_t timer2PeriodFL;                     // Timer2 low fractional part
-  uint32_t timer2PeriodLow;                    // Timer2 period rounded down to the multiple of timer2Step (µs)
-  uint32_t timer2PeriodHigh;                   // Timer2 period rounded up to the multiple of timer2Step (µs)
-  volatile bool timer1UpdateFlag = true;       // set to true if Timer1 parameters have been updated
-  volatile bool timer2UpdateFlag = true;       // set to true if Timer2 parameters have been updated
-  uint32_t dcfSyncInterval       = 0;          // DCF77 synchronization interval in minutes
+  uint8_t  dcfHourRate[24];                    // moving average of the DCF77 reception success rate per hour of day (0..255)
+  uint8_t  dcfBestHour           = 0;          // hour of day with the best DCF77 reception, used for scheduling
+  time_t   dcfAttemptStart       = 0;          // system time at the beginning of the current reception attempt, 0 if idle
+  uint8_t  dcfAttemptHour        = 0;          // hour of day at the beginning of the current reception attempt
+  uint16_t dcfErrors             = 0;          // frame errors during the current reception attempt
+  uint16_t dcfLastErrors         = 0;          // frame errors during the last reception attempt
+  uint16_t dcfLastDuration       = 0;          // time to the first valid frame of the last reception attempt in seconds
+  bool     dcfRetry              = false;      // the last reception attempt has timed out, retry at the next hour
   time_t   lastDcfSyncTime       = 0;          // stores the time of last successful DCF77 synchronizaiton
   tm       lastDcfSyncTm         = { 0 };      // local time of the last successful DCF77 synchronization as a tm structure
   bool     manuallyAdjusted      = true;       // prevent crystal drift compensation if clock was manually adjusted
   bool     dcfSyncActive         = false;      // enable/disable DCF77 synchronization
   bool     cppEffectEnabled      = false;      // Nixie digit cathod poison prevention effect is triggered every x seconds (avoids cathode poisoning)
   uint32_t secTickMsStamp        = 0;          // millis() at the last second tick, used for accurate crystal drift compensation
-  volatile bool    timer1TickFlag     = false; // flag is set every second by the Timer1 ISR
-  volatile uint8_t timer2SecCounter   = 0;     // increments every time Timer2 ISR is called, used for converting 25ms into 1s ticks
-  volatile uint8_t timer2TenthCounter = 0;     // increments every time Timer2 ISR is called, used for converting 25ms into 1/10s ticks
+  volatile uint8_t tickCount          = 0;     // Timer1 ticks since the beginning of the current second
+  volatile bool    chronoRunning      = false; // stopwatch running
+  volatile uint8_t chronoTickCount    = 0;     // Timer1 ticks since the last 1/10 s stopwatch tick
   time_t   systemTime                 = 0;     // current system time (UTC)
-  tm       *localTm                   = NULL;  // pointer to the current local time structure
+  tm       localTmBuf                 = { 0 };  // current local time, advanced incrementally every second
+  tm       *localTm                   = &localTmBuf; // pointer to the current local time structure
   bool     dstActive                  = false; // daylight saving time is currently active
+  bool     blankScreen                = false; // screen blanking condition, evaluated once every second
+  uint32_t blankSchedule[7]           = { 0 };  // screen blanking hours as a bit mask for every week day (0 = Sunday)
+  uint32_t cppSchedule                = 0;     // cathode poisoning prevention hours as a bit mask
+  uint32_t dcfSchedule                = 0;     // DCF77 synchronization start hours as a bit mask
+  bool     scheduleUpdated            = false; // the above schedule has been rebuilt
   NixieDigit_s timeDigits[NIXIE_NUM_TUBES];    // stores the Nixie display digit values of the current time
   NixieDigit_s dateDigits[NIXIE_NUM_TUBES];    // stores the Nixie display digit values of the current date
-  MenuState_e  menuState     = SHOW_TIME_E;    // state of the menu navigation state machine
+  MenuState_e  menuState     = SHOW_TIME;      // state of the menu navigation state machine
+  uint8_t      menuRequest   = SHOW_TIME;      // state to be entered upon the next settingsMenu() execution, MENU_NONE if none
 #ifdef SERIAL_DEBUG
   volatile uint8_t printTickCount     = 0;     // incremented by the Timer1 ISR every second
 #endif
+#ifdef SERIAL_TELEMETRY
+  int16_t  lightSensor                = 1023;  // filtered light sensor value, published by telemetryTask()
+  uint8_t  brightnessLevel            = 0;     // last automatic brightness level, published by telemetryTask()
+#endif
+  uint32_t wdtPeriod                  = WDT_NOMINAL_PERIOD; // watchdog period during deep sleep in µs
+  volatile uint32_t wdtAccu           = 0;     // µs accumulated by the watchdog ISR, converted into second ticks
+  volatile uint8_t  wdtCalibCount     = 0;     // remaining watchdog periods to be measured by wdtCalibrate()
+  volatile uint32_t wdtCycles         = 0;     // deep sleep watchdog periods elapsed since the last DCF77 synchronization
 
   // analog pins as an array
   const uint8_t analogPin[NUM_APINS] = { BUTTON0_APIN, BUTTON1_APIN, BUTTON2_APIN, LIGHTSENS_APIN, EXTPWR_APIN };
 
   // dynamically defines the order of the menu items
-  MenuState_e menuOrder[MENU_ORDER_LIST_SIZE] = { SHOW_STOPWATCH_E, SHOW_TIMER_E, SHOW_SERVICE_E };
+  MenuState_e menuOrder[MENU_ORDER_LIST_SIZE] = { SHOW_STOPWATCH, SHOW_TIMER, SHOW_SERVICE };
 } G;
 
 /*
@@ -305,22 +429,50 @@ StopwatchClass Stopwatch;      // stopwatch object
  * Function prototypes
  ***********************************/
 void eepromWriteSettings (void);
+void settingsMigrate (void);
+uint8_t checkpointCheck (Checkpoint_t *cp);
+void checkpointWrite (void);
+void checkpointRestore (void);
 void timer1ISR (void);
-void timer2ISR (void);
 void timerCallback (bool);
 time_t convertToLocalTime (time_t time);
 time_t convertToUtcTime (time_t time);
 void syncToDcf (void);
-void timerCalibrate (time_t, int32_t);
-void timerCalculate (void);
-void updateDigits (void);
+void syncAttemptEnd (bool success);
+uint8_t syncBestHour (void);
+uint32_t wdtCalibrate (void);
+void wdtRefine (int32_t deltaMs);
+uint8_t calendarIncrement (tm *t);
+void updateDigits (bool incremental = false);
 void adcRead (void);
 void powerSave (void);
 void reorderMenu (int8_t);
 uint8_t weekDay (void);
 int8_t calendarWeek (void);
 uint8_t calendarWeekValidate (void);
+void setTimeDate (void);
+void menuSwitch (MenuState_e state);
+void menuTransition (void);
 void settingsMenu (void);
+void settingsApply (uint8_t idx, int16_t delta);
+void secondTask (void);
+void scheduleAddBlankProfile (uint8_t, uint8_t, uint8_t);
+void scheduleBuild (void);
+void displayTask (void);
+void cdTimerTask (void);
+void stopwatchTask (void);
+void alarmTask (void);
+#ifndef NIXIE_ISR_MULTIPLEX
+void buzzerTask (void);
+#endif
+void adcTask (void);
+void settingsMenuTask (void);
+void syncToDcfTask (void);
+void journalTask (void);
+#ifdef SERIAL_TELEMETRY
+void telemetryTask (void);
+void telemetryCommand (char *cmd);
+#endif
 
 
 
@@ -329,6 +481,7 @@ void settingsMenu (void);
  ***********************************/
 void setup() {
   uint8_t i;
+  uint32_t step;
   MCUSR = 0;      // clear MCU status register
   wdt_disable (); // and disable watchdog
 
@@ -337,6 +490,11 @@ void setup() {
   Serial.begin (SERIAL_BAUD);
 #endif
 
+#ifdef SERIAL_TELEMETRY
+  // initialize the telemetry interface
+  Telemetry.initialize (TELEMETRY_BAUD);
+#endif
+
 #ifdef DEBUG_VALUES
   // initialize the debug values
   Debug.initialize ();
@@ -346,22 +504,26 @@ void setup() {
   PRINTLN ("+ + +  N I X I E  C L O C K  + + +");
   PRINTLN (" ");
 
-  // initialize the ADC
-  Adc.initialize (ADC_PRESCALER_128, ADC_DEFAULT);
+  // initialize the ADC scheduler, the channel indices match the Button[] indices
+  for (i = 0; i < 3; i++) Analog.add (G.analogPin[i], BUTTON_SAMPLE_PERIOD, BUTTON_SAMPLE_PRIORITY);
+  Analog.add (LIGHTSENS_APIN, LIGHTSENS_SAMPLE_PERIOD, LIGHTSENS_SAMPLE_PRIORITY);
+  Analog.add (EXTPWR_APIN, EXTPWR_SAMPLE_PERIOD, EXTPWR_SAMPLE_PRIORITY);
+  Analog.setThreshold (EXTPWR_CHAN, EXTPWR_THRESHOLD);
+  Analog.start ();
 
   // initialize the Nixie tube display
-  Nixie.initialize ( ANODE0_PIN, ANODE1_PIN, ANODE2_PIN, ANODE3_PIN, ANODE4_PIN, ANODE5_PIN,
-          BCD0_PIN, BCD1_PIN, BCD2_PIN, BCD3_PIN, COMMA_PIN, G.timeDigits, NIXIE_NUM_TUBES);
+  Nixie.initialize<NixiePins> (G.timeDigits, NIXIE_NUM_TUBES);
 
   // initialize the brightness control algorithm
   Brightness.initialize (EEPROM_BRIGHTNESS_ADDR, BRIGHTNESS_PIN);
 
   // initilaize the DCF77 receiver
   Dcf.initialize (DCF_PIN, DCF_START_EDGE, INPUT);
+  DcfCapture.initialize (DCF_PIN, DCF_START_EDGE);
 
   // reset system time
   G.systemTime = 0;
-  G.localTm    = localtime (&G.systemTime);
+  localtime_r (&G.systemTime, G.localTm);
   G.localTm->tm_sec   = 0;    // seconds after the minute - [ 0 to 59 ]
   G.localTm->tm_min   = 0;    // minutes after the hour - [ 0 to 59 ]
   G.localTm->tm_hour  = 0;    // hours since midnight - [ 0 to 23 ]
@@ -372,13 +534,20 @@ void setup() {
   G.systemTime = mktime (G.localTm);
   set_system_time (G.systemTime);
 
-  // retrieve system settings period from EEOROM
-  eepromRead (EEPROM_SETTINGS_ADDR, (uint8_t *)&Settings, sizeof (Settings));
+  // retrieve system settings from EEOROM and replay the settings journal
+  Journal.initialize (EEPROM_SETTINGS_ADDR, EEPROM_JOURNAL_ADDR, EEPROM_JOURNAL_SIZE, (uint8_t *)&Settings, sizeof (Settings));
+
+  // apply the settings saved by the latest power failure
+  checkpointRestore ();
 
   // validate the Timer1 period loaded from EEPROM
   if (Settings.timerPeriod < TIMER_MIN_PERIOD || Settings.timerPeriod > TIMER_MAX_PERIOD)
           Settings.timerPeriod = TIMER_DEFAULT_PERIOD;
 
+  // validate the watchdog period correction loaded from EEPROM
+  if (Settings.wdtCorrection < -WDT_CORRECTION_MAX || Settings.wdtCorrection > WDT_CORRECTION_MAX)
+          Settings.wdtCorrection = 0;
+
 #ifdef NIXIE_UPTIME_RESET
   // force a nixie tube uptime reset
   Settings.nixieUptime = NIXIE_UPTIME_RESET_VALUE;
@@ -386,18 +555,27 @@ void setup() {
   PRINTLN ("[setup] Nixie uptime reset");
 #endif
 
+  // migrate the settings stored using an older layout
+  if (Settings.settingsResetCode == SETTINGS_RESET_CODE && Settings.settingsLayout != SETTINGS_LAYOUT) {
+    settingsMigrate ();
+  }
+
   // reset all settings on first-time boot
   if (Settings.settingsResetCode != SETTINGS_RESET_CODE) {
     Brightness.initializeLut ();
-    Settings.alarm.hour     = 06;
-    Settings.alarm.minute   = 45;
-    Settings.alarm.mode     = ALARM_OFF;
-    Settings.alarm.lastMode = ALARM_WEEKDAYS;
+    for (i = 0; i < ALARM_NUM; i++) {
+      Settings.alarm[i].hour    = 06;
+      Settings.alarm[i].minute  = 45;
+      Settings.alarm[i].days    = ALARM_WEEKDAYS;
+      Settings.alarm[i].enabled = 0;
+    }
+    Settings.settingsLayout = SETTINGS_LAYOUT;
     Settings.timerPeriod    = TIMER_DEFAULT_PERIOD;
     Settings.calWeekAdjust  = 0;
+    Settings.wdtCorrection  = 0;
     Settings.nixieUptime    = 0;
     for (i = 0; i < SETTINGS_LUT_SIZE; i++) {
-      *SettingsLut[i].value = SettingsLut[i].defaultVal;
+      *SETTINGS_FIELD (i, value) = SETTINGS_FIELD (i, defaultVal);
     }
     Settings.settingsResetCode = SETTINGS_RESET_CODE;
     eepromWriteSettings ();
@@ -407,34 +585,25 @@ void setup() {
   PRINTLN ("[setup] other:");
   // validate settings loaded from EEPROM
   for (i = 0; i < SETTINGS_LUT_SIZE; i++) {
+    SettingsLut_t lut = progmemRead (&SettingsLut[i]);
     PRINT("  ");
-    PRINT (SettingsLut[i].idDigit1, DEC); PRINT ("."); PRINT (SettingsLut[i].idDigit0, DEC); PRINT ("=");
-    PRINTLN (*SettingsLut[i].value, DEC);
-    if (*SettingsLut[i].value < SettingsLut[i].minVal || *SettingsLut[i].value > SettingsLut[i].maxVal) *SettingsLut[i].value = SettingsLut[i].defaultVal;
+    PRINT (lut.idDigit1, DEC); PRINT ("."); PRINT (lut.idDigit0, DEC); PRINT ("=");
+    PRINTLN (*lut.value, DEC);
+    if (*lut.value < lut.minVal || *lut.value > lut.maxVal) *lut.value = lut.defaultVal;
   }
 
   PRINT   ("[setup] timerPeriod=");
   PRINTLN (Settings.timerPeriod, DEC);
 
-  // initialize Timer1 to trigger timer1ISR once per second
-  G.timer1Step = Timer1.initialize (Settings.timerPeriod / TIMER1_DIVIDER);
+  // initialize Timer1 to trigger timer1ISR every 10 ms
+  // the timekeeping, countdown timer and stopwatch events are all derived from this time base
+  step = Timer1.initialize (Settings.timerPeriod / (TIMER1_DIVIDER * TIMER1_TICKS));
   Timer1.attachInterrupt (timer1ISR);
 
-  // Timer2 is used for Chronometer and Countdown Timer features
-  // Timer2 has a maximum period of 32768us
-  G.timer2Step = Timer2.initialize (Settings.timerPeriod / (TIMER1_DIVIDER * TIMER2_DIVIDER));
-  Timer2.attachInterrupt (timer2ISR);
-  cli ();
-  Timer2.stop ();
-  Timer2.restart ();
-  sei ();
-  G.timer2SecCounter = 0;
-  G.timer2TenthCounter = 0;
+  // intialize the time base parameters
+  TimeBase.initialize (&Settings.timerPeriod, step);
 
-  // intialize the Timer1 and Timer2 parameters
-  timerCalculate();
-
-#ifndef SERIAL_DEBUG
+#if !defined (SERIAL_DEBUG) && !defined (SERIAL_TELEMETRY)
   // initialize the Buzzer driver (requires serial communication pin)
   Buzzer.initialize (BUZZER_PIN);
   // enable/disable the brightness boost feature (requires serial communication pin)
@@ -445,12 +614,38 @@ void setup() {
   Brightness.autoEnable (Settings.brightnessAutoAdjust);
 
   // initialize the alarm, countdown timer and stopwatch
-  Alarm.initialize (&Settings.alarm);
-  CdTimer.initialize (timerCallback);
+  Alarm.initialize (Settings.alarm, ALARM_NUM);
+  CdTimer.initialize ();
   Stopwatch.initialize (timerCallback);
 
   // activate DCF synchronization if enabled
   G.dcfSyncActive = Settings.dcfSyncEnabled;
+  for (i = 0; i < 24; i++) G.dcfHourRate[i] = DCF_RATE_INIT;
+
+  // derive the weekly schedule from the settings
+  scheduleBuild ();
+
+  // register the main loop tasks
+  // period in ms (0 = every pass), wake-up events
+  Scheduler.add (secondTask,       0,   SCHEDULER_SECOND);
+  Scheduler.add (displayTask,      0);
+  Scheduler.add (adcTask,          0);
+  Scheduler.add (settingsMenuTask, 0,   SCHEDULER_INPUT | SCHEDULER_SECOND | SCHEDULER_TENTH);
+  Scheduler.add (syncToDcfTask,    1);
+  Scheduler.add (cdTimerTask,      100, SCHEDULER_SECOND);
+  Scheduler.add (stopwatchTask,    10,  SCHEDULER_TENTH);
+  Scheduler.add (alarmTask,        10,  SCHEDULER_SECOND);
+#ifndef NIXIE_ISR_MULTIPLEX
+  Scheduler.add (buzzerTask,       1);
+#endif
+  Scheduler.add (journalTask,      10);
+#ifdef SERIAL_TELEMETRY
+  Scheduler.add (telemetryTask,    10);
+#endif
+
+#ifdef PROFILE_VALUES
+  Profile.reset ();
+#endif
 
   // enable the watchdog
   wdt_enable (WDT_TIMEOUT);
@@ -463,29 +658,62 @@ void setup() {
  * Arduino main loop
  ***********************************/
 void loop() {
-  static bool cppWasEnabled = false, blankWasEnabled = false;
-  static int8_t hour = 0, lastHour = 0, minute = 0, wday = 0;
+#if defined (PROFILE_VALUES) || defined (SERIAL_TELEMETRY)
+  uint32_t ts = micros ();
+#endif
+
+  wdt_reset ();      // reset the watchdog timer
+
+  Scheduler.run ();  // execute the due tasks
+
+#ifdef PROFILE_VALUES
+  Profile.loopDuration (micros () - ts);
+#endif
+#ifdef SERIAL_TELEMETRY
+  Telemetry.loopDuration (micros () - ts);
+#endif
+
+  Nixie.refresh ();  // refresh the Nixie tube display
+
+  // sleep until the next interrupt while the display is blanked
+  if (G.menuState == SHOW_BLANK) Scheduler.idle ();
+}
+/*********/
+
 
-  // actions to be executed once every second
-  if (G.timer1TickFlag) {
-    G.secTickMsStamp = millis ();
-    updateDigits ();  // update the Nixie display digits
-    G.timer1TickFlag = false;
-  }
+
+/***********************************
+ * Actions to be executed once every second
+ * woken up by the Timer1 ISR
+ ***********************************/
+void secondTask (void) {
+  static bool cppWasEnabled = false, blankHour = false, cppHour = false;
+  static int8_t hour = 0, lastHour = 0, wday = 0, lastWday = 0;
+  uint32_t bit;
+
+  G.secTickMsStamp = millis ();
+  updateDigits (true);  // update the Nixie display digits
 
   lastHour = hour;
+  lastWday = wday;
   hour     = G.localTm->tm_hour;
-  minute   = G.localTm->tm_min;
   wday     = G.localTm->tm_wday;
 
-  // start DCF77 reception at the specified hour
-  if (hour != lastHour && hour == Settings.dcfSyncHour && Settings.dcfSyncEnabled) G.dcfSyncActive = true;
-
-  Nixie.refresh (); // refresh the Nixie tube display
-                    // refresh method is called many times across the code to ensure smooth display operation
+  // look up the precomputed schedule upon the change of an hour or of the schedule itself
+  if (hour != lastHour || wday != lastWday || G.scheduleUpdated) {
+    bit       = (uint32_t)1 << hour;
+    blankHour = (G.blankSchedule[wday] & bit) != 0;
+    cppHour   = (G.cppSchedule & bit) != 0;
+    // start DCF77 reception at the scheduled hour if a synchronization is due
+    // or retry every hour after a failed reception attempt
+    if (hour != lastHour && (((G.dcfSchedule & bit) &&
+        G.systemTime - G.lastDcfSyncTime + ONE_HOUR >= TimeBase.syncInterval * 60) ||
+        (G.dcfRetry && Settings.dcfSyncEnabled))) G.dcfSyncActive = true;
+    G.scheduleUpdated = false;
+  }
 
   // enable cathode poisoning prevention effect at a preset hour
-  if (Settings.cathodePoisonPrevent == 1 && hour == Settings.cppStartHr && G.menuState != SET_HOUR) {
+  if (cppHour && G.menuState != SET_HOUR) {
     if (!cppWasEnabled) {
       G.cppEffectEnabled = true;
       cppWasEnabled = true;
@@ -496,30 +724,42 @@ void loop() {
     cppWasEnabled = false;
   }
 
-  Nixie.refresh ();
-
   // disable Nixie display at a preset hour interval in order to extend the Nixie tube lifetime
   // or permanently disable Nixie Display
-  if (Settings.blankScreenMode == 4 ||
-       ( ( (
-             (Settings.blankScreenMode >= 1 && Settings.blankScreenMode <= 3 ) && (
-               (Settings.blankScreenStartHr <  Settings.blankScreenFinishHr &&  hour >= Settings.blankScreenStartHr && hour < Settings.blankScreenFinishHr  ) ||
-               (Settings.blankScreenStartHr >= Settings.blankScreenFinishHr && (hour >= Settings.blankScreenStartHr || hour < Settings.blankScreenFinishHr) )
-             ) &&
-             (Settings.blankScreenMode != 2 || (wday >= 1 && wday <= 5) ) && (Settings.blankScreenMode != 3 || wday == 0 || wday == 6)
-           ) ||
-           (
-             (Settings.blankScreenMode2 >= 1 && Settings.blankScreenMode2 <= 3 ) && (
-               (Settings.blankScreenStartHr2 <  Settings.blankScreenFinishHr2 &&  hour >= Settings.blankScreenStartHr2 && hour < Settings.blankScreenFinishHr2  ) ||
-               (Settings.blankScreenStartHr2 >= Settings.blankScreenFinishHr2 && (hour >= Settings.blankScreenStartHr2 || hour < Settings.blankScreenFinishHr2) )
-             ) &&
-             (Settings.blankScreenMode2 != 2 || (wday >= 1 && wday <= 5) ) && (Settings.blankScreenMode2 != 3 || wday == 0 || wday == 6)
-           )
-         ) && !G.cppEffectEnabled
-       )
-     ) {
+  G.blankScreen = Settings.blankScreenMode == 4 || (blankHour && !G.cppEffectEnabled);
+
+  // write-back system settings to EEPROM every night
+  if (hour != lastHour && hour == 1 && G.menuState != SET_HOUR) {
+      eepromWriteSettings ();
+      PRINTLN ("[secondTask] >EEPROM");
+  }
+
+#ifdef SERIAL_DEBUG
+  // print the current time
+  if (G.printTickCount >= 15) {
+    PRINT ("[secondTask] ");
+    PRINTLN (asctime (localtime (&G.systemTime)));
+    //PRINT ("[secondTask] nixieUptime=");
+    //PRINTLN (Settings.nixieUptime, DEC);
+    G.printTickCount = 0;
+  }
+#endif
+}
+/*********/
+
+
+
+/***********************************
+ * Apply the screen blanking and
+ * the DCF77 signal indicator
+ ***********************************/
+void displayTask (void) {
+  static bool blankWasEnabled = false;
+  static bool dcfSyncWasActive = false;
+
+  if (G.blankScreen) {
     if (!blankWasEnabled && G.menuState == SHOW_TIME) {
-      G.menuState = SHOW_BLANK_E;
+      menuSwitch (SHOW_BLANK);
       blankWasEnabled = true;
     }
     // re-enable blanking after switching to the service display /*or at the change of an hour*/
@@ -529,7 +769,7 @@ void loop() {
   }
   // disable blanking if blanking blankScreenMode != 4, CPP is enabled or outside the preset time intervals
   else if (G.menuState == SHOW_BLANK) {
-    G.menuState = SHOW_TIME_E;
+    menuSwitch (SHOW_TIME);
     blankWasEnabled = false;
   }
   // ensure that blankWasEnabled is reset after blanking period elapses, even if not in blanking mode
@@ -537,338 +777,767 @@ void loop() {
     blankWasEnabled = false;
   }
 
-  Nixie.refresh ();
-
-  // write-back system settings to EEPROM every night
-  if (hour != lastHour && hour == 1 && G.menuState != SET_HOUR) {
-      Nixie.blank ();
-      eepromWriteSettings ();
-      PRINTLN ("[loop] >EEPROM");
-  }
-
-  Nixie.refresh ();
-
   // toggle the decimal point for the DCF signal indicator
-  static bool dcfSyncWasActive = false;
   if (G.dcfSyncActive) {
     // DCF77 sync status indicator
-    Nixie.comma[1] = Dcf.level || !Settings.dcfSignalIndicator;
+    Nixie.setComma (1, Dcf.level || !Settings.dcfSignalIndicator);
     dcfSyncWasActive = true;
 #ifdef DCF_DEBUG_VALUES
     static bool debugValuesWereEnabled = false;
     if (G.menuState == SHOW_TIME) {
-      Nixie.comma[2] = Dcf.debug[0];
-      Nixie.comma[3] = Dcf.debug[1];
-      Nixie.comma[4] = Dcf.debug[2];
-      Nixie.comma[5] = Dcf.debug[3];
+      Nixie.setComma (2, Dcf.debug[0]);
+      Nixie.setComma (3, Dcf.debug[1]);
+      Nixie.setComma (4, Dcf.debug[2]);
+      Nixie.setComma (5, Dcf.debug[3]);
       debugValuesWereEnabled = true;
     }
     else if (debugValuesWereEnabled) {
-      Nixie.comma[2] = false;
-      Nixie.comma[3] = false;
-      Nixie.comma[4] = false;
-      Nixie.comma[5] = false;
+      Nixie.setComma (2, false);
+      Nixie.setComma (3, false);
+      Nixie.setComma (4, false);
+      Nixie.setComma (5, false);
       debugValuesWereEnabled = false;
     }
 #endif
   }
   else if (dcfSyncWasActive) {
-    Nixie.comma[1] = false;
+    Nixie.setComma (1, false);
     dcfSyncWasActive = false;
   }
+}
+/*********/
 
-  Nixie.refresh ();
 
-  adcRead ();               // process the ADC channels
 
-  Nixie.refresh ();
+/***********************************
+ * Loop handlers of the various features
+ * executed as scheduler tasks
+ ***********************************/
+void cdTimerTask (void) {
+  CdTimer.loopHandler ();
+}
 
-  settingsMenu ();          // navigate the settings menu
+void stopwatchTask (void) {
+  Stopwatch.loopHandler ();
+}
 
-  Nixie.refresh ();
+void alarmTask (void) {
+  Alarm.loopHandler (G.systemTime, G.localTm, G.menuState != SET_MIN && G.menuState != SET_SEC);
+}
 
-  syncToDcf ();             // synchronize with DCF77 time
+#ifndef NIXIE_ISR_MULTIPLEX
+void buzzerTask (void) {
+  Buzzer.loopHandler ();
+}
+#endif
 
-  Nixie.refresh ();
+void adcTask (void) {
+  PROFILE (PROFILE_ADC_READ, adcRead ());
+}
 
-  CdTimer.loopHandler ();   // countdown timer loop handler
+void settingsMenuTask (void) {
+  PROFILE (PROFILE_SETTINGS, settingsMenu ());
+}
 
-  Nixie.refresh ();
+void syncToDcfTask (void) {
+  PROFILE (PROFILE_SYNC_TO_DCF, syncToDcf ());
+}
 
-  Stopwatch.loopHandler (); // stopwatch loop handler
+void journalTask (void) {
+  Journal.loopHandler ();
+}
+/*********/
 
-  Nixie.refresh ();
 
-  Alarm.loopHandler (hour, minute, wday, G.menuState != SET_MIN && G.menuState != SET_SEC);  // alarm clock loop handler
 
-  Nixie.refresh ();
+#ifdef SERIAL_TELEMETRY
+/***********************************
+ * Serial telemetry task
+ * executes the received commands and publishes
+ * one telemetry record per second in a round-robin fashion:
+ *   U t=<UTC Unix time> up=<uptime s> nx=<Nixie uptime s> drop=<dropped lines>
+ *   D per=<timerPeriod> var=<drift variance 1/16 units squared> int=<sync interval min> wdt=<watchdog correction µs>
+ *   F sync=<last sync Unix time> act=<sync active> hr=<best hour> rate=<success rate %> dur=<last attempt s> err=<frame errors>
+ *   B als=<light sensor> lvl=<brightness> auto=<auto brightness>
+ *   L max=<max loop µs> avg=<average loop µs> gap=<max slot gap µs> miss=<missed slots>
+ ***********************************/
+void telemetryTask (void) {
+  static time_t lastTime = 0;
+  static uint32_t lastMs = 0;
+  static uint32_t uptime = 0;
+  static uint8_t record = 0;
+  uint32_t ms, elapsed;
+  char *cmd;
+
+  cmd = Telemetry.command ();
+  if (cmd != NULL) {
+    telemetryCommand (cmd);
+    Telemetry.commandDone ();
+  }
 
-  Buzzer.loopHandler ();    // buzzer loop handler
+  if (G.systemTime == lastTime) return;
+  lastTime = G.systemTime;
 
+  // accumulate the uptime in seconds, carry the remaining milliseconds over
+  ms       = millis ();
+  elapsed  = ms - lastMs;
+  uptime  += elapsed / 1000;
+  lastMs   = ms - elapsed % 1000;
 
-#ifdef SERIAL_DEBUG
-  // print the current time
-  if (G.printTickCount >= 15) {
-    PRINT ("[loop] ");
-    PRINTLN (asctime (localtime (&G.systemTime)));
-    //PRINT ("[loop] nixieUptime=");
-    //PRINTLN (Settings.nixieUptime, DEC);
-    G.printTickCount = 0;
+  if (record == 0) {
+    Telemetry.lineBegin ('U');
+    Telemetry.field (PSTR("t"), G.systemTime + UNIX_OFFSET);
+    Telemetry.field (PSTR("up"), uptime);
+    cli ();
+    ms = Settings.nixieUptime;
+    sei ();
+    Telemetry.field (PSTR("nx"), ms);
+    Telemetry.field (PSTR("drop"), Telemetry.dropped);
   }
-#endif
+  else if (record == 1) {
+    Telemetry.lineBegin ('D');
+    Telemetry.field (PSTR("per"), Settings.timerPeriod);
+    Telemetry.field (PSTR("var"), TimeBase.driftVar);
+    Telemetry.field (PSTR("int"), TimeBase.syncInterval);
+    Telemetry.field (PSTR("wdt"), Settings.wdtCorrection);
+  }
+  else if (record == 2) {
+    Telemetry.lineBegin ('F');
+    Telemetry.field (PSTR("sync"), G.lastDcfSyncTime != 0 ? G.lastDcfSyncTime + UNIX_OFFSET : 0);
+    Telemetry.field (PSTR("act"), G.dcfSyncActive);
+    Telemetry.field (PSTR("hr"), G.dcfBestHour);
+    Telemetry.field (PSTR("rate"), (uint16_t)G.dcfHourRate[G.dcfBestHour] * 100 / 255);
+    Telemetry.field (PSTR("dur"), G.dcfLastDuration);
+    Telemetry.field (PSTR("err"), G.dcfLastErrors);
+  }
+  else if (record == 3) {
+    Telemetry.lineBegin ('B');
+    Telemetry.field (PSTR("als"), G.lightSensor);
+    Telemetry.field (PSTR("lvl"), G.brightnessLevel);
+    Telemetry.field (PSTR("auto"), Settings.brightnessAutoAdjust);
+  }
+  else {
+    Telemetry.lineBegin ('L');
+    Telemetry.field (PSTR("max"), Telemetry.loopMax);
+    Telemetry.field (PSTR("avg"), Telemetry.loopAvg >> 4);
+    cli ();
+    ms      = Nixie.maxSlotGap;
+    elapsed = Nixie.missedSlots;
+    sei ();
+    Telemetry.field (PSTR("gap"), ms);
+    Telemetry.field (PSTR("miss"), elapsed);
+    Telemetry.loopMax = 0;
+  }
+  Telemetry.lineEnd ();
+
+  record++;
+  if (record > 4) record = 0;
 }
 /*********/
 
 
 
 /***********************************
- * Write settings back to EEPROM
+ * Execute a serial command line
+ * every command is answered by a line with the command tag, "E" upon error:
+ *   S<id>        read the setting <id> (settings menu ID, e.g. S11 = time zone)
+ *   S<id>=<val>  write the setting <id>
+ *   T            read the system time
+ *   T<time>      set the system time to the UTC Unix time <time>
+ *   C            trigger the cathode poisoning prevention routine
  ***********************************/
-void eepromWriteSettings (void) {
-  eepromWrite (EEPROM_SETTINGS_ADDR, (uint8_t *)&Settings, sizeof (Settings));
-  Brightness.eepromWrite ();
+void telemetryCommand (char *cmd) {
+  char *end;
+  int32_t id, val;
+  int16_t old;
+  uint8_t i;
+
+  if (cmd[0] == 'S') {
+    id = strtol (&cmd[1], &end, 10);
+    for (i = 0; i < SETTINGS_LUT_SIZE; i++) {
+      if (SETTINGS_FIELD (i, idDigit1) * 10 + SETTINGS_FIELD (i, idDigit0) == id) break;
+    }
+    if (end == &cmd[1] || i >= SETTINGS_LUT_SIZE) goto TELEMETRY_ERROR;
+    if (*end == '=') {
+      val = strtol (end + 1, &end, 10);
+      if (*end != 0 || val < SETTINGS_FIELD (i, minVal) || val > SETTINGS_FIELD (i, maxVal)) goto TELEMETRY_ERROR;
+      old = *SETTINGS_FIELD (i, value);
+      *SETTINGS_FIELD (i, value) = (int8_t)val;
+      settingsApply (i, val - old);
+      eepromWriteSettings ();
+    }
+    else if (*end != 0) {
+      goto TELEMETRY_ERROR;
+    }
+    Telemetry.lineBegin ('S');
+    Telemetry.field (PSTR("id"), id);
+    Telemetry.field (PSTR("v"), *SETTINGS_FIELD (i, value));
+    Telemetry.field (PSTR("min"), SETTINGS_FIELD (i, minVal));
+    Telemetry.field (PSTR("max"), SETTINGS_FIELD (i, maxVal));
+    Telemetry.lineEnd ();
+  }
+  else if (cmd[0] == 'T') {
+    if (cmd[1] != 0) {
+      val = strtol (&cmd[1], &end, 10);
+      if (*end != 0 || val < UNIX_OFFSET) goto TELEMETRY_ERROR;
+      cli ();
+      set_system_time (val - UNIX_OFFSET);
+      sei ();
+      updateDigits ();
+      G.manuallyAdjusted = true;
+      G.wdtCycles = 0;  // the time deviation does not reflect the deep sleep accuracy anymore
+    }
+    Telemetry.lineBegin ('T');
+    Telemetry.field (PSTR("t"), time (NULL) + UNIX_OFFSET);
+    Telemetry.lineEnd ();
+  }
+  else if (cmd[0] == 'C' && cmd[1] == 0) {
+    if (G.menuState != SHOW_TIME) goto TELEMETRY_ERROR;
+    Nixie.setBrightness (Brightness.maximum ());
+    Nixie.cathodePoisonPrevent ();
+    Telemetry.lineBegin ('C');
+    Telemetry.lineEnd ();
+  }
+  else {
+    goto TELEMETRY_ERROR;
+  }
+  return;
+
+  TELEMETRY_ERROR:
+  Telemetry.lineBegin ('E');
+  Telemetry.lineEnd ();
 }
 /*********/
+#endif // SERIAL_TELEMETRY
 
 
 
 /***********************************
- * Timer1 ISR
- * Triggered once every second by Timer 1
+ * Add a screen blanking profile
+ * to the blanking schedule
  ***********************************/
-void timer1ISR (void) {
-  static uint32_t fractCountH = 0;
-  static uint32_t fractCountL = 0;
-  static bool toggleFlag = false;
-  uint8_t add1;
+void scheduleAddBlankProfile (uint8_t mode, uint8_t startHr, uint8_t finishHr) {
+  uint32_t hours = 0;
+  uint8_t h, d;
 
-  system_tick ();
+  if (mode < 1 || mode > 3) return;
 
-  if (Nixie.enabled) Settings.nixieUptime++;
+  for (h = 0; h < 24; h++) {
+    if ( (startHr <  finishHr &&  h >= startHr && h < finishHr ) ||
+         (startHr >= finishHr && (h >= startHr || h < finishHr)) ) hours |= (uint32_t)1 << h;
+  }
+  for (d = 0; d < 7; d++) {
+    if ( (mode != 2 || (d >= 1 && d <= 5)) && (mode != 3 || d == 0 || d == 6) ) G.blankSchedule[d] |= hours;
+  }
+}
+/*********/
 
-  if (fractCountL < G.timer1PeriodFL) add1 = 1;
-  else                                add1 = 0;
 
-  // dynamically adjust the timer period to account for fractions of a step
-  if (fractCountH < (G.timer1PeriodFH + add1) && (!toggleFlag || G.timer1UpdateFlag) ) {
-    Timer1.setPeriod (G.timer1PeriodHigh);
-    toggleFlag = true;
-    G.timer1UpdateFlag = false;
-  }
 
-  // dynamically adjust the timer period to account for fractions of a step
-  if (fractCountH >= (G.timer1PeriodFH + add1) && (toggleFlag || G.timer1UpdateFlag) ) {
-    Timer1.setPeriod (G.timer1PeriodLow);
-    toggleFlag = false;
-    G.timer1UpdateFlag = false;
-  }
+/***********************************
+ * Rebuild the weekly schedule of the
+ * screen blanking, cathode poisoning prevention
+ * and DCF77 synchronization out of the settings
+ ***********************************/
+void scheduleBuild (void) {
+  uint8_t d;
 
-  fractCountH++;
-  if (fractCountH >= G.timer1Step ) {
-    fractCountH = 0;
-    fractCountL++;
-    if (fractCountL >= TIMER1_DIVIDER ) {
-      fractCountL = 0;
-    }
-  }
+  for (d = 0; d < 7; d++) G.blankSchedule[d] = 0;
+  scheduleAddBlankProfile (Settings.blankScreenMode,  Settings.blankScreenStartHr,  Settings.blankScreenFinishHr);
+  scheduleAddBlankProfile (Settings.blankScreenMode2, Settings.blankScreenStartHr2, Settings.blankScreenFinishHr2);
 
-  G.timer1TickFlag = true;
+  G.cppSchedule = 0;
+  if (Settings.cathodePoisonPrevent == 1) G.cppSchedule = (uint32_t)1 << Settings.cppStartHr;
 
-#ifdef SERIAL_DEBUG
-  G.printTickCount++;
-#endif
+  G.dcfBestHour = syncBestHour ();
+  G.dcfSchedule = 0;
+  if (Settings.dcfSyncEnabled) G.dcfSchedule = (uint32_t)1 << G.dcfBestHour;
+
+  G.scheduleUpdated = true;
 }
 /*********/
 
 
 
 /***********************************
- * Timer2 ISR
- * Triggered once every 25ms by Timer 2
+ * Apply the side effects of a changed
+ * setting of the settings lookup table
+ * delta is the amount by which the value has changed
  ***********************************/
-void timer2ISR (void) {
-  static uint32_t fractCountH = 0;
-  static uint32_t fractCountL = 0;
-  static bool toggleFlag = false;
-  uint8_t add1;
-
-  G.timer2SecCounter++;
-  G.timer2TenthCounter++;
+void settingsApply (uint8_t idx, int16_t delta) {
+  int8_t *value = SETTINGS_FIELD (idx, value);
 
-  // 1s period = 25ms * 40
-  if (G.timer2SecCounter >= TIMER2_DIVIDER) {
-    CdTimer.tick ();
-    G.timer2SecCounter = 0;
-  }
+  scheduleBuild ();
 
-  // 1/10s period = 25ms * 4
-  if (G.timer2TenthCounter >= TIMER2_DIVIDER / 10) {
-    Stopwatch.tick ();
-    G.timer2TenthCounter = 0;
+  // if clock drift correction value has been set
+  if (value == (int8_t *)&Settings.clockDriftCorrect) {
+    Settings.timerPeriod += delta;
+    TimeBase.calculate ();
+    G.manuallyAdjusted = true;
+    TimeBase.reset ();  // the drift estimate is not trusted anymore
   }
-
-  if (fractCountL < G.timer2PeriodFL) add1 = 1;
-  else                                add1 = 0;
-
-  // dynamically adjust the timer period to account for fractions of a step
-  if (fractCountH < (G.timer2PeriodFH + add1) && (!toggleFlag || G.timer2UpdateFlag) ) {
-    Timer2.setPeriod (G.timer2PeriodHigh);
-    toggleFlag = true;
-    G.timer2UpdateFlag = false;
+  // if the week start day has been changed
+  else if (value == (int8_t *)&Settings.weekStartDay) {
+    Calendar.update (G.localTm, Settings.weekStartDay);
   }
-
-  // dynamically adjust the timer period to account for fractions of a step
-  if (fractCountH >= (G.timer2PeriodFH + add1) && (toggleFlag || G.timer2UpdateFlag) ) {
-    Timer2.setPeriod (G.timer2PeriodLow);
-    toggleFlag = false;
-    G.timer2UpdateFlag = false;
+  // if auto brightness feature was activated/deactivated
+  else if (value == (int8_t *)&Settings.brightnessAutoAdjust) {
+    Brightness.autoEnable (Settings.brightnessAutoAdjust);
   }
-
-  fractCountH++;
-  if (fractCountH >= G.timer2Step ) {
-    fractCountH = 0;
-    fractCountL++;
-    if (fractCountL >= TIMER2_DIVIDER ) {
-      fractCountL = 0;
-    }
+#if !defined (SERIAL_DEBUG) && !defined (SERIAL_TELEMETRY)
+  // if the brighness boost feature has been activated/deactivated
+  else if (value == (int8_t *)&Settings.brightnessBoost) {
+    Brightness.boostEnable (Settings.brightnessBoost);
   }
+#endif
 }
 /*********/
 
 
 
 /***********************************
- * Watchdog expiry ISR
- * takes over system ticking during Deep Sleep
+ * Write settings back to EEPROM
+ * only the changed settings bytes are appended to the journal
+ * the actual EEPROM writes are committed in the background
  ***********************************/
-ISR (WDT_vect)  {
-  system_tick ();
+void eepromWriteSettings (void) {
+  PROFILE (PROFILE_EEPROM_WRITE,
+    Journal.write ();
+    Brightness.eepromWrite ();
+  );
 }
 /*********/
 
 
 
 /***********************************
- * Countdown timer and stopwatch callback function
+ * Migrate the settings stored using an older layout
+ * layout 1: the single alarm of the initial layout becomes the first alarm,
+ *           its mode (number of alarm days: 0, 2, 5 or 7) is converted into a day-of-week mask
+ * layout 2: the calendar week is computed exactly, the former compensation value is discarded
  ***********************************/
-void timerCallback (bool start) {
-  if (start) {
-    Timer2.start ();
+void settingsMigrate (void) {
+  uint8_t i, mode, lastMode;
+
+  if (Settings.settingsLayout < 1) {
+    mode     = Settings.legacyAlarm[2];
+    lastMode = Settings.legacyAlarm[4];
+    if (mode == 0) mode = lastMode;
+
+    for (i = 0; i < ALARM_NUM; i++) {
+      Settings.alarm[i].hour    = 06;
+      Settings.alarm[i].minute  = 45;
+      Settings.alarm[i].days    = ALARM_WEEKDAYS;
+      Settings.alarm[i].enabled = 0;
+    }
+    Settings.alarm[0].hour    = (int8_t)Settings.legacyAlarm[0];
+    Settings.alarm[0].minute  = (int8_t)Settings.legacyAlarm[1];
+    Settings.alarm[0].days    = mode == 2 ? ALARM_WEEKENDS : mode == 7 ? ALARM_DAILY : ALARM_WEEKDAYS;
+    Settings.alarm[0].enabled = Settings.legacyAlarm[2] != 0;
+    for (i = 0; i < sizeof (Settings.legacyAlarm); i++) Settings.legacyAlarm[i] = 0;
+
+    // the brightness lookup table has been moved behind the extended settings
+    Brightness.initializeLut ();
   }
-  else {
-    cli ();
-    Timer2.stop ();
-    Timer2.restart ();
-    sei ();
-    G.timer2SecCounter   = 0;
-    G.timer2TenthCounter = 0;
+
+  if (Settings.settingsLayout < 2) {
+    Settings.calWeekAdjust = 0;
   }
+
+  Settings.settingsLayout = SETTINGS_LAYOUT;
+  eepromWriteSettings ();
+  PRINTLN ("[settingsMigrate] settings migrated");
 }
 /*********/
 
 
 
 /***********************************
- * Get the daylight saving time offset
+ * Power-fail checkpoint
+ * only the volatile settings that change while running
+ * are written into a pre-erased dedicated EEPROM slot
+ * using the faster write-only programming mode
  ***********************************/
-inline int8_t getDstOffset (void) {
-  // Automatic DST
-  if (Settings.dstEnabled == 2) {
-    return G.dstActive;
-  }
-  // Manual DST
-  else {
-    return Settings.dstEnabled;
-  }
+uint8_t checkpointCheck (Checkpoint_t *cp) {
+  uint8_t *p = (uint8_t *)cp;
+  uint8_t i, sum = 0;
+  for (i = 0; i < sizeof (Checkpoint_t) - 1; i++) sum += p[i];
+  return sum ^ 0x5A;  // an erased slot (all 0xFF) never passes the check
 }
-/*********/
 
+void checkpointWrite (void) {
+  Checkpoint_t cp;
+  uint8_t i;
+  bool erased = true;
 
+  cp.nixieUptime = Settings.nixieUptime;
+  cp.timerPeriod = Settings.timerPeriod;
+  cp.check       = checkpointCheck (&cp);
 
-/***********************************
- * Convert UTC time to local time
- ***********************************/
-time_t convertToLocalTime (time_t time) {
-  int8_t dst = getDstOffset ();
-  return time + (Settings.timeZone + dst) * (int32_t)ONE_HOUR;
+  for (i = 0; i < sizeof (Checkpoint_t); i++) {
+    if (EepromQueue.read (EEPROM_CHECKPOINT_ADDR + i) != 0xFF) erased = false;
+  }
+  PROFILE (PROFILE_EEPROM_WRITE,
+    if (erased) {
+      EepromQueue.program (EEPROM_CHECKPOINT_ADDR, (uint8_t *)&cp, sizeof (Checkpoint_t));
+    }
+    else {
+      EepromQueue.write (EEPROM_CHECKPOINT_ADDR, (uint8_t *)&cp, sizeof (Checkpoint_t));
+      EepromQueue.flush ();
+    }
+  );
 }
-/*********/
 
+void checkpointRestore (void) {
+  Checkpoint_t cp;
+  uint8_t i;
+  bool erased = true;
 
+  EepromQueue.read (EEPROM_CHECKPOINT_ADDR, (uint8_t *)&cp, sizeof (Checkpoint_t));
 
-/***********************************
- * Convert local time back to UTC time
- ***********************************/
-time_t convertToUtcTime (time_t time) {
-  int8_t dst = getDstOffset ();
-  return time - (Settings.timeZone + dst) * (int32_t)ONE_HOUR;
+  if (cp.check == checkpointCheck (&cp)) {
+    if (cp.nixieUptime > Settings.nixieUptime) Settings.nixieUptime = cp.nixieUptime;
+    Settings.timerPeriod = cp.timerPeriod;
+    eepromWriteSettings ();
+    PRINTLN ("[checkpointRestore] restored");
+  }
+
+  for (i = 0; i < sizeof (Checkpoint_t); i++) {
+    if (((uint8_t *)&cp)[i] != 0xFF) erased = false;
+  }
+  // the settings journal is committed before erasing
+  if (!erased) EepromQueue.erase (EEPROM_CHECKPOINT_ADDR, sizeof (Checkpoint_t));
 }
 /*********/
 
 
 
 /***********************************
- * Synchronize the system clock
- * with the DCF77 time
+ * Timer1 ISR
+ * Triggered once every 10 ms by Timer 1
  ***********************************/
-void syncToDcf (void) {
-  static bool coldStart = true;  // flag to indicate initial sync after power-up
-  static bool dcfWasActive = true;
-  static int32_t lastDeltaMs = 0;
-  uint8_t rv;
-  int32_t delta, deltaMs, ms;
-  time_t timeSinceLastSync;
-  time_t sysTime, dcfTime;
+static_assert (TIMER1_TICKS == 100, "the stopwatch counts Timer1 ticks as 1/100 s");
 
-  // enable DCF77 reception
-  if (G.dcfSyncActive) {
-    if (!dcfWasActive) {
-      Dcf.resumeReception ();
-      PRINTLN ("[syncToDcf] resume");
-      dcfWasActive = true;
-    }
+void timer1ISR (void) {
+  static uint32_t phase = 0;
+  static uint32_t period = 0;
+  uint32_t next;
+
+  // phase accumulator: alternate between the rounded-down and rounded-up periods
+  // such that the average tick period equals timerPeriod / (TIMER1_DIVIDER * TIMER1_TICKS)
+  phase += TimeBase.tickPhaseInc;
+  if (phase >= TimeBase.tickPhaseMod) {
+    phase -= TimeBase.tickPhaseMod;
+    next = TimeBase.tickPeriodHigh;
   }
   else {
-    if (dcfWasActive) {
-      Dcf.pauseReception ();
-      PRINTLN ("[syncToDcf] pause");
-      dcfWasActive = false;
+    next = TimeBase.tickPeriodLow;
+  }
+  if (next != period) {
+    Timer1.setPeriod (next);
+    period = next;
+  }
+
+  // 1/100 s and 1/10 s stopwatch ticks
+  if (G.chronoRunning) {
+    Stopwatch.tick ();
+    G.chronoTickCount++;
+    if (G.chronoTickCount >= TIMER1_TICKS / 10) {
+      G.chronoTickCount = 0;
+      Scheduler.signal (SCHEDULER_TENTH);
     }
   }
 
-  // read DCF77 time
-  rv = Dcf.getTime ();
+  // 1 s timekeeping tick
+  G.tickCount++;
+  if (G.tickCount < TIMER1_TICKS) return;
+  G.tickCount = 0;
 
-  Nixie.refresh ();  // refresh the Nixie tube display
+  system_tick ();
+  DcfCapture.secondTick ();
+  CdTimer.tick ();
 
-  // DCF77 time has been successfully decoded
-  if (G.dcfSyncActive && rv == 0) {
-    ms      = millis () - G.secTickMsStamp;  // milliseconds elapsed since the last full second
-    sysTime = G.systemTime;                  // get the current system time
-    dcfTime = mktime (&Dcf.currentTm);       // get the DCF77 timestamp (converted to UTC according to the value of tm_isdst)
+  if (Nixie.enabled) Settings.nixieUptime++;
 
-    delta   = (int32_t)(sysTime - dcfTime);           // time difference between the system time and DCF77 time in seconds
+  Scheduler.signal (SCHEDULER_SECOND);
+
+#ifdef SERIAL_DEBUG
+  G.printTickCount++;
+#endif
+}
+/*********/
+
+
+
+/***********************************
+ * Watchdog expiry ISR
+ * takes over system ticking during Deep Sleep
+ ***********************************/
+ISR (WDT_vect)  {
+  if (G.wdtCalibCount > 0) {
+    G.wdtCalibCount--;
+    return;
+  }
+
+  // accumulate the watchdog periods, the remainder is carried over to the next second
+  G.wdtCycles++;
+  G.wdtAccu += G.wdtPeriod;
+  while (G.wdtAccu >= 1000000) {
+    system_tick ();
+    G.wdtAccu -= 1000000;
+  }
+}
+/*********/
+
+
+
+/***********************************
+ * Measure the watchdog period
+ * counts WDT_CALIB_CYCLES short watchdog periods using micros ()
+ * the result is corrected using the crystal drift compensation of Timer1
+ * must be called during the light sleep, returns the equivalent
+ * of the 1 s deep sleep watchdog period in µs
+ ***********************************/
+uint32_t wdtCalibrate (void) {
+  uint32_t ts, period;
+  int32_t  drift;
+
+  power_timer0_enable ();           // micros () is required for the measurement
+  set_sleep_mode (SLEEP_MODE_IDLE);
+  G.wdtCalibCount = WDT_CALIB_CYCLES + 1;
+  cli ();
+  wdt_reset ();
+  WDTCSR |= _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE);               // enable watchdog interrupt, set to 16 ms (see datasheet Section 15.9.2)
+  sei ();
+
+  // synchronize with the first watchdog interrupt, then measure
+  while (G.wdtCalibCount > WDT_CALIB_CYCLES) sleep_mode ();
+  ts = micros ();
+  while (G.wdtCalibCount > 0) sleep_mode ();
+  ts = micros () - ts;
+  wdt_disable ();
+  power_timer0_disable ();
+
+  // the 1 s watchdog period consists of 64 times more oscillator cycles
+  period = ts * (64 / WDT_CALIB_CYCLES);
+
+  // crystal drift in µs per second, as compensated by Timer1
+  drift  = (int32_t)(TIMER_DEFAULT_PERIOD - Settings.timerPeriod) / TIMER1_DIVIDER;
+  period = period + (int32_t)(period / 1000) * drift / 1000;
+
+  PRINT   ("[wdtCalibrate] period=");
+  PRINTLN (period, DEC);
+
+  return period;
+}
+/*********/
+
+
+
+/***********************************
+ * Refine the watchdog period correction
+ * using the time deviation accumulated during deep sleep
+ * which is measured by the first DCF77 synchronization after a power failure
+ * Parameters:
+ *   deltaMs : system time minus DCF77 time in ms
+ ***********************************/
+void wdtRefine (int32_t deltaMs) {
+  int32_t err, corr;
+
+  err  = deltaMs * 1000 / (int32_t)G.wdtCycles;  // µs per watchdog period, positive if the clock was ahead
+  corr = (int32_t)Settings.wdtCorrection - err / 2;  // IIR filtering against the measurement noise
+  if (corr < -WDT_CORRECTION_MAX) corr = -WDT_CORRECTION_MAX;
+  if (corr >  WDT_CORRECTION_MAX) corr =  WDT_CORRECTION_MAX;
+  Settings.wdtCorrection = (int16_t)corr;
+  eepromWriteSettings ();
+
+  PRINT   ("[wdtRefine] wdtCycles=");
+  PRINT   (G.wdtCycles, DEC);
+  PRINT   (" err=");
+  PRINT   (err, DEC);
+  PRINT   (" wdtCorrection=");
+  PRINTLN (Settings.wdtCorrection, DEC);
+}
+/*********/
+
+
+
+/***********************************
+ * Stopwatch callback function
+ ***********************************/
+void timerCallback (bool start) {
+  cli ();
+  G.chronoRunning = start;
+  if (!start) G.chronoTickCount = 0;
+  sei ();
+}
+/*********/
+
+
+
+/***********************************
+ * Get the daylight saving time offset
+ * automatic DST follows the DST flag of the DCF77 time signal,
+ * the EU rule is used before the first sync in the European time zones (see updateDigits())
+ ***********************************/
+inline int8_t getDstOffset (void) {
+  // Automatic DST
+  if (Settings.dstEnabled == 2) {
+    return G.dstActive;
+  }
+  // Manual DST
+  else {
+    return Settings.dstEnabled;
+  }
+}
+/*********/
+
+
+
+/***********************************
+ * Convert UTC time to local time
+ ***********************************/
+time_t convertToLocalTime (time_t time) {
+  int8_t dst = getDstOffset ();
+  return time + (Settings.timeZone + dst) * (int32_t)ONE_HOUR;
+}
+/*********/
+
+
+
+/***********************************
+ * Convert local time back to UTC time
+ ***********************************/
+time_t convertToUtcTime (time_t time) {
+  int8_t dst = getDstOffset ();
+  return time - (Settings.timeZone + dst) * (int32_t)ONE_HOUR;
+}
+/*********/
+
+
+
+/***********************************
+ * Synchronize the system clock
+ * with the DCF77 time
+ ***********************************/
+void syncToDcf (void) {
+  static bool coldStart = true;  // flag to indicate initial sync after power-up
+  static bool dcfWasActive = true;
+  static int32_t lastDeltaMs = 0;
+  uint8_t rv, srv;
+  bool fromStream = false;
+  tm *dcfTm = &Dcf.currentTm;
+  bool dcfCest;
+  int32_t delta, deltaMs, deltaUs, ms;
+  uint32_t phaseUs;
+  time_t timeSinceLastSync;
+  time_t sysTime, edgeTime, dcfTime;
+
+  // enable DCF77 reception
+  if (G.dcfSyncActive) {
+    if (!dcfWasActive) {
+      Dcf.resumeReception ();
+      PRINTLN ("[syncToDcf] resume");
+      dcfWasActive = true;
+    }
+  }
+  else {
+    if (dcfWasActive) {
+      Dcf.pauseReception ();
+      PRINTLN ("[syncToDcf] pause");
+      dcfWasActive = false;
+    }
+  }
+
+  // read DCF77 time
+  rv  = Dcf.getTime ();
+  srv = DcfStream.getTime ();
+  dcfCest = (bool)Dcf.dcfTime.cest;
+
+  // fall back to the streaming decoder if no valid telegram has been received
+  if (rv != 0 && srv == 0) {
+    fromStream = true;
+    dcfTm      = &DcfStream.currentTm;
+    dcfCest    = DcfStream.cest;
+  }
+
+  Nixie.refresh ();  // refresh the Nixie tube display
+
+  // reception attempt statistics
+  if (G.dcfSyncActive) {
+    if (G.dcfAttemptStart == 0) {
+      G.dcfAttemptStart = G.systemTime;
+      G.dcfAttemptHour  = G.localTm->tm_hour;
+      G.dcfErrors       = 0;
+    }
+    if (rv > 0 && rv <= 32) G.dcfErrors++;
+    // give up and pause the reception
+    if (G.systemTime - G.dcfAttemptStart > DCF_SYNC_TIMEOUT) {
+      G.dcfSyncActive = false;
+      syncAttemptEnd (false);
+      PRINTLN ("[syncToDcf] timeout");
+      return;
+    }
+  }
+  else {
+    G.dcfAttemptStart = 0;
+  }
+
+  // DCF77 time has been successfully decoded
+  if (G.dcfSyncActive && (rv == 0 || fromStream)) {
+    ms      = millis () - G.secTickMsStamp;  // milliseconds elapsed since the last full second
+    sysTime = G.systemTime;                  // get the current system time
+    dcfTime = mktime (dcfTm);                // get the DCF77 timestamp (converted to UTC according to the value of tm_isdst)
+    if (fromStream) dcfTime += DcfStream.markDelay;  // the streaming decoder may deliver after the minute mark
+
+    delta   = (int32_t)(sysTime - dcfTime);           // time difference between the system time and DCF77 time in seconds
     deltaMs = delta * 1000 + ms;                      // above time difference in milliseconds
+    deltaUs = deltaMs * 1000;                         // above time difference in µs
+
+    // use the captured minute start edge for a higher resolution
+    if (DcfCapture.read (&edgeTime, &phaseUs, 500000) && abs (delta) < 60) {
+      deltaUs = (int32_t)(edgeTime - dcfTime) * 1000000 + (int32_t)phaseUs;
+    }
     timeSinceLastSync = dcfTime - G.lastDcfSyncTime;  // time elapsed since the last successful DCF77 synchronization in seconds
 
     // if no large time deviation has occurred or
-    // if two consecutive DCF77 timestamps produce a similar time deviation
+    // if two consecutive DCF77 timestamps produce a similar time deviation or
+    // if the streaming decoder has accumulated enough votes over several minutes
     // then update the system time
-    if (abs(deltaMs) < 500 || abs (deltaMs - lastDeltaMs) < 500) {
+    if (abs(deltaMs) < 500 || abs (deltaMs - lastDeltaMs) < 500 || fromStream) {
+
+      syncAttemptEnd (true);          // must be called before updating the system time
 
       Timer1.stop ();
       Timer1.restart ();              // reset the beginning of a second
       cli ();
+      G.tickCount = 0;
       set_system_time (dcfTime - 1);  // apply the new system time, subtract 1s to compensate for initial tick
       sei ();
       Timer1.start ();
-      G.dstActive       = (bool)Dcf.dcfTime.cest;  // apply the new daylight saving time status
+      G.dstActive       = dcfCest;    // apply the new daylight saving time status
       G.lastDcfSyncTime = dcfTime;    // remember last sync time
       G.dcfSyncActive   = false;      // pause DCF77 reception
 
+      // refine the watchdog period correction if the time has been kept during deep sleep
+      if (abs (delta) < 60 && G.wdtCycles >= WDT_REFINE_MIN_CYCLES) wdtRefine (deltaMs);
+      G.wdtCycles = 0;
+
       // calibrate timer1 to compensate for crystal drift
       if (abs (delta) < 60 && timeSinceLastSync > 1800 && !G.manuallyAdjusted && !coldStart) {
-        timerCalibrate (timeSinceLastSync, deltaMs);
+        TimeBase.calibrate (timeSinceLastSync, deltaUs);
+#ifdef DEBUG_VALUES
+        Debug.set ( 0, (int32_t)timeSinceLastSync );
+        Debug.set ( 1, deltaUs);
+        Debug.set ( 2, TimeBase.correction);
+#endif
+        PRINT   ("[syncToDcf] correction=");
+        PRINTLN (TimeBase.correction, DEC);
+        PRINT   ("[syncToDcf] timerPeriod=");
+        PRINTLN (Settings.timerPeriod, DEC);
+        PRINT   ("[syncToDcf] dcfSyncInterval=");
+        PRINTLN (TimeBase.syncInterval, DEC);
       }
 
       PRINTLN ("[syncToDcf] updated time");
@@ -918,75 +1587,77 @@ void syncToDcf (void) {
 
 
 /***********************************
- * Calibrate Timer1 frequency in order to compensate for the oscillator drift
- * Periodically back-up the Timer1 period to EEPROM
+ * Finish a DCF77 reception attempt
+ * update the reception statistics and
+ * reschedule the next reception at the best hour
+ * Parameters:
+ *   success : a valid frame has been received
  ***********************************/
-void timerCalibrate (time_t measDuration, int32_t timeOffsetMs) {
-  int32_t drift;
-
-  drift = (timeOffsetMs * 1000 * TIMER1_DIVIDER) / (int32_t)measDuration;
-
-  Settings.timerPeriod += drift;
-  timerCalculate ();
-
-#ifdef DEBUG_VALUES
-  Debug.set ( 0, (int32_t)measDuration );
-  Debug.set ( 1, timeOffsetMs);
-  Debug.set ( 2, drift);
-#endif
-
-  PRINT   ("[timerCalibrate] measDuration=");
-  PRINTLN (measDuration, DEC);
-  PRINT   ("[timerCalibrate] timeOffsetMs=");
-  PRINTLN (timeOffsetMs, DEC);
-  PRINT   ("[timerCalibrate] drift=");
-  PRINTLN (drift, DEC);
-  PRINT   ("[timerCalibrate] timerPeriod=");
-  PRINTLN (Settings.timerPeriod, DEC);
+void syncAttemptEnd (bool success) {
+  uint8_t *rate = &G.dcfHourRate[G.dcfAttemptHour];
+
+  if (success) *rate += (255 - *rate) >> 2;
+  else         *rate -= *rate >> 2;
+
+  G.dcfLastDuration = G.systemTime - G.dcfAttemptStart;
+  G.dcfLastErrors   = G.dcfErrors;
+  G.dcfAttemptStart = 0;
+  G.dcfRetry        = !success;
+  scheduleBuild ();
+
+  PRINT   ("[syncAttemptEnd] hour=");
+  PRINT   (G.dcfAttemptHour, DEC);
+  PRINT   (" rate=");
+  PRINT   (*rate, DEC);
+  PRINT   (" duration=");
+  PRINT   (G.dcfLastDuration, DEC);
+  PRINT   (" errors=");
+  PRINT   (G.dcfLastErrors, DEC);
+  PRINT   (" bestHour=");
+  PRINTLN (G.dcfBestHour, DEC);
 }
 /*********/
 
 
 
 /***********************************
- * Derive the Timer1 and Timer2 parameters
- * out of the Timer1 period
+ * Select the hour of day with the best DCF77 reception success rate
+ * the configured sync hour is preferred on equal rates
  ***********************************/
-void timerCalculate (void) {
-  volatile uint32_t f, fh ,fl, low, high;
-
-  if (Settings.timerPeriod < TIMER_MIN_PERIOD) Settings.timerPeriod = TIMER_MIN_PERIOD;
-  if (Settings.timerPeriod > TIMER_MAX_PERIOD) Settings.timerPeriod = TIMER_MAX_PERIOD;
+uint8_t syncBestHour (void) {
+  uint8_t i, h, best;
 
-  G.timer1Period = Settings.timerPeriod / TIMER1_DIVIDER;
-
-  f                  = Settings.timerPeriod % (G.timer1Step * TIMER1_DIVIDER);
-  fh                 = f / TIMER1_DIVIDER;
-  fl                 = f % TIMER1_DIVIDER;
-  low                = (Settings.timerPeriod - f) / TIMER1_DIVIDER;
-  high               = low + G.timer1Step;
+  best = Settings.dcfSyncHour;
+  for (i = 1; i < 24; i++) {
+    h = (Settings.dcfSyncHour + i) % 24;
+    if (G.dcfHourRate[h] > G.dcfHourRate[best]) best = h;
+  }
+  return best;
+}
+/*********/
 
-  cli ();
-  G.timer1PeriodFH   = fh;
-  G.timer1PeriodFL   = fl;
-  G.timer1PeriodLow  = low;
-  G.timer1PeriodHigh = high;
-  G.timer1UpdateFlag = true;
-  sei ();
 
-  f                  = G.timer1Period % (G.timer2Step * TIMER2_DIVIDER);
-  fh                 = f / TIMER2_DIVIDER;
-  fl                 = f % TIMER2_DIVIDER;
-  low                = (G.timer1Period - f) / TIMER2_DIVIDER;
-  high               = low + G.timer2Step;
 
-  cli ();
-  G.timer2PeriodFH   = fh;
-  G.timer2PeriodFL   = fl;
-  G.timer2PeriodLow  = low;
-  G.timer2PeriodHigh = high;
-  G.timer2UpdateFlag = true;
-  sei ();
+/***********************************
+ * Advance a local time structure by one second
+ * Returns the highest calendar field affected by the carry
+ ***********************************/
+uint8_t calendarIncrement (tm *t) {
+  if (++t->tm_sec < 60) return CALENDAR_CARRY_SEC;
+  t->tm_sec = 0;
+  if (++t->tm_min < 60) return CALENDAR_CARRY_MIN;
+  t->tm_min = 0;
+  if (++t->tm_hour < 24) return CALENDAR_CARRY_HOUR;
+  t->tm_hour = 0;
+  t->tm_yday++;
+  if (++t->tm_wday > 6) t->tm_wday = 0;
+  if (++t->tm_mday <= month_length (t->tm_year, t->tm_mon + 1)) return CALENDAR_CARRY_DAY;
+  t->tm_mday = 1;
+  if (++t->tm_mon < 12) return CALENDAR_CARRY_DAY;
+  t->tm_mon  = 0;
+  t->tm_yday = 0;
+  t->tm_year++;
+  return CALENDAR_CARRY_YEAR;
 }
 /*********/
 
@@ -995,30 +1666,65 @@ void timerCalculate (void) {
 /***********************************
  * Update the Nixie display digits
  ***********************************/
-void updateDigits () {
+void updateDigits (bool incremental) {
   static int8_t lastMin = 0;
+  static time_t lastTime = 0;
+  static int32_t lastOffset = 0;
+  int32_t offset;
   time_t locTime;
+  uint8_t carry = CALENDAR_CARRY_YEAR;
 
   cli();
   G.systemTime = time (NULL);  // get the current time
   sei();
-  locTime   = convertToLocalTime (G.systemTime);
-  G.localTm = localtime (&locTime);
 
-  // check whether current state requires time or date display
+  // the DST flag of the DCF77 time signal takes precedence, until the first successful
+  // sync the EU rule is evaluated upon the precomputed transition or after a time jump
+  if (G.lastDcfSyncTime == 0) {
+    if (Settings.timeZone < CALENDAR_DST_ZONE_MIN || Settings.timeZone > CALENDAR_DST_ZONE_MAX) {
+      G.dstActive      = false;  // the EU rule does not apply outside the European time zones
+      Calendar.dstNext = 0;
+    }
+    else if (G.systemTime >= Calendar.dstNext || G.systemTime - lastTime != 1) {
+      G.dstActive = Calendar.dstUpdate (G.systemTime);
+    }
+  }
+
+  locTime = convertToLocalTime (G.systemTime);
+  offset  = (int32_t)(locTime - G.systemTime);
+
+  // advance the local time by one second unless the time has jumped
+  // (DCF77 sync, manual adjustment, deep sleep) or the time offset has changed (time zone, DST)
+  if (incremental && G.systemTime - lastTime == 1 && offset == lastOffset) {
+    carry = calendarIncrement (G.localTm);
+  }
+  else {
+    localtime_r (&locTime, G.localTm);
+    Alarm.reschedule ();
+  }
+  lastTime   = G.systemTime;
+  lastOffset = offset;
+
+  // only update the digits that have changed
   G.timeDigits[0].value = dec2bcdLow  (G.localTm->tm_sec);
   G.timeDigits[1].value = dec2bcdHigh (G.localTm->tm_sec);
-  G.timeDigits[2].value = dec2bcdLow  (G.localTm->tm_min);
-  G.timeDigits[3].value = dec2bcdHigh (G.localTm->tm_min);
-  G.timeDigits[4].value = dec2bcdLow  (G.localTm->tm_hour);
-  G.timeDigits[5].value = dec2bcdHigh (G.localTm->tm_hour);
-  G.dateDigits[0].value = dec2bcdLow  (G.localTm->tm_year);
-  G.dateDigits[1].value = dec2bcdHigh (G.localTm->tm_year);
-  G.dateDigits[2].value = dec2bcdLow  (G.localTm->tm_mon + 1);
-  G.dateDigits[3].value = dec2bcdHigh (G.localTm->tm_mon + 1);
-  G.dateDigits[4].value = dec2bcdLow  (G.localTm->tm_mday);
-  G.dateDigits[5].value = dec2bcdHigh (G.localTm->tm_mday);
-
+  if (carry >= CALENDAR_CARRY_MIN) {
+    G.timeDigits[2].value = dec2bcdLow  (G.localTm->tm_min);
+    G.timeDigits[3].value = dec2bcdHigh (G.localTm->tm_min);
+  }
+  if (carry >= CALENDAR_CARRY_HOUR) {
+    G.timeDigits[4].value = dec2bcdLow  (G.localTm->tm_hour);
+    G.timeDigits[5].value = dec2bcdHigh (G.localTm->tm_hour);
+  }
+  if (carry >= CALENDAR_CARRY_DAY) {
+    Calendar.update (G.localTm, Settings.weekStartDay);
+    G.dateDigits[0].value = dec2bcdLow  (G.localTm->tm_year);
+    G.dateDigits[1].value = dec2bcdHigh (G.localTm->tm_year);
+    G.dateDigits[2].value = dec2bcdLow  (G.localTm->tm_mon + 1);
+    G.dateDigits[3].value = dec2bcdHigh (G.localTm->tm_mon + 1);
+    G.dateDigits[4].value = dec2bcdLow  (G.localTm->tm_mday);
+    G.dateDigits[5].value = dec2bcdHigh (G.localTm->tm_mday);
+  }
 
   if (G.menuState == SHOW_TIME) {
     // trigger Nixie digit "Slot Machine" effect
@@ -1041,55 +1747,57 @@ void updateDigits () {
  * Read ADC channels
  ***********************************/
 void adcRead (void) {
-  static uint8_t chanIdx = 0;
-  static uint32_t lightsensTs = 0;
-  static int32_t avgVal[NUM_APINS] = { 1023, 1023, 1023 };
-  uint32_t ts;
+  static int16_t avgVal[NUM_APINS] = { 1023, 1023, 1023, 1023, 1023 };
   int16_t adcVal;
-  uint8_t val;
-
-  // start ADC for the current button (will be ignored if already started)
-  Adc.start (G.analogPin[chanIdx]);
-
-  // check if ADC finished detecting the value
-  adcVal = Adc.readVal ();
-
-  // ADC finished
-  if (adcVal >= 0) {
-
-    ts = millis ();
+  uint8_t i, val;
+  bool sampled;
 
-    // process light sensor value
-    if (G.analogPin[chanIdx] == LIGHTSENS_APIN) {
-     // reduce light sensor sampling frequency
-     // disable auto-brightness when a button is pressed to avoid ADC channel cross-talk
-     // disable auto-brightness during cathode poisoning prevention
-     if (ts - lightsensTs > 150 && !Button[0].pressed && !Button[1].pressed && !Button[2].pressed && !Nixie.cppEnabled) {
-        avgVal[chanIdx] = (avgVal[chanIdx] * 31 + (int32_t)adcVal) >> 5;  // IIR low-pass filtering for smooth transitions
-        val = Brightness.lightSensorUpdate ((int16_t)avgVal[chanIdx]);
-        Nixie.setBrightness (val);
-        lightsensTs = ts;
-      }
+  // check external power voltage, the low flag is latched by the ADC ISR
+  if (Analog.low (EXTPWR_CHAN)) {
+    powerSave ();  // enable power save mode if external power is lost
+    return;
+  }
+  while (Analog.read (EXTPWR_CHAN) >= 0);
+
+  // process button values
+  for (i = 0; i < 3; i++) {
+    sampled = false;
+    while ((adcVal = Analog.read (i)) >= 0) {
+      avgVal[i] = (avgVal[i] * 7 + adcVal) >> 3;  // IIR low-pass filtering for button debouncing
+      sampled = true;
     }
-    // check external power voltage
-    else if (G.analogPin[chanIdx] == EXTPWR_APIN) {
-      if (adcVal < 512) powerSave();  // enable power save mode if external power is lost
+    if (avgVal[i] < 400) {
+      if (Button[i].pressed == false) {
+        Nixie.resetBlinking();                  // synchronize digit blinking with the rising edge of a button press
+#ifdef BUTTON_CLICK
+        Buzzer.play (BUZZER_CLICK);
+#endif
+      }
+      // wake-up the settings menu upon pressing and with every new sample while the button is held
+      // (long press detection and value scrolling)
+      if (Button[i].pressed == false || sampled) Scheduler.signal (SCHEDULER_INPUT);
+      Button[i].press ();
     }
-    // process button values
     else {
-      avgVal[chanIdx] = (avgVal[chanIdx] * 31 + (int32_t)adcVal) >> 5;  // IIR low-pass filtering for button debouncing
-      if (avgVal[chanIdx] < 400) {
-        if (Button[chanIdx].pressed == false) Nixie.resetBlinking();    // synchronize digit blinking with the rising edge of a button press
-        Button[chanIdx].press ();
-      }
-      else {
-        Button[chanIdx].release ();
-      }
+      if (Button[i].pressed == true) Scheduler.signal (SCHEDULER_INPUT);
+      Button[i].release ();
     }
-    chanIdx++;
-    if (chanIdx >= NUM_APINS) chanIdx = 0;
   }
 
+  // process light sensor value
+  while ((adcVal = Analog.read (LIGHTSENS_CHAN)) >= 0) {
+    // disable auto-brightness when a button is pressed to avoid ADC channel cross-talk
+    // disable auto-brightness during cathode poisoning prevention
+    if (!Button[0].pressed && !Button[1].pressed && !Button[2].pressed && !Nixie.cppEnabled) {
+      avgVal[LIGHTSENS_CHAN] = ((int32_t)avgVal[LIGHTSENS_CHAN] * 31 + adcVal) >> 5;  // IIR low-pass filtering for smooth transitions
+      val = Brightness.lightSensorUpdate (avgVal[LIGHTSENS_CHAN]);
+      Nixie.setBrightness (val, Brightness.fraction);
+#ifdef SERIAL_TELEMETRY
+      G.lightSensor     = avgVal[LIGHTSENS_CHAN];
+      G.brightnessLevel = val;
+#endif
+    }
+  }
 }
 /*********/
 
@@ -1103,14 +1811,16 @@ void powerSave (void) {
   // threshold power supply voltage for going into deep sleep [0..1023] 1023 ~= 4.5V
   const int16_t voltageThreshold = 800;  // 800 ~= 3.5V
   int16_t voltage = 0;
+  bool displayEnabled = Nixie.enabled;
   uint8_t i;
 
-  // write-back system settings to EEPROM
-  eepromWriteSettings ();
+  // save the volatile settings before the supply runs down
+  checkpointWrite ();
 
+  Analog.stop ();                   // stop the ADC scheduler before using analogRead()
   analogReference (INTERNAL);       // set ADC reference to internal 1.1V source (required for measuring power supply voltage)
   for (i = 0; i < 100 && voltage < voltageThreshold; i++) voltage = analogRead (VOLTAGE_APIN); // stabilize voltage reading
-  Nixie.blank ();                   // turns-off all digital outputs
+  Nixie.enable (false);             // turns-off all digital outputs and stops the display multiplexing
   Brightness.boostDeactivate ();    // make sure that BRIGHTNESS_PIN is LOW
   wdt_disable ();                   // disable watchdog timer
   power_all_disable ();             // turn off peripherals
@@ -1130,16 +1840,29 @@ void powerSave (void) {
     if (mode == LIGHT_SLEEP) {
 
       // enter sleep, wakeup will be triggered by the
-      // next Timer 1 interrupt (second tick)
+      // next Timer 1 interrupt (10 ms tick)
       sleep_enable ();
       sleep_cpu ();
       sleep_disable ();
 
+      // only check the supply voltage upon second ticks
+      if (G.tickCount != 0) continue;
+
       // read the super-capacitor voltage
       voltage = analogRead (VOLTAGE_APIN);
 
       // if below a certain voltage threshold, then switch to deep sleep
       if (voltage < voltageThreshold) {
+#ifdef WDT_CALIBRATE
+        time_t t;
+        G.wdtPeriod = wdtCalibrate () + Settings.wdtCorrection;
+        // switch to deep sleep at the beginning of a second
+        t = time (NULL);
+        while (time (NULL) == t) sleep_mode ();
+#else
+        G.wdtPeriod = WDT_NOMINAL_PERIOD + Settings.wdtCorrection;
+#endif
+        G.wdtAccu = 0;
         power_timer1_disable ();
         ADCSRA &= ~_BV(ADEN);  // Disable ADC, see ATmega328P datasheet Section 28.9.2
         power_adc_disable ();
@@ -1155,7 +1878,7 @@ void powerSave (void) {
     }
     // Deep Sleep:
     // - turn off all of the remaining peripherals
-    // - inaccurate time-keeping using the Watchdog interrupt
+    // - time-keeping using the Watchdog interrupt, calibrated against Timer1 if WDT_CALIBRATE is defined
     // - measured current consumption approx. 180uA
     else { // mode == DEEP_SLEEP
 
@@ -1173,8 +1896,20 @@ void powerSave (void) {
   } // while (digitalRead (DCF_PIN) == LOW)
 
   power_all_enable();       // turn on peripherals
-  ADCSRA |= _BV(ADEN);      // Enable ADC, see ATmega328P datasheet Section 28.9.2
+#ifdef SERIAL_TELEMETRY
+  Telemetry.initialize (TELEMETRY_BAUD);  // the USART must be re-initialized after having been powered down
+#endif
+  Analog.start ();          // re-enable the ADC and restart the scheduler with the AVcc reference
   wdt_enable (WDT_TIMEOUT); // enable watchdog timer
+  Nixie.enable (displayEnabled);
+
+  // the supply has been restored, write-back the settings and re-arm the checkpoint slot
+  eepromWriteSettings ();
+  EepromQueue.erase (EEPROM_CHECKPOINT_ADDR, sizeof (Checkpoint_t));
+
+#ifdef PROFILE_VALUES
+  Profile.reset ();         // discard the measurements distorted by the power save mode
+#endif
 
 #ifdef SERIAL_DEBUG
   delay (500);
@@ -1216,41 +1951,45 @@ void reorderMenu (int8_t menuIdx) {
 
 
 /***********************************
- * Code snippet for setting time/date value
- * called repeatedly from within settingsMenu()
+ * Apply the local time and date adjusted within G.localTm
+ * by the settings menu
  ***********************************/
-#define SET_TIME_DATE( EXPR ) { \
-  cli (); \
-  t = G.localTm; \
-  EXPR; \
-  valU8 = month_length (t->tm_year, t->tm_mon + 1); \
-  if (t->tm_mday > valU8 ) t->tm_mday = valU8; \
-  sysTime = mktime (t); \
-  sysTime = convertToUtcTime (sysTime); \
-  set_system_time (sysTime); \
-  sei (); \
-  updateDigits (); \
-  G.manuallyAdjusted = true; \
+void setTimeDate (void) {
+  tm *t = G.localTm;
+  uint8_t len = month_length (t->tm_year, t->tm_mon + 1);
+  time_t sysTime;
+
+  if (t->tm_mday > len) t->tm_mday = len;
+  sysTime = mktime (t);
+  sysTime = convertToUtcTime (sysTime);
+  cli ();
+  set_system_time (sysTime);
+  sei ();
+  updateDigits ();
+  G.manuallyAdjusted = true;
+  G.wdtCycles = 0;
 }
 /*********/
 
 
 
 /***********************************
- * Calculate the week day
+ * Get the week day
+ * precomputed once per day by updateDigits()
  ***********************************/
 uint8_t weekDay (void) {
-  return (G.localTm->tm_wday == 0 ? 7 : G.localTm->tm_wday);
+  return Calendar.weekDay;
 }
 /*********/
 
 
 
 /***********************************
- * Calculate the current calendar week
+ * Get the current calendar week
+ * precomputed once per day by updateDigits()
  ***********************************/
 int8_t calendarWeek (void) {
-  return (int8_t)week_of_year (G.localTm, (Settings.weekStartDay == 7 ? 0 : Settings.weekStartDay)) + Settings.calWeekAdjust + 1;
+  return Calendar.week + Settings.calWeekAdjust;
 }
 /*********/
 
@@ -1275,72 +2014,687 @@ uint8_t calendarWeekValidate (void) {
 
 
 
-#define SCROLL_LUT_SIZE   18    // digit scrolling lookup table size
-#define SCROLL_INTERVAL   1000  // digit scrolling interval
-#define VALUE_DIGITS_SIZE 14    // size of the general purpose digit buffer
+#define SCROLL_LUT_SIZE       18                    // digit scrolling lookup table size
+#define SCROLL_INTERVAL       1000                  // digit scrolling interval
+#define VALUE_DIGITS_SIZE     14                    // size of the general purpose digit buffer
+#define MENU_TIMEOUT_DEFAULT  ((uint32_t)60*1000)   // return to the time display after this many ms without button activity
+#define MENU_TIMEOUT_EXTENDED ((uint32_t)60*60000)  // menu timeout of the countdown timer and stopwatch displays
+#define MENU_TIMEOUT_FEATURE  ((uint32_t)5*1000)    // pressing button 0 returns to the time display after this many ms (MENU_FEATURE)
+
+// menu state flags
+#define MENU_BROWSE  _BV(0)     // buttons 1 and 2 browse the display states, snooze the alarm or adjust the brightness
+#define MENU_ACCEL   _BV(1)     // buttons 1 and 2 adjust values using the progressive scrolling acceleration
+#define MENU_NEXT    _BV(2)     // short-pressing button 0 switches to nextState
+#define MENU_RETURN  _BV(3)     // long-pressing button 0 switches to returnState
+#define MENU_TIMEOUT _BV(4)     // return to the time display upon menu timeout
+#define MENU_FEATURE _BV(5)     // pressing button 0 returns to the time display after a short timeout
+#define MENU_SETTING _BV(6)     // setting mode, blink once when leaving with button 0 long press
+
+/*
+ * Value adjustment period in ms as a function of the button hold time in seconds
+ */
+const uint8_t ScrollLut[SCROLL_LUT_SIZE] PROGMEM =
+    { 250, 160, 155, 150, 145, 140, 135, 130, 120, 110, 100, 90, 80, 70, 60, 50, 40, 30 };
+
+/*
+ * Menu state handler
+ */
+typedef void (*MenuHandler_t)(void);
+
+/*
+ * Menu state descriptor
+ */
+struct MenuState_s {
+  uint8_t flags;         // MENU_* flags of the state
+  uint8_t up;            // state selected by button 1 (MENU_BROWSE)
+  uint8_t down;          // state selected by button 2 (MENU_BROWSE)
+  uint8_t next;          // nextState assigned upon entering the state
+  uint8_t ret;           // returnState assigned upon entering the state
+  MenuHandler_t enter;   // called upon entering the state
+  MenuHandler_t exit;    // called upon leaving the state
+  MenuHandler_t render;  // called upon every menu event while the state is active: state specific buttons and display
+};
+
+/*
+ * Menu navigation context shared by the state handlers
+ */
+struct Menu_t {
+  MenuState_e nextState   = SHOW_DATE;             // state selected by short-pressing button 0
+  MenuState_e returnState = SHOW_TIME;             // state selected by long-pressing button 0
+  int8_t   menuIdx          = 0;                   // current position within the dynamic menu ordering list
+  uint8_t  scrollIdx        = 0;                   // current position within ScrollLut
+  uint32_t ts               = 0;                   // millis() of the current menu execution
+  uint32_t timeoutTs        = 0;                   // millis() of the last button activity
+  uint32_t scrollTs         = 0;                   // millis() of the last value adjustment
+  uint32_t brightnessTs     = 0;                   // millis() of the last brightness adjustment
+  uint32_t accelTs          = 0;                   // millis() of the last scrolling acceleration step
+  uint32_t bannerTs         = 0;                   // millis() of the last service display scroll
+  uint32_t scrollDelay      = 250;                 // current value adjustment period in ms
+  uint32_t menuTimeout      = MENU_TIMEOUT_DEFAULT; // current menu timeout in ms
+  NixieDigit_s valueDigits[VALUE_DIGITS_SIZE];     // general purpose digit buffer
+  int8_t   sIdx             = 0;                   // index of the selected setting value
+  int8_t   vIdx             = 0;                   // index of the displayed service value
+  bool     brightnessEnable = false;               // buttons 1 and 2 may adjust the brightness
+} Menu;
+
+
+
+/***********************************
+ * Menu state handlers
+ * G.menuState is set to the new state before calling the enter handler
+ ***********************************/
+
+// wrap a value around the boundaries of the range minVal..maxVal
+static int8_t menuWrap (int8_t val, int8_t minVal, int8_t maxVal) {
+  return val > maxVal ? minVal : (val < minVal ? maxVal : val);
+}
+
+// advance within the dynamic menu ordering list
+static void menuAdvance (void) {
+  Menu.menuIdx++;
+  if (Menu.menuIdx >= MENU_ORDER_LIST_SIZE) Menu.menuIdx = 0;
+  Menu.nextState = G.menuOrder[Menu.menuIdx];
+}
+
+// a feature has been used: return to the time display upon pressing button 0
+// and show the feature first once the menu is accessed
+static void menuFeatureUsed (void) {
+  Menu.nextState = SHOW_TIME;
+  reorderMenu (Menu.menuIdx);
+}
+
+// show the calendar week and the week day
+static void menuWeekShow (uint8_t week) {
+  Menu.valueDigits[0].value = dec2bcdLow (week);
+  Menu.valueDigits[1].value = dec2bcdHigh (week);
+  Menu.valueDigits[2].blank = true;
+  Menu.valueDigits[3].blank = true;
+  Menu.valueDigits[4].value = weekDay ();
+  Menu.valueDigits[5].blank = true;
+}
+
+// show the ID and the value of the selected setting
+static void menuSettingShow (void) {
+  int8_t val = *SETTINGS_FIELD (Menu.sIdx, value);
+  Menu.valueDigits[5].value = SETTINGS_FIELD (Menu.sIdx, idDigit1);
+  Menu.valueDigits[4].value = SETTINGS_FIELD (Menu.sIdx, idDigit0);
+  Menu.valueDigits[2].comma = (val < 0);
+  Menu.valueDigits[1].value = dec2bcdHigh ((uint8_t)abs (val));
+  Menu.valueDigits[0].value = dec2bcdLow ((uint8_t)abs (val));
+}
+
+// show the selected service value
+static void menuServiceShow (void) {
+  NixieDigit_s *v = Menu.valueDigits;
+  time_t locTime;
+
+  // show Timer1 period (default)
+  if (Menu.vIdx == 0) {
+    Nixie.setDigits (v, 11);
+    Nixie.formatId (v, 11, 1);
+    Nixie.dec2bcd (TimeBase.timerPeriodUs, &v[2], VALUE_DIGITS_SIZE - 2, 7);
+    Nixie.dec2bcd (TimeBase.timerPeriodFract, v, VALUE_DIGITS_SIZE, 2);
+    v[2].comma = true;
+  }
+  // show Nixie tube uptime
+  else if (Menu.vIdx == 1) {
+    Nixie.setDigits (v, 8);
+    cli ();
+    Nixie.dec2bcd (Settings.nixieUptime / ONE_HOUR, v, VALUE_DIGITS_SIZE, 6);
+    sei ();
+    Nixie.formatId (v, 8, 2);
+  }
+  // Show the last DCF sync date or time
+  else if (Menu.vIdx == 2 || Menu.vIdx == 3) {
+    if (G.lastDcfSyncTime != 0) {
+      locTime = convertToLocalTime (G.lastDcfSyncTime);
+      localtime_r (&locTime, &G.lastDcfSyncTm);
+    }
+    Nixie.setDigits (v, 8);
+    Nixie.formatId (v, 8, Menu.vIdx + 1);
+    if (Menu.vIdx == 2) Nixie.formatDate (v, G.lastDcfSyncTm.tm_mday, G.lastDcfSyncTm.tm_mon + (G.lastDcfSyncTm.tm_mday == 0 ? 0 : 1), G.lastDcfSyncTm.tm_year);
+    else                Nixie.formatTime (v, G.lastDcfSyncTm.tm_hour, G.lastDcfSyncTm.tm_min, G.lastDcfSyncTm.tm_sec);
+  }
+  // show firmware version
+  else if (Menu.vIdx == 4) {
+    Nixie.setDigits (v, 8);
+    Nixie.formatId (v, 8, 5);
+    Nixie.formatDate (v, VERSION_MAJOR, VERSION_MINOR, VERSION_MAINT);  // same format as the date
+  }
+  // show the DCF sync hour and its reception success rate in %
+  else if (Menu.vIdx == 5) {
+    Nixie.setDigits (v, 8);
+    Nixie.formatId (v, 8, 6);
+    Nixie.dec2bcd (G.dcfBestHour, &v[4], VALUE_DIGITS_SIZE - 4, 2);
+    Nixie.dec2bcd ((uint16_t)G.dcfHourRate[G.dcfBestHour] * 100 / 255, v, VALUE_DIGITS_SIZE, 4, true);
+    v[4].comma = true;
+  }
+  // show the duration in minutes and the number of frame errors of the last DCF reception attempt
+  else if (Menu.vIdx == 6) {
+    Nixie.setDigits (v, 8);
+    Nixie.formatId (v, 8, 7);
+    Nixie.dec2bcd (G.dcfLastDuration / 60, &v[3], VALUE_DIGITS_SIZE - 3, 3, true);
+    Nixie.dec2bcd (G.dcfLastErrors > 999 ? 999 : G.dcfLastErrors, v, VALUE_DIGITS_SIZE, 3, true);
+    v[3].comma = true;
+  }
+#ifdef PROFILE_VALUES
+  // show the profiling values
+  else if (Menu.vIdx >= NUM_SYSTEM_VALUES && Menu.vIdx < NUM_SYSTEM_VALUES + NUM_PROFILE_VALUES) {
+    uint8_t idx = Menu.vIdx - NUM_SYSTEM_VALUES;
+    Profile.display ();
+    Nixie.setDigits (v, NUM_PROFILE_DIGITS + 2);
+    Nixie.formatId (v, NUM_PROFILE_DIGITS + 2, idx);
+    Nixie.dec2bcd (Profile.values[idx], v, VALUE_DIGITS_SIZE, NUM_PROFILE_DIGITS, true);
+  }
+#endif
+#ifdef DEBUG_VALUES
+  // show the Debug values
+  else if (Menu.vIdx >= (NUM_SERVICE_VALUES - NUM_DEBUG_VALUES) && Menu.vIdx < NUM_SERVICE_VALUES) {
+    uint8_t idx = Menu.vIdx - (NUM_SERVICE_VALUES - NUM_DEBUG_VALUES);
+    Nixie.setDigits (v, NUM_DEBUG_DIGITS + 2);
+    v[NUM_DEBUG_DIGITS + 1].value = idx;
+    v[NUM_DEBUG_DIGITS].comma     = true;
+    v[NUM_DEBUG_DIGITS].blank     = true;
+    if (idx < NUM_DEBUG_VALUES)  {
+      Nixie.formatSigned (Debug.values[idx], v, VALUE_DIGITS_SIZE, NUM_DEBUG_DIGITS);
+    }
+    else {
+      Nixie.dec2bcd (0, v, VALUE_DIGITS_SIZE, NUM_DEBUG_DIGITS);
+    }
+  }
+#endif
+  Nixie.scroll ();
+}
+
+
+void menuTimeEnter (void) {
+  Nixie.enable (true);
+  Nixie.cancelScroll ();
+  Nixie.setDigits (G.timeDigits, NIXIE_NUM_TUBES);
+  Menu.menuIdx   = 0;
+  Menu.nextState = G.menuOrder[Menu.menuIdx];  // use dynamic menu ordering
+}
+
+
+void menuDateEnter (void) {
+  Nixie.setDigits (G.dateDigits, NIXIE_NUM_TUBES);
+  G.dateDigits[4].comma = true;
+  G.dateDigits[2].comma = true;
+}
+
+
+void menuWeekEnter (void) {
+  Nixie.resetDigits (Menu.valueDigits, VALUE_DIGITS_SIZE);
+  Nixie.setDigits (Menu.valueDigits, NIXIE_NUM_TUBES);
+  menuWeekShow ((uint8_t)(calendarWeek () > 0 ? calendarWeek () : 0));
+}
+
+
+void menuAlarmEnter (void) {
+  Nixie.setDigits (Alarm.digits, NIXIE_NUM_TUBES);
+  Alarm.selectUpcoming ();
+}
+
+
+void menuTimerEnter (void) {
+  Nixie.enable (true);
+  Nixie.setDigits (CdTimer.digits, NIXIE_NUM_TUBES);
+  CdTimer.select ();
+  menuAdvance ();
+  Menu.menuTimeout = MENU_TIMEOUT_EXTENDED;
+}
+
+
+void menuTimerRender (void) {
+  // reset the menu timeout as long as timer is running
+  if (CdTimer.running && Menu.ts - Menu.timeoutTs > Menu.menuTimeout - 1000) Menu.timeoutTs = Menu.ts;
+
+  // button 0 - long press --> start/stop/reset the displayed countdown timer
+  if (Button[0].longPress ()) {
+    Nixie.blinkOnce ();
+    CdTimer.toggle ();
+    menuFeatureUsed ();
+  }
+  // button 1 or 2 - falling edge --> reset timer alarm
+  else if (Button[1].falling () || Button[2].falling ()) {
+    CdTimer.resetAlarm ();
+    menuFeatureUsed ();
+  }
+  // button 1 or 2 - pressed --> increase/decrease minutes / arm countdown timer
+  else if (Button[1].pressed || Button[2].pressed) {
+    if (Menu.ts - Menu.scrollTs >= Menu.scrollDelay) {
+      if (!CdTimer.alarm) {
+        if (Button[1].pressed) CdTimer.minuteIncrease ();
+        else                   CdTimer.minuteDecrease ();
+      }
+      Menu.scrollTs = Menu.ts;
+      menuFeatureUsed ();
+    }
+  }
+}
+
+
+void menuStopwatchEnter (void) {
+  Nixie.setDigits (Stopwatch.digits, NIXIE_NUM_TUBES);
+  if (!Stopwatch.active) Stopwatch.reset ();
+  menuAdvance ();
+  Menu.menuTimeout = MENU_TIMEOUT_EXTENDED;
+}
+
+
+void menuStopwatchRender (void) {
+  // reset the menu timeout as long as stopwatch is running
+  if (Stopwatch.running && Menu.ts - Menu.timeoutTs > Menu.menuTimeout - 1000) Menu.timeoutTs = Menu.ts;
+
+  // button 0 - long press --> reset the stopwatch
+  if (Button[0].longPress ()) {
+    Stopwatch.reset ();
+    Nixie.blinkOnce ();
+    menuFeatureUsed ();
+  }
+  // button 1 rising edge --> start/stop stopwatch
+  else if (Button[1].rising ()) {
+    Menu.timeoutTs = Menu.ts;  // reset the menu timeout
+    if (Stopwatch.running) Stopwatch.stop ();
+    else                   Stopwatch.start ();
+    menuFeatureUsed ();
+  }
+  // button 2 rising edge --> running: toggle pause stopwatch and record a lap
+  //                             stopped: browse the laps
+  //                             reset:   toggle the 1/10 s and 1/100 s resolution
+  else if (Button[2].rising ()) {
+    Menu.timeoutTs = Menu.ts;  // reset the menu timeout
+    if (Stopwatch.running) {
+      if (Stopwatch.paused) Stopwatch.pause (false);
+      else                  Stopwatch.pause (true);
+    }
+    else if (Stopwatch.active) {
+      Stopwatch.nextLap ();
+    }
+    else {
+      Stopwatch.toggleResolution ();
+    }
+    menuFeatureUsed ();
+  }
+}
+
+
+void menuServiceEnter (void) {
+  Nixie.resetDigits (Menu.valueDigits, VALUE_DIGITS_SIZE);
+  Menu.bannerTs = Menu.ts;
+  Menu.vIdx     = 0;
+  menuServiceShow ();
+}
+
+
+void menuServiceRender (void) {
+  // button 1 or 2 rising edge --> cycle back and forth between system parameters
+  if (Button[1].rising () || Button[2].rising ()) {
+    Menu.timeoutTs = Menu.ts;  // reset the menu timeout
+    Menu.bannerTs  = Menu.ts;  // reset display scroll period
+    Nixie.cancelScroll ();
+    Nixie.resetDigits (Menu.valueDigits, VALUE_DIGITS_SIZE);
+    if (Button[1].pressed) {
+      Menu.vIdx++; if (Menu.vIdx >= NUM_SERVICE_VALUES) Menu.vIdx = 0;
+    }
+    else if (Button[2].pressed) {
+      Menu.vIdx--; if (Menu.vIdx < 0) Menu.vIdx = NUM_SERVICE_VALUES - 1;
+    }
+    menuServiceShow ();
+  }
+  // scroll the display every x seconds
+  if (Menu.ts - Menu.bannerTs > 6000) Nixie.scroll (), Menu.bannerTs = Menu.ts;
+}
+
+
+void menuServiceExit (void) {
+  Nixie.cancelScroll ();
+}
+
+
+void menuBlankEnter (void) {
+  Nixie.enable (false);
+}
+
+
+void menuBlankRender (void) {
+  // button 0, 1 or 2 - rising edge --> catch rising edge
+  Button[0].rising ();
+  Button[1].rising ();
+  Button[2].rising ();
+  // button 0, 1 or 2 - falling edge --> re-activate display
+  if (Button[0].falling () || Button[1].falling () || Button[2].falling ()) {
+    menuSwitch (SHOW_TIME);
+  }
+}
+
+
+void menuBlankExit (void) {
+  Nixie.enable (true);
+}
+
+
+void menuSetAlarmEnter (void) {
+  Nixie.setDigits (Alarm.digits, NIXIE_NUM_TUBES);
+  Alarm.displayRefresh ();
+  Menu.sIdx = 0;
+  Nixie.setBlink (_BV(1));
+}
+
+
+void menuSetAlarmRender (void) {
+  // button 0 - falling edge --> select next setting value: alarm, hour, minute, days
+  if (Button[0].falling ()) {
+    Menu.sIdx++; if (Menu.sIdx > 3) Menu.sIdx = 0;
+    if      (Menu.sIdx == 0) Nixie.setBlink (_BV(1));
+    else if (Menu.sIdx == 1) Nixie.setBlink (_BV(5) | _BV(4));
+    else if (Menu.sIdx == 2) Nixie.setBlink (_BV(3) | _BV(2));
+    else                     Nixie.setBlink (_BV(0));
+  }
+  // button 1 or 2 - pressed --> increase/decrease value
+  else if (Button[1].pressed || Button[2].pressed) {
+    Nixie.resetBlinking ();
+    if (Menu.ts - Menu.scrollTs >= Menu.scrollDelay) {
+      if (Menu.sIdx == 0) {
+        if (Button[1].pressed) Alarm.selectNext ();
+        else                   Alarm.selectPrevious ();
+      }
+      else if (Menu.sIdx == 1) {
+        if (Button[1].pressed) Alarm.hourIncrease ();
+        else                   Alarm.hourDecrease ();
+      }
+      else if (Menu.sIdx == 2) {
+        if (Button[1].pressed) Alarm.minuteIncrease ();
+        else                   Alarm.minuteDecrease ();
+      }
+      else {
+        if (Button[1].pressed) Alarm.modeIncrease ();
+        else                   Alarm.modeDecrease ();
+      }
+      Menu.scrollTs = Menu.ts;
+    }
+  }
+}
+
+
+void menuSettingsEnter (void) {
+  Nixie.setDigits (Menu.valueDigits, NIXIE_NUM_TUBES);
+  Nixie.setBlink (_BV(1) | _BV(0));
+  Menu.valueDigits[2].blank = true;
+  Menu.valueDigits[3].blank = true;
+  Menu.valueDigits[5].comma = true;
+  Menu.sIdx = 0;
+  menuSettingShow ();
+}
+
+
+void menuSettingsRender (void) {
+  int16_t val16;
+
+  // button 0 - falling edge --> select next setting value
+  if (Button[0].falling ()) {
+    Menu.sIdx++;
+    if (Menu.sIdx >= SETTINGS_LUT_SIZE) Menu.sIdx = 0;
+
+    // reset the clock drift correction value, it is used for display purposes only
+    if (SETTINGS_FIELD (Menu.sIdx, value) == (int8_t *)&Settings.clockDriftCorrect) {
+      Settings.clockDriftCorrect = 0;
+    }
+    menuSettingShow ();
+  }
+  // button 1 or 2 pressed --> increase/decrease value
+  else if (Button[1].pressed || Button[2].pressed) {
+    Nixie.resetBlinking ();
+    if (Menu.ts - Menu.scrollTs >= Menu.scrollDelay) {
+      val16 = (int16_t)*SETTINGS_FIELD (Menu.sIdx, value);
+      if (Button[1].pressed) {
+        val16++;
+        if (val16 > SETTINGS_FIELD (Menu.sIdx, maxVal)) val16 = SETTINGS_FIELD (Menu.sIdx, minVal);
+      }
+      else {
+        val16--;
+        if (val16 < SETTINGS_FIELD (Menu.sIdx, minVal)) val16 = SETTINGS_FIELD (Menu.sIdx, maxVal);
+      }
+      *SETTINGS_FIELD (Menu.sIdx, value) = (int8_t)val16;
+      settingsApply (Menu.sIdx, Button[1].pressed ? 1 : -1);
+      menuSettingShow ();
+      Nixie.refresh ();
+      Menu.scrollTs = Menu.ts;
+    }
+  }
+}
+
+
+void menuSetTimeEnter (void) {
+  // blink the hours, minutes or seconds
+  Nixie.setDigits (G.timeDigits, NIXIE_NUM_TUBES);
+  Nixie.setBlink ((_BV(5) | _BV(4)) >> 2 * (G.menuState - SET_HOUR));
+}
+
+
+void menuSetDateEnter (void) {
+  // blink the day, month or year
+  Nixie.setDigits (G.dateDigits, NIXIE_NUM_TUBES);
+  Nixie.setBlink ((_BV(5) | _BV(4)) >> 2 * (G.menuState - SET_DAY));
+  G.dateDigits[2].comma = true;
+  G.dateDigits[4].comma = true;
+}
+
+
+void menuSetTimeDateRender (void) {
+  tm *t = G.localTm;
+  int8_t delta;
+
+  // button 1 or 2 - pressed --> increase/decrease the selected time or date value
+  if      (Button[1].pressed) delta = 1;
+  else if (Button[2].pressed) delta = -1;
+  else return;
+
+  Nixie.resetBlinking ();
+  if (Menu.ts - Menu.scrollTs < Menu.scrollDelay) return;
+  Menu.scrollTs = Menu.ts;
+
+  if      (G.menuState == SET_HOUR)  t->tm_hour = menuWrap (t->tm_hour + delta, 0, 23);
+  else if (G.menuState == SET_MIN)   t->tm_min  = menuWrap (t->tm_min  + delta, 0, 59);
+  else if (G.menuState == SET_DAY)   t->tm_mday = menuWrap (t->tm_mday + delta, 1, month_length (t->tm_year, t->tm_mon + 1));
+  else if (G.menuState == SET_MONTH) t->tm_mon  = menuWrap (t->tm_mon  + delta, 0, 11);
+  else                               t->tm_year = constrain (t->tm_year + delta, 101, 230);
+  setTimeDate ();
+}
+
+
+void menuSetSecRender (void) {
+  tm *t;
+  int8_t sec;
+  time_t sysTime;
+
+  // button 1 - rising edge --> stop Timer1 then reset seconds to 0
+  if (Button[1].rising ()) {
+    Menu.timeoutTs = Menu.ts;  // reset the menu timeout
+    Nixie.setBlink (0);
+    cli ();
+    Timer1.stop ();
+    Timer1.restart ();
+    G.tickCount = 0;
+    sei ();
+    // Timer1 is stopped, the system time cannot advance while the new time is computed
+    t   = G.localTm;
+    sec = t->tm_sec;
+    t->tm_sec = 0;
+    sysTime = mktime (t);
+    if (sec >= 30) {
+      sysTime += 60;
+    }
+    sysTime = convertToUtcTime (sysTime);
+    cli ();
+    set_system_time (sysTime);
+    sei ();
+    updateDigits ();
+    G.manuallyAdjusted = true;
+    G.wdtCycles = 0;  // the time deviation does not reflect the deep sleep accuracy anymore
+  }
+  // button 1 - falling edge --> start Timer1
+  else if (Button[1].falling ()) {
+    Nixie.setBlink (_BV(1) | _BV(0));
+    Nixie.resetBlinking ();
+    sysTime = time (NULL);
+    set_system_time (sysTime - 1);
+    Timer1.start ();
+  }
+}
+
+
+void menuSetWeekEnter (void) {
+  Nixie.resetDigits (Menu.valueDigits, VALUE_DIGITS_SIZE);
+  Nixie.setDigits (Menu.valueDigits, NIXIE_NUM_TUBES);
+  Nixie.setBlink (_BV(1) | _BV(0));
+  menuWeekShow (calendarWeekValidate ());
+}
+
+
+void menuSetWeekRender (void) {
+  // button 1 or 2 - pressed --> increase/decrease calendar week
+  if (Button[1].pressed || Button[2].pressed) {
+    Nixie.resetBlinking ();
+    if (Menu.ts - Menu.scrollTs >= Menu.scrollDelay) {
+      if (Button[1].pressed) Settings.calWeekAdjust++;
+      else                   Settings.calWeekAdjust--;
+      menuWeekShow (calendarWeekValidate ());
+      Menu.scrollTs = Menu.ts;
+    }
+  }
+}
+/*********/
+
+
+
+/*
+ * Menu state descriptors indexed by MenuState_e
+ */
+#define MENU_T MENU_TIMEOUT
+#define MENU_S (MENU_NEXT | MENU_RETURN | MENU_TIMEOUT | MENU_SETTING)
+const MenuState_s MenuTable[NUM_MENU_STATES] PROGMEM = {
+  //                    flags                                              up          down          next       ret           enter               exit             render
+  /* SHOW_TIME      */ { MENU_BROWSE | MENU_NEXT | MENU_RETURN,            SHOW_DATE,  SHOW_ALARM,   MENU_NONE, SET_HOUR,     menuTimeEnter,      NULL,            NULL                  },
+  /* SHOW_DATE      */ { MENU_BROWSE | MENU_NEXT | MENU_RETURN | MENU_T,   SHOW_WEEK,  SHOW_TIME,    SHOW_TIME, SET_DAY,      menuDateEnter,      NULL,            NULL                  },
+  /* SHOW_WEEK      */ { MENU_BROWSE | MENU_NEXT | MENU_RETURN | MENU_T,   SHOW_ALARM, SHOW_DATE,    SHOW_TIME, SET_WEEK,     menuWeekEnter,      NULL,            NULL                  },
+  /* SHOW_ALARM     */ { MENU_BROWSE | MENU_NEXT | MENU_RETURN | MENU_T,   SHOW_TIME,  SHOW_WEEK,    SHOW_TIME, SET_ALARM,    menuAlarmEnter,     NULL,            NULL                  },
+  /* SHOW_TIMER     */ { MENU_ACCEL | MENU_NEXT | MENU_T | MENU_FEATURE,   MENU_NONE,  MENU_NONE,    MENU_NONE, MENU_NONE,    menuTimerEnter,     NULL,            menuTimerRender       },
+  /* SHOW_STOPWATCH */ { MENU_NEXT | MENU_T | MENU_FEATURE,                MENU_NONE,  MENU_NONE,    MENU_NONE, MENU_NONE,    menuStopwatchEnter, NULL,            menuStopwatchRender   },
+  /* SHOW_SERVICE   */ { MENU_NEXT | MENU_RETURN | MENU_T,                 MENU_NONE,  MENU_NONE,    SHOW_TIME, SET_SETTINGS, menuServiceEnter,   menuServiceExit, menuServiceRender     },
+  /* SHOW_BLANK     */ { 0,                                                MENU_NONE,  MENU_NONE,    MENU_NONE, MENU_NONE,    menuBlankEnter,     menuBlankExit,   menuBlankRender       },
+  /* SET_ALARM      */ { MENU_ACCEL | MENU_RETURN | MENU_T | MENU_SETTING, MENU_NONE,  MENU_NONE,    MENU_NONE, SHOW_ALARM,   menuSetAlarmEnter,  NULL,            menuSetAlarmRender    },
+  /* SET_SETTINGS   */ { MENU_ACCEL | MENU_RETURN | MENU_T | MENU_SETTING, MENU_NONE,  MENU_NONE,    MENU_NONE, SHOW_TIME,    menuSettingsEnter,  NULL,            menuSettingsRender    },
+  /* SET_HOUR       */ { MENU_ACCEL | MENU_S,                              MENU_NONE,  MENU_NONE,    SET_MIN,   SHOW_TIME,    menuSetTimeEnter,   NULL,            menuSetTimeDateRender },
+  /* SET_MIN        */ { MENU_ACCEL | MENU_S,                              MENU_NONE,  MENU_NONE,    SET_SEC,   SHOW_TIME,    menuSetTimeEnter,   NULL,            menuSetTimeDateRender },
+  /* SET_SEC        */ { MENU_S,                                           MENU_NONE,  MENU_NONE,    SET_DAY,   SHOW_TIME,    menuSetTimeEnter,   NULL,            menuSetSecRender      },
+  /* SET_DAY        */ { MENU_ACCEL | MENU_S,                              MENU_NONE,  MENU_NONE,    SET_MONTH, SHOW_DATE,    menuSetDateEnter,   NULL,            menuSetTimeDateRender },
+  /* SET_MONTH      */ { MENU_ACCEL | MENU_S,                              MENU_NONE,  MENU_NONE,    SET_YEAR,  SHOW_DATE,    menuSetDateEnter,   NULL,            menuSetTimeDateRender },
+  /* SET_YEAR       */ { MENU_ACCEL | MENU_S,                              MENU_NONE,  MENU_NONE,    SET_WEEK,  SHOW_DATE,    menuSetDateEnter,   NULL,            menuSetTimeDateRender },
+  /* SET_WEEK       */ { MENU_ACCEL | MENU_S,                              MENU_NONE,  MENU_NONE,    SET_HOUR,  SHOW_WEEK,    menuSetWeekEnter,   NULL,            menuSetWeekRender     }
+};
+#undef MENU_T
+#undef MENU_S
+static_assert (SET_HOUR + 2 == SET_SEC && SET_DAY + 2 == SET_YEAR, "menuSetTimeEnter() and menuSetDateEnter() rely on the state order");
+
+/*
+ * Read a field of the current menu state descriptor from flash memory
+ * the flags are cleared while a state change is pending
+ */
+#define MENU_FIELD(NAME) progmemRead (&MenuTable[G.menuState].NAME)
+#define MENU_FLAGS(FLAG) (G.menuRequest == MENU_NONE ? MENU_FIELD (flags) & (FLAG) : 0)
+
+
+
+/***********************************
+ * Request a menu state change
+ * the state is entered upon the next settingsMenu() execution
+ ***********************************/
+void menuSwitch (MenuState_e state) {
+  G.menuRequest = state;
+  Scheduler.signal (SCHEDULER_INPUT);  // wake-up the settings menu
+}
+/*********/
+
+
+
+/***********************************
+ * Apply a pending menu state change
+ * calls the exit handler of the current state and
+ * the enter handler of the new state
+ ***********************************/
+void menuTransition (void) {
+  MenuHandler_t handler;
+
+  if (G.menuRequest == MENU_NONE) return;
+
+  handler = MENU_FIELD (exit);
+  if (handler != NULL) handler ();
+
+  // ensure not to access outside of the descriptor table bounds
+  G.menuState   = G.menuRequest < NUM_MENU_STATES ? (MenuState_e)G.menuRequest : SHOW_TIME;
+  G.menuRequest = MENU_NONE;
+
+  // apply the default transitions of the new state
+  if (MENU_FIELD (next) != MENU_NONE) Menu.nextState   = (MenuState_e)MENU_FIELD (next);
+  if (MENU_FIELD (ret)  != MENU_NONE) Menu.returnState = (MenuState_e)MENU_FIELD (ret);
+
+  handler = MENU_FIELD (enter);
+  if (handler != NULL) handler ();
+}
+/*********/
+
+
 
 /***********************************
  * Implements the settings menu
  * navigation structure
+ * executed upon the button, second and 1/10 second events:
+ * - the button handling common to several states is selected by the MENU_* flags of MenuTable
+ * - each state defines the next state to be selected via short-pressing button 0 (nextState)
+ *   and the return state to be selected by long-pressing button 0 (returnState) in MenuTable
+ * - a feature has been used (by pressing one or more buttons), pressing button 0 will return to the clock display state
+ * - the enter and exit handlers of MenuTable are called upon a state change, the render handler
+ *   implements the state specific button handling and display updates
  ***********************************/
 void settingsMenu (void) {
-  static uint16_t scrollLut[SCROLL_LUT_SIZE] =
-      { 250, 160, 155, 150, 145, 140, 135, 130, 120, 110, 100, 90, 80, 70, 60, 50, 40, 30 };
-  static MenuState_e nextState = SHOW_DATE_E;
-  static MenuState_e returnState = SHOW_TIME_E;
-  static int8_t menuIdx = 0;
-  static uint8_t scrollIdx = 0;
-  static const uint32_t menuTimeoutDefault = (uint32_t)60*1000;
-  static const uint32_t menuTimeoutExtended = 60*60000;
-  static const uint32_t menuTimeoutNextState = 5*1000;
-  static uint32_t timeoutTs = 0;
-  static uint32_t scrollTs = 0;
-  static uint32_t brightnessTs = 0;
-  static uint32_t accelTs = 0;
-  static uint32_t bannerTs = 0;
-  static uint32_t scrollDelay = scrollLut[0];
-  static uint32_t menuTimeout = menuTimeoutDefault;
-  static NixieDigit_s valueDigits[VALUE_DIGITS_SIZE];
-  static int8_t sIdx = 0;
-  static int8_t vIdx = 0;
-  static bool brightnessEnable = false;
-  uint8_t i;
+  MenuHandler_t render;
   uint8_t valU8;
-  int8_t val8;
-  int16_t val16;
-  time_t sysTime;
-  time_t locTime;
-  tm *t;
   uint32_t ts = millis ();
 
+  Menu.ts = ts;
+
+  // enter a state that has been requested from outside of the menu
+  menuTransition ();
+
   // button 0 - rising edge --> initiate a long press
   if (Button[0].rising ()) {
-    timeoutTs = ts;  // reset the menu timeout
+    Menu.timeoutTs = ts;  // reset the menu timeout
   }
 
   Nixie.refresh ();  // refresh the Nixie tube display
 
   // modes where buttons 1 and 2 are used for digit/setting adjustments
   // using the progressive scrolling acceleration feature
-  if ( G.menuState == SHOW_TIMER || (G.menuState >= SET_ALARM && G.menuState != SET_SEC) ) {
+  if (MENU_FLAGS (MENU_ACCEL)) {
     // button 1 or 2 - rising edge --> initiate a long press
     if (Button[1].rising () || Button[2].rising ()){
-      accelTs   = ts;
-      timeoutTs = ts;                // reset the menu timeout
-      scrollTs  = ts - scrollDelay;  // ensure digits are updated immediately after a button press
-      scrollIdx = 0;
+      Menu.accelTs   = ts;
+      Menu.timeoutTs = ts;                     // reset the menu timeout
+      Menu.scrollTs  = ts - Menu.scrollDelay;  // ensure digits are updated immediately after a button press
+      Menu.scrollIdx = 0;
     }
     // button 1 or 2 - long press --> accelerate scrolling digits
-    else if ( (Button[1].pressed || Button[2].pressed) && ts - accelTs >= SCROLL_INTERVAL) {
-      accelTs += SCROLL_INTERVAL;
-      if (scrollIdx + 1 < SCROLL_LUT_SIZE) {
-        scrollIdx++;
-        scrollDelay = scrollLut[scrollIdx];
+    else if ( (Button[1].pressed || Button[2].pressed) && ts - Menu.accelTs >= SCROLL_INTERVAL) {
+      Menu.accelTs += SCROLL_INTERVAL;
+      if (Menu.scrollIdx + 1 < SCROLL_LUT_SIZE) {
+        Menu.scrollIdx++;
+        Menu.scrollDelay = progmemRead (&ScrollLut[Menu.scrollIdx]);
       }
     }
     // button 1 or 2 - falling edge --> reset scroll speed
     else if (Button[1].fallingContinuous () || Button[2].fallingContinuous ()) {
-      scrollDelay = scrollLut[0];
+      Menu.scrollDelay = progmemRead (&ScrollLut[0]);
     }
   }
 
@@ -1349,27 +2703,21 @@ void settingsMenu (void) {
   // in timekeeping and alarm modes, buttons 1 and 2 are used switching to the date and alarm modes
   // or for adjusting display brightness when long-pressed
   // or for snoozing or resetting the alarm
-  if (G.menuState == SHOW_TIME || G.menuState == SHOW_DATE || G.menuState == SHOW_ALARM || G.menuState == SHOW_WEEK) {
+  if (MENU_FLAGS (MENU_BROWSE)) {
     // button 1  or 2- rising edge --> initiate a long press
     if (Button[1].rising () || Button[2].rising ()) {
-      timeoutTs = ts;
-      brightnessEnable = true;
+      Menu.timeoutTs = ts;
+      Menu.brightnessEnable = true;
     }
-    // button 1 - falling edge --> snooze alarm or change state: SHOW_DATE->SHOW_WEEK->SHOW_ALARM->SHOW_TIME
+    // button 1 - falling edge --> snooze alarm or change state: SHOW_TIME->SHOW_DATE->SHOW_WEEK->SHOW_ALARM->SHOW_TIME
     else if (Button[1].falling ()) {
       if (Alarm.alarm) Alarm.snooze ();
-      else if (G.menuState == SHOW_TIME) G.menuState = SHOW_DATE_E;
-      else if (G.menuState == SHOW_DATE) G.menuState = SHOW_WEEK_E;
-      else if (G.menuState == SHOW_WEEK) G.menuState = SHOW_ALARM_E;
-      else if (G.menuState == SHOW_ALARM) G.menuState = SHOW_TIME_E;
+      else             menuSwitch ((MenuState_e)MENU_FIELD (up));
     }
-    // button 2 - falling edge --> snooze alarm or change state: SHOW_ALARM->SHOW_WEEK->SHOW_DATE->SHOW_TIME
+    // button 2 - falling edge --> snooze alarm or change state: SHOW_TIME->SHOW_ALARM->SHOW_WEEK->SHOW_DATE->SHOW_TIME
     else if (Button[2].falling ()) {
       if (Alarm.alarm) Alarm.snooze ();
-      else if (G.menuState == SHOW_TIME) G.menuState = SHOW_ALARM_E;
-      else if (G.menuState == SHOW_ALARM) G.menuState = SHOW_WEEK_E;
-      else if (G.menuState == SHOW_WEEK) G.menuState = SHOW_DATE_E;
-      else if (G.menuState == SHOW_DATE) G.menuState = SHOW_TIME_E;
+      else             menuSwitch ((MenuState_e)MENU_FIELD (down));
     }
     else if (Alarm.alarm || Alarm.snoozing) {
       // button 1 or 2 - long press --> reset alarm
@@ -1377,12 +2725,13 @@ void settingsMenu (void) {
         Nixie.blinkOnce ();
         Alarm.resetAlarm ();
       }
-      brightnessEnable = false;
+      Menu.brightnessEnable = false;
     }
     else if ( G.menuState == SHOW_ALARM) {
       // button 1 long press --> toggle alarm active
       if (Button[1].longPress ()) {
         Alarm.modeToggle ();
+        Buzzer.play (BUZZER_CONFIRM);
       }
     }
     else if ( G.menuState == SHOW_DATE || G.menuState == SHOW_WEEK) {
@@ -1393,12 +2742,12 @@ void settingsMenu (void) {
     }
     else if ( G.menuState == SHOW_TIME) {
       // button 1 or 2 - long press --> increase/decrease brightness
-      if ((Button[1].longPressContinuous () || Button[2].longPressContinuous ()) && ts - brightnessTs >= 50 && brightnessEnable) {
+      if ((Button[1].longPressContinuous () || Button[2].longPressContinuous ()) && ts - Menu.brightnessTs >= 50 && Menu.brightnessEnable) {
         if (Button[1].pressed) valU8 = Brightness.increase ();
         else                   valU8 = Brightness.decrease ();
         Nixie.setBrightness (valU8);
         Nixie.refresh ();
-        brightnessTs = ts;
+        Menu.brightnessTs = ts;
       }
     }
   }
@@ -1407,7 +2756,7 @@ void settingsMenu (void) {
 
   // modes where short-pressing button 0 is used for switching to the next display mode
   // when alarm(s) are active short-pressing button 0 will cancel or snooze the alarm(s) instead
-  if ( (G.menuState >= SHOW_TIME && G.menuState <= SHOW_SERVICE) || G.menuState >= SET_HOUR || CdTimer.alarm || Alarm.alarm) {
+  if (MENU_FLAGS (MENU_NEXT) || CdTimer.alarm || Alarm.alarm) {
     // button 0 - falling edge --> reset alarms or change state: nextState
     if (Button[0].falling ()) {
       if (G.cppEffectEnabled)  G.cppEffectEnabled = false; // disable cathode poisoning prevention effect
@@ -1416,16 +2765,15 @@ void settingsMenu (void) {
         CdTimer.resetAlarm (); // reset alarm of the countdown timer feature
       }
       else {
-        menuTimeout = menuTimeoutDefault;
-        G.menuState = nextState;
+        Menu.menuTimeout = MENU_TIMEOUT_DEFAULT;
+        menuSwitch (Menu.nextState);
       }
     }
   }
 
   // in selected modes, long-pressing button 0 shall switch to the pre-defined setting mode or display mode
   // when the alarm clock is snoozed or active, long-pressing button 0 will cancel the alarm
-  if (G.menuState == SHOW_TIME || G.menuState == SHOW_DATE || G.menuState == SHOW_ALARM || G.menuState == SHOW_WEEK ||
-      G.menuState == SHOW_SERVICE || G.menuState >= SET_ALARM) {
+  if (MENU_FLAGS (MENU_RETURN)) {
     // button 0 - long press --> reset alarm or change state: returnState
     if (Button[0].longPress ()) {
       if (Alarm.alarm || Alarm.snoozing) {
@@ -1433,8 +2781,12 @@ void settingsMenu (void) {
         Alarm.resetAlarm ();  // stop the alarm clock
       }
       else {
-        if (G.menuState >= SET_ALARM) Nixie.blinkOnce ();
-        G.menuState = returnState;
+        // leaving a setting mode confirms the new settings
+        if (MENU_FLAGS (MENU_SETTING)) {
+          Nixie.blinkOnce ();
+          Buzzer.play (BUZZER_CONFIRM);
+        }
+        menuSwitch (Menu.returnState);
       }
     }
   }
@@ -1442,709 +2794,30 @@ void settingsMenu (void) {
   Nixie.refresh ();  // refresh the Nixie tube display
 
   // timeout --> change state: SHOW_TIME
-  if (G.menuState != SHOW_BLANK_E && G.menuState != SHOW_BLANK && G.menuState != SHOW_TIME) {
-    if (ts - timeoutTs > menuTimeout) {
-      menuTimeout = menuTimeoutDefault;
-      G.menuState = SHOW_TIME_E;
+  if (MENU_FLAGS (MENU_TIMEOUT)) {
+    if (ts - Menu.timeoutTs > Menu.menuTimeout) {
+      Menu.menuTimeout = MENU_TIMEOUT_DEFAULT;
+      menuSwitch (SHOW_TIME);
     }
   }
 
   // timeout --> return to time display upon pressing button 0
-  if (G.menuState == SHOW_TIMER || G.menuState == SHOW_STOPWATCH) {
-    if (ts - timeoutTs > menuTimeoutNextState) {
-      nextState = SHOW_TIME_E;
+  if (MENU_FLAGS (MENU_FEATURE)) {
+    if (ts - Menu.timeoutTs > MENU_TIMEOUT_FEATURE) {
+      Menu.nextState = SHOW_TIME;
     }
   }
 
   // if alarm is ringing the switch to the corresponding display mode
-  if (Alarm.alarm && G.menuState != SHOW_TIME) G.menuState = SHOW_TIME_E;
-  if (CdTimer.alarm && G.menuState != SHOW_TIMER) G.menuState = SHOW_TIMER_E;
+  if (Alarm.alarm   && (G.menuState != SHOW_TIME  || G.menuRequest != MENU_NONE)) menuSwitch (SHOW_TIME);
+  if (CdTimer.alarm && (G.menuState != SHOW_TIMER || G.menuRequest != MENU_NONE)) menuSwitch (SHOW_TIMER);
 
-  Nixie.refresh ();  // refresh the Nixie tube display
+  // enter the newly selected state, then execute the state specific part
+  menuTransition ();
 
-  // ensure not to access outside of array bounds
-  if (menuIdx >= MENU_ORDER_LIST_SIZE) menuIdx = 0;
-
-  // main state machines that implements the menu navigation with the different
-  // display and setting modes
-  // - each state is entered through a corresponding entry state (with _E suffix)
-  // - each state defines the next state to be selected via short-pressing button 0 (nextState)
-  // - a feature has been used (by pressing one or more buttons), pressing button 0 will return to the clock display state
-  // - setting state may define the return state to be selected by long-pressing button 0 (returnState)
-  // - in order to reduce the code size functionality that is common to several states is nested within
-  //   the conditional statements defined above
-  switch (G.menuState) {
-
-    /*################################################################################*/
-    case SHOW_TIME_E:
-      Nixie.enable (true);
-      Nixie.cancelScroll ();
-      Nixie.setDigits (G.timeDigits, NIXIE_NUM_TUBES);
-      for (i = 0; i < 6; i++) G.timeDigits[i].blink = false;
-      menuIdx = 0;
-      nextState = G.menuOrder[menuIdx]; // switch to this state after short-pressing button 0
-                                        // use dynamic menu ordering
-      returnState = SET_HOUR_E;         // switch to this state after long-pressing button 0
-      G.menuState = SHOW_TIME;
-    case SHOW_TIME:
-      break;
-
-    /*################################################################################*/
-    case SHOW_DATE_E:
-      Nixie.setDigits (G.dateDigits, NIXIE_NUM_TUBES);
-      G.dateDigits[4].comma = true;
-      G.dateDigits[2].comma = true;
-      for (i = 0; i < 6; i++) G.dateDigits[i].blink = false;
-      //menuIdx = 0;
-      nextState   = SHOW_TIME_E;
-      returnState = SET_DAY_E;
-      G.menuState = SHOW_DATE;
-    case SHOW_DATE:
-      // do nothing
-      break;
-
-    /*################################################################################*/
-    case SHOW_WEEK_E:
-      Nixie.resetDigits (valueDigits, VALUE_DIGITS_SIZE);
-      Nixie.setDigits (valueDigits, NIXIE_NUM_TUBES);
-      valU8 = (uint8_t) (calendarWeek () > 0 ? calendarWeek () : 0);
-      valueDigits[0].value = dec2bcdLow (valU8);
-      valueDigits[1].value = dec2bcdHigh (valU8);
-      valueDigits[2].blank = true;
-      valueDigits[3].blank = true;
-      valueDigits[4].value = weekDay();
-      valueDigits[5].blank = true;
-      nextState   = SHOW_TIME_E;
-      returnState = SET_WEEK_E;
-      G.menuState = SHOW_WEEK;
-    case SHOW_WEEK:
-      // do nothing
-      break;
-
-    /*################################################################################*/
-    case SHOW_ALARM_E:
-      Nixie.setDigits (Alarm.digits, NIXIE_NUM_TUBES);
-      Alarm.displayRefresh ();
-      for (i = 0; i < NIXIE_NUM_TUBES; i++) Alarm.digits[i].blink = false;
-      //menuIdx = 0;
-      nextState   = SHOW_TIME_E;
-      returnState = SET_ALARM_E;
-      G.menuState = SHOW_ALARM;
-    case SHOW_ALARM:
-      // do nothing
-      break;
-
-    /*################################################################################*/
-    case SHOW_TIMER_E:
-      Nixie.enable (true);
-      Nixie.setDigits (CdTimer.digits, NIXIE_NUM_TUBES);
-      if (!CdTimer.running && !CdTimer.alarm && !Stopwatch.active) CdTimer.reset ();
-      menuIdx++;
-      nextState   = G.menuOrder[menuIdx];
-      menuTimeout = menuTimeoutExtended; // extend the menu timeout
-      G.menuState = SHOW_TIMER;
-    case SHOW_TIMER:
-      // reset the menu timeout as long as timer is running
-      if (CdTimer.running && ts - timeoutTs > menuTimeout - 1000) timeoutTs = ts;
-
-      // button 0 - long press --> reset the countdown timer
-      if (Button[0].longPress ()) {
-        Nixie.blinkOnce ();
-        if (CdTimer.running) {
-          CdTimer.stop ();
-          CdTimer.resetAlarm ();
-        }
-        else if (CdTimer.active) {
-          CdTimer.reset ();
-        }
-        else {
-          Stopwatch.reset ();
-          CdTimer.start ();
-        }
-        nextState = SHOW_TIME_E; // if feature was used, return to time display upon pressing button 0
-        reorderMenu (menuIdx); // if feature was used, it will appear first once the menu is accessed
-      }
-      // button 1 or 2 - falling edge --> reset timer alarm
-      else if (Button[1].falling () || Button[2].falling ()) {
-        CdTimer.resetAlarm ();
-        nextState = SHOW_TIME_E;
-        reorderMenu (menuIdx);
-      }
-      // button 1 or 2 - pressed --> increase/decrease minutes / arm countdown timer
-      else if (Button[1].pressed || Button[2].pressed) {
-        if (ts - scrollTs >= scrollDelay) {
-          if (!CdTimer.alarm) {
-            if (Button[1].pressed) CdTimer.minuteIncrease ();
-            else                   CdTimer.minuteDecrease ();
-          }
-          scrollTs  = ts;
-          nextState = SHOW_TIME_E;
-          reorderMenu (menuIdx);
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SHOW_STOPWATCH_E:
-      Nixie.setDigits (Stopwatch.digits, NIXIE_NUM_TUBES);
-      if (!Stopwatch.active && !CdTimer.active) Stopwatch.reset ();
-      menuIdx++;
-      nextState   = G.menuOrder[menuIdx];
-      menuTimeout = menuTimeoutExtended; // extend the menu timeout
-      G.menuState = SHOW_STOPWATCH;
-    case SHOW_STOPWATCH:
-      // reset the menu timeout as long as stopwatch is running
-      if (Stopwatch.running && ts - timeoutTs > menuTimeout - 1000) timeoutTs = ts;
-
-      // button 0 - long press --> reset the stopwatch
-      if (Button[0].longPress ()) {
-        Stopwatch.reset ();
-        Nixie.blinkOnce ();
-        nextState = SHOW_TIME_E;
-        reorderMenu (menuIdx);
-      }
-      // button 1 rising edge --> start/stop stopwatch
-      else if (Button[1].rising ()) {
-        timeoutTs = ts; // reset the menu timeout
-        if (Stopwatch.running) Stopwatch.stop ();
-        else CdTimer.reset(), Stopwatch.start ();
-        nextState = SHOW_TIME_E;
-        reorderMenu (menuIdx);
-      }
-      // button 2 rising edge --> toggle pause stopwatch
-      else if (Button[2].rising ()) {
-        timeoutTs = ts; // reset the menu timeout
-        if (Stopwatch.active) {
-          if (Stopwatch.paused) Stopwatch.pause (false);
-          else                  Stopwatch.pause (true);
-          nextState = SHOW_TIME_E;
-          reorderMenu (menuIdx);
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SHOW_SERVICE_E:
-      Nixie.resetDigits (valueDigits, VALUE_DIGITS_SIZE);
-      bannerTs = ts;
-      vIdx = 0;
-      nextState   = SHOW_TIME_E;
-      returnState = SET_SETTINGS_E;
-      G.menuState = SHOW_SERVICE;
-      goto SHOW_SERVICE_ENTRY_POINT;
-    case SHOW_SERVICE:
-      // button 1 or 2 rising edge --> cycle back and forth between system parameters
-      if (Button[1].rising () || Button[2].rising ()) {
-          timeoutTs = ts;  // reset the menu timeout
-          bannerTs  = ts;  // reset display scroll period
-          Nixie.cancelScroll ();
-          Nixie.resetDigits (valueDigits, VALUE_DIGITS_SIZE);
-        if      (Button[1].pressed) {
-          vIdx++; if (vIdx >= NUM_SERVICE_VALUES) vIdx = 0;
-        }
-        else if (Button[2].pressed) {
-          vIdx--; if (vIdx < 0) vIdx = NUM_SERVICE_VALUES - 1;
-        }
-        SHOW_SERVICE_ENTRY_POINT:
-        // show Timer1 period (default)
-        if (vIdx == 0) {
-          Nixie.setDigits (valueDigits, 11);
-          Nixie.dec2bcd (G.timer1Period * 100, valueDigits, VALUE_DIGITS_SIZE, 9);
-          valueDigits[10].value = 1;
-          valueDigits[10].comma = true;
-          valueDigits[9].blank  = true;
-          valueDigits[2].comma  = true;
-          valueDigits[1].value  = dec2bcdHigh(G.timer1PeriodFL);
-          valueDigits[0].value  = dec2bcdLow(G.timer1PeriodFL);
-        }
-        // show Nixie tube uptime
-        else if (vIdx == 1) {
-          Nixie.setDigits (valueDigits, 8);
-          cli ();
-          Nixie.dec2bcd (Settings.nixieUptime / ONE_HOUR, valueDigits, VALUE_DIGITS_SIZE, 6);
-          sei ();
-          valueDigits[7].value = 2;
-          valueDigits[7].comma = true;
-          valueDigits[6].blank = true;
-        }
-        // Show the last DCF sync date
-        else if (vIdx == 2) {
-          if (G.lastDcfSyncTime != 0) {
-            locTime = convertToLocalTime(G.lastDcfSyncTime);
-            localtime_r(&locTime, &G.lastDcfSyncTm);
-          }
-          Nixie.setDigits (valueDigits, 8);
-          valueDigits[7].value = 3;
-          valueDigits[7].comma = true;
-          valueDigits[6].blank = true;
-          valueDigits[5].value = dec2bcdHigh (G.lastDcfSyncTm.tm_mday);
-          valueDigits[4].value = dec2bcdLow (G.lastDcfSyncTm.tm_mday);
-          valueDigits[4].comma = true;
-          valueDigits[3].value = dec2bcdHigh (G.lastDcfSyncTm.tm_mon + (G.lastDcfSyncTm.tm_mday == 0 ? 0 : 1));
-          valueDigits[2].value = dec2bcdLow (G.lastDcfSyncTm.tm_mon + (G.lastDcfSyncTm.tm_mday == 0 ? 0 : 1));
-          valueDigits[2].comma = true;
-          valueDigits[1].value = dec2bcdHigh (G.lastDcfSyncTm.tm_year);
-          valueDigits[0].value = dec2bcdLow (G.lastDcfSyncTm.tm_year);
-        }
-        // Show the last DCF sync time
-        else if (vIdx == 3) {
-          if (G.lastDcfSyncTime != 0) {
-            locTime = convertToLocalTime(G.lastDcfSyncTime);
-            localtime_r(&locTime, &G.lastDcfSyncTm);
-          }
-          Nixie.setDigits (valueDigits, 8);
-          valueDigits[7].value = 4;
-          valueDigits[7].comma = true;
-          valueDigits[6].blank = true;
-          valueDigits[5].value = dec2bcdHigh (G.lastDcfSyncTm.tm_hour);
-          valueDigits[4].value = dec2bcdLow (G.lastDcfSyncTm.tm_hour);
-          valueDigits[3].value = dec2bcdHigh (G.lastDcfSyncTm.tm_min);
-          valueDigits[2].value = dec2bcdLow (G.lastDcfSyncTm.tm_min);
-          valueDigits[1].value = dec2bcdHigh (G.lastDcfSyncTm.tm_sec);
-          valueDigits[0].value = dec2bcdLow (G.lastDcfSyncTm.tm_sec);
-        }
-        // show firmware version
-        else if (vIdx == 4) {
-          Nixie.setDigits (valueDigits, 8);
-          valueDigits[7].value = 5;
-          valueDigits[7].comma = true;
-          valueDigits[6].blank = true;
-          valueDigits[5].value = dec2bcdHigh (VERSION_MAJOR);
-          valueDigits[4].value = dec2bcdLow (VERSION_MAJOR);
-          valueDigits[4].comma = true;
-          valueDigits[3].value = dec2bcdHigh (VERSION_MINOR);
-          valueDigits[2].value = dec2bcdLow (VERSION_MINOR);
-          valueDigits[2].comma = true;
-          valueDigits[1].value = dec2bcdHigh (VERSION_MAINT);
-          valueDigits[0].value = dec2bcdLow (VERSION_MAINT);
-        }
-#ifdef DEBUG_VALUES
-        // show the Debug values
-        else if (vIdx >= (NUM_SERVICE_VALUES - NUM_DEBUG_VALUES) && vIdx < NUM_SERVICE_VALUES) {
-          uint8_t idx = vIdx - (NUM_SERVICE_VALUES - NUM_DEBUG_VALUES);
-          Nixie.setDigits (valueDigits, NUM_DEBUG_DIGITS + 2);
-          valueDigits[NUM_DEBUG_DIGITS + 1].value = idx;
-          valueDigits[NUM_DEBUG_DIGITS] .comma    = true;
-          valueDigits[NUM_DEBUG_DIGITS].blank     = true;
-          if (idx < NUM_DEBUG_VALUES)  {
-            if (Debug.values[idx] < 0) {
-              Nixie.dec2bcd ((uint32_t)(-Debug.values[idx]), valueDigits, VALUE_DIGITS_SIZE, NUM_DEBUG_DIGITS);
-              for (i = 0; i < NUM_DEBUG_DIGITS; i++) valueDigits[i].comma = true;
-            }
-            else {
-              Nixie.dec2bcd ((uint32_t)Debug.values[idx], valueDigits, VALUE_DIGITS_SIZE, NUM_DEBUG_DIGITS);
-            }
-          }
-          else {
-            Nixie.dec2bcd (0, valueDigits, VALUE_DIGITS_SIZE, NUM_DEBUG_DIGITS);
-          }
-        }
-#endif
-        Nixie.scroll ();
-      }
-      // scroll the display every x seconds
-      if (ts - bannerTs > 6000) Nixie.scroll (), bannerTs = ts;
-      break;
-
-    /*################################################################################*/
-    case SHOW_BLANK_E:
-      Nixie.enable (false);
-      G.menuState = SHOW_BLANK;
-    case SHOW_BLANK:
-      // button 0, 1 or 2 - rising edge --> catch rising edge
-      Button[0].rising ();
-      Button[1].rising ();
-      Button[2].rising ();
-      // button 0, 1 or 2 - falling edge --> re-activate display
-      if (Button[0].falling () || Button[1].falling () || Button[2].falling ()) {
-        G.menuState = SHOW_TIME_E;
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_ALARM_E:
-      Nixie.setDigits (Alarm.digits, NIXIE_NUM_TUBES);
-      Alarm.displayRefresh ();
-      for (i = 0; i < NIXIE_NUM_TUBES; i++) Alarm.digits[i].blink = false;
-      sIdx = 0;
-      Alarm.digits[5].blink = true;
-      Alarm.digits[4].blink = true;
-      returnState = SHOW_ALARM_E;
-      G.menuState = SET_ALARM;
-    case SET_ALARM:
-      // button 0 - falling edge --> select next setting value
-      if (Button[0].falling ()) {
-        sIdx++; if (sIdx > 2) sIdx = 0;
-        if (sIdx == 0) {
-          Alarm.digits[5].blink = true;
-          Alarm.digits[4].blink = true;
-          Alarm.digits[1].blink = false;
-          Alarm.digits[0].blink = false;
-        }
-        else if (sIdx == 1) {
-          Alarm.digits[5].blink = false;
-          Alarm.digits[4].blink = false;
-          Alarm.digits[3].blink = true;
-          Alarm.digits[2].blink = true;
-        }
-        else if (sIdx == 2) {
-          Alarm.digits[3].blink = false;
-          Alarm.digits[2].blink = false;
-          Alarm.digits[1].blink = true;
-          Alarm.digits[0].blink = true;
-        }
-      }
-      // button 1 or 2 - pressed --> increase/decrease value
-      else if (Button[1].pressed || Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          if (sIdx == 0) {
-            if (Button[1].pressed) Alarm.hourIncrease ();
-            else                   Alarm.hourDecrease ();
-          }
-          else if (sIdx == 1) {
-            if (Button[1].pressed) Alarm.minuteIncrease ();
-            else                   Alarm.minuteDecrease ();
-          }
-          else if (sIdx == 2) {
-            if (Button[1].pressed) Alarm.modeIncrease ();
-            else                   Alarm.modeDecrease ();
-          }
-          scrollTs = ts;
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_SETTINGS_E:
-      Nixie.cancelScroll ();
-      Nixie.setDigits (valueDigits, NIXIE_NUM_TUBES);
-      valueDigits[0].blink = true;
-      valueDigits[1].blink = true;
-      valueDigits[4].blink = false;
-      valueDigits[5].blink = false;
-      valueDigits[2].blank = true;
-      valueDigits[3].blank = true;
-      valueDigits[5].comma = true;
-      sIdx = 0;
-      valueDigits[5].value = SettingsLut[sIdx].idDigit1;
-      valueDigits[4].value = SettingsLut[sIdx].idDigit0;
-      val8 = *SettingsLut[sIdx].value;
-      valueDigits[2].comma = (val8 < 0);
-      valueDigits[1].value = dec2bcdHigh ((uint8_t)abs(val8));
-      valueDigits[0].value = dec2bcdLow ((uint8_t)abs(val8));
-      returnState = SHOW_TIME_E;
-      G.menuState = SET_SETTINGS;
-    case SET_SETTINGS:
-      // button 0 - falling edge --> select next setting value
-      if (Button[0].falling ()) {
-        sIdx++;
-        if (sIdx >= SETTINGS_LUT_SIZE) sIdx = 0;
-
-        // reset the clock drift correction value, it is used for display purposes only
-        if (SettingsLut[sIdx].value == (int8_t *)&Settings.clockDriftCorrect) {
-          Settings.clockDriftCorrect = 0;
-        }
-
-        valueDigits[5].value = SettingsLut[sIdx].idDigit1;
-        valueDigits[4].value = SettingsLut[sIdx].idDigit0;
-        val8 = *SettingsLut[sIdx].value;
-        valueDigits[2].comma = (val8 < 0);
-        valueDigits[1].value = dec2bcdHigh ((uint8_t)abs(val8));
-        valueDigits[0].value = dec2bcdLow ((uint8_t)abs(val8));
-      }
-      // button 1 or 2 pressed --> increase/decrease value
-      else if (Button[1].pressed || Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          val16 = (int16_t)*SettingsLut[sIdx].value;
-          if (Button[1].pressed) {
-            val16++;
-            if (val16 > SettingsLut[sIdx].maxVal) val16 = SettingsLut[sIdx].minVal;
-          }
-          else {
-            val16--;
-            if (val16 < SettingsLut[sIdx].minVal) val16 = SettingsLut[sIdx].maxVal;
-          }
-          *SettingsLut[sIdx].value = (int8_t)val16;
-          valueDigits[2].comma = (val16 < 0);
-          valueDigits[1].value = dec2bcdHigh ((uint8_t)abs(val16));
-          valueDigits[0].value = dec2bcdLow ((uint8_t)abs(val16));
-          Nixie.refresh ();
-          scrollTs = ts;
-
-          // if clock drift correction value has been set
-          if (SettingsLut[sIdx].value == (int8_t *)&Settings.clockDriftCorrect) {
-            if (Button[1].pressed) Settings.timerPeriod++;
-            else                   Settings.timerPeriod--;
-            timerCalculate ();
-            G.manuallyAdjusted = true;
-          }
-          // if auto brightness feature was activated/deactivated
-          else if (SettingsLut[sIdx].value == (int8_t *)&Settings.brightnessAutoAdjust) {
-            Brightness.autoEnable (Settings.brightnessAutoAdjust);
-          }
-#ifndef SERIAL_DEBUG
-          // if the brighness boost feature has been activated/deactivated
-          else if (SettingsLut[sIdx].value == (int8_t *)&Settings.brightnessBoost) {
-            Brightness.boostEnable (Settings.brightnessBoost);
-          }
-#endif
-        }
-      }
-
-      break;
-
-    /*################################################################################*/
-    case SET_HOUR_E:
-      Nixie.cancelScroll ();
-      Nixie.setDigits (G.timeDigits, NIXIE_NUM_TUBES);
-      G.timeDigits[0].blink = false;
-      G.timeDigits[1].blink = false;
-      G.timeDigits[2].blink = false;
-      G.timeDigits[3].blink = false;
-      G.timeDigits[4].blink = true;
-      G.timeDigits[5].blink = true;
-      nextState   = SET_MIN_E;
-      returnState = SHOW_TIME_E;
-      G.menuState = SET_HOUR;
-    case SET_HOUR:
-      // button 1 - pressed --> increase hours
-      if (Button[1].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_hour++; if (t->tm_hour > 23) t->tm_hour = 0; );
-          scrollTs = ts;
-        }
-      }
-      // button 2 - pressed --> decrease hours
-      else if (Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_hour--; if (t->tm_hour < 0) t->tm_hour = 23; );
-          scrollTs = ts;
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_MIN_E:
-      Nixie.setDigits (G.timeDigits, NIXIE_NUM_TUBES);
-      G.timeDigits[0].blink = false;
-      G.timeDigits[1].blink = false;
-      G.timeDigits[2].blink = true;
-      G.timeDigits[3].blink = true;
-      G.timeDigits[4].blink = false;
-      G.timeDigits[5].blink = false;
-      nextState   = SET_SEC_E;
-      returnState = SHOW_TIME_E;
-      G.menuState = SET_MIN;
-    case SET_MIN:
-      // button 1 - pressed --> increase minutes
-      if (Button[1].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_min++; if (t->tm_min > 59) t->tm_min = 0; );
-          scrollTs = ts;
-        }
-      }
-      // button 2 - pressed --> decrease minutes
-      else if (Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_min--; if (t->tm_min < 0) t->tm_min = 59; );
-          scrollTs = ts;
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_SEC_E:
-      Nixie.setDigits (G.timeDigits, NIXIE_NUM_TUBES);
-      G.timeDigits[0].blink = true;
-      G.timeDigits[1].blink = true;
-      G.timeDigits[2].blink = false;
-      G.timeDigits[3].blink = false;
-      G.timeDigits[4].blink = false;
-      G.timeDigits[5].blink = false;
-      nextState   = SET_DAY_E;
-      returnState = SHOW_TIME_E;
-      G.menuState = SET_SEC;
-    case SET_SEC:
-      // button 1 - rising edge --> stop Timer1 then reset seconds to 0
-      if (Button[1].rising ()) {
-        timeoutTs = ts; // reset the menu timeout
-        G.timeDigits[0].blink = false;
-        G.timeDigits[1].blink = false;
-        cli ();
-        Timer1.stop ();
-        Timer1.restart ();
-        t = G.localTm;
-        val8 = t->tm_sec;
-        t->tm_sec = 0;
-        sysTime = mktime (t);
-        if (val8 >= 30) {
-          sysTime += 60;
-        }
-        sysTime = convertToUtcTime (sysTime);
-        set_system_time (sysTime);
-        sei ();
-        updateDigits ();
-        G.manuallyAdjusted = true;
-      }
-      // button 1 - falling edge --> start Timer1
-      else if (Button[1].falling ()) {
-        G.timeDigits[0].blink = true;
-        G.timeDigits[1].blink = true;
-        Nixie.resetBlinking ();
-        sysTime = time (NULL);
-        set_system_time (sysTime - 1);
-        Timer1.start ();
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_DAY_E:
-      Nixie.setDigits (G.dateDigits, NIXIE_NUM_TUBES);
-      G.dateDigits[0].blink = false;
-      G.dateDigits[1].blink = false;
-      G.dateDigits[2].blink = false;
-      G.dateDigits[3].blink = false;
-      G.dateDigits[4].blink = true;
-      G.dateDigits[5].blink = true;
-      G.dateDigits[2].comma = true;
-      G.dateDigits[4].comma = true;
-      nextState   = SET_MONTH_E;
-      returnState = SHOW_DATE_E;
-      G.menuState = SET_DAY;
-    case SET_DAY:
-      // button 1 - pressed --> increase days
-      if (Button[1].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_mday++; if (t->tm_mday > month_length (t->tm_year, t->tm_mon+1) ) t->tm_mday = 1; );
-          scrollTs = ts;
-        }
-      }
-      // button 2 - pressed --> decrease days
-      else if (Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_mday--; if (t->tm_mday < 1) t->tm_mday = month_length (t->tm_year, t->tm_mon+1); );
-          scrollTs = ts;
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_MONTH_E:
-      Nixie.setDigits (G.dateDigits, NIXIE_NUM_TUBES);
-      G.dateDigits[0].blink = false;
-      G.dateDigits[1].blink = false;
-      G.dateDigits[2].blink = true;
-      G.dateDigits[3].blink = true;
-      G.dateDigits[4].blink = false;
-      G.dateDigits[5].blink = false;
-      nextState   = SET_YEAR_E;
-      returnState = SHOW_DATE_E;
-      G.menuState = SET_MONTH;
-    case SET_MONTH:
-      // button 1 - pressed --> increase months
-      if (Button[1].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_mon++; if (t->tm_mon > 11) t->tm_mon = 0; );
-          scrollTs = ts;
-        }
-      }
-      // button 2 - pressed --> decrease months
-      else if (Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_mon--; if (t->tm_mon < 0) t->tm_mon = 11; );
-          scrollTs = ts;
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_YEAR_E:
-      Nixie.setDigits (G.dateDigits, NIXIE_NUM_TUBES);
-      G.dateDigits[0].blink = true;
-      G.dateDigits[1].blink = true;
-      G.dateDigits[2].blink = false;
-      G.dateDigits[3].blink = false;
-      G.dateDigits[4].blink = false;
-      G.dateDigits[5].blink = false;
-      nextState   = SET_WEEK_E;
-      returnState = SHOW_DATE_E;
-      G.menuState = SET_YEAR;
-    case SET_YEAR:
-      // button 1 - pressed --> increase years
-      if (Button[1].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_year++; if (t->tm_year > 230) t->tm_year = 230; )
-          scrollTs = ts;
-        }
-      }
-      // button 2 - pressed --> decrease years
-      else if (Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          SET_TIME_DATE( t->tm_year--; if (t->tm_year < 101) t->tm_year = 101; );
-          scrollTs = ts;
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    case SET_WEEK_E:
-      Nixie.resetDigits (valueDigits, VALUE_DIGITS_SIZE);
-      Nixie.setDigits (valueDigits, NIXIE_NUM_TUBES);
-      valU8 = calendarWeekValidate ();
-      valueDigits[0].blink = true;
-      valueDigits[1].blink = true;
-      valueDigits[0].value = dec2bcdLow (valU8);
-      valueDigits[1].value = dec2bcdHigh (valU8);
-      valueDigits[2].blank = true;
-      valueDigits[3].blank = true;
-      valueDigits[4].value = weekDay();
-      valueDigits[5].blank = true;
-      nextState   = SET_HOUR_E;
-      returnState = SHOW_WEEK_E;
-      G.menuState = SET_WEEK;
-    case SET_WEEK:
-      // button 1 - pressed --> increase calendar week
-      if (Button[1].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          Settings.calWeekAdjust++;
-          valU8 = calendarWeekValidate ();
-          valueDigits[0].value = dec2bcdLow (valU8);
-          valueDigits[1].value = dec2bcdHigh (valU8);
-          scrollTs = ts;
-        }
-      }
-      // button 2 - pressed --> decrease calendar week
-      else if (Button[2].pressed) {
-        Nixie.resetBlinking();
-        if (ts - scrollTs >= scrollDelay) {
-          Settings.calWeekAdjust--;
-          valU8 = calendarWeekValidate ();
-          valueDigits[0].value = dec2bcdLow (valU8);
-          valueDigits[1].value = dec2bcdHigh (valU8);
-          scrollTs = ts;
-        }
-      }
-      break;
-
-    /*################################################################################*/
-    default:
-      G.menuState = SHOW_TIME_E;
-      break;
-
-  }
+  Nixie.refresh ();  // refresh the Nixie tube display
 
+  render = MENU_FIELD (render);
+  if (render != NULL) render ();
 }
 /*********/
@@ -0,0 +1,247 @@
+/*
+ * Alarm scheduling unit tests
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+#include "../Features.h"
+
+
+/*
+ * Time of a given local date, the time zone offset is irrelevant for the scheduling
+ */
+static time_t at (int16_t year, uint8_t mon, uint8_t mday, uint8_t hour, uint8_t min, uint8_t sec = 0) {
+  tm t = { };
+  t.tm_year = year - 1900;
+  t.tm_mon  = mon;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min  = min;
+  t.tm_sec  = sec;
+  return timegm (&t);
+}
+
+/*
+ * Schedule the alarms at the given time without starting any of them
+ */
+static void schedule (AlarmClass *a, time_t now) {
+  tm t;
+  gmtime_r (&now, &t);
+  a->reschedule ();
+  a->loopHandler (now, &t, false);
+}
+
+/*
+ * Reference: first minute not before the current one that matches an enabled alarm,
+ * searched minute by minute
+ */
+static time_t refNext (const AlarmEeprom_s *s, uint8_t n, time_t now, time_t lastTime, int8_t *idx) {
+  time_t t;
+  uint8_t i;
+  tm lt;
+
+  for (t = now - now % 60; t < now + 8 * ONE_DAY; t += 60) {
+    if (t == lastTime) continue;
+    gmtime_r (&t, &lt);
+    for (i = 0; i < n; i++) {
+      if (s[i].enabled && s[i].hour == lt.tm_hour && s[i].minute == lt.tm_min && (s[i].days & (1 << lt.tm_wday))) {
+        *idx = i;
+        return t;
+      }
+    }
+  }
+  *idx = -1;
+  return 0;
+}
+
+
+TEST (alarmDays) {
+  AlarmClass a;
+  AlarmEeprom_s s[ALARM_NUM] = { { 7, 30, ALARM_WEEKDAYS, 1 }, { 9, 0, ALARM_WEEKENDS, 1 },
+                                 { 6, 0, ALARM_DAILY, 0 },     { 23, 59, 0x08, 1 } };
+
+  a.initialize (s, ALARM_NUM);
+
+  // Thursday 2023-06-01: the weekday alarm comes first
+  schedule (&a, at (2023, 5, 1, 5, 10, 42));
+  CHECK_EQUAL (a.nextIdx, 0);
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 1, 7, 30));
+
+  // Friday after the weekday alarm: the weekend alarm on Saturday
+  schedule (&a, at (2023, 5, 2, 8, 0));
+  CHECK_EQUAL (a.nextIdx, 1);
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 3, 9, 0));
+
+  // Sunday after the weekend alarm: Monday, the disabled daily alarm is ignored
+  schedule (&a, at (2023, 5, 4, 9, 1));
+  CHECK_EQUAL (a.nextIdx, 0);
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 5, 7, 30));
+
+  // Wednesday only, one week ahead
+  s[0].enabled = s[1].enabled = 0;
+  schedule (&a, at (2023, 5, 7, 23, 59, 59));
+  CHECK_EQUAL (a.nextIdx, 3);
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 7, 23, 59));
+  schedule (&a, at (2023, 5, 8, 0, 0));
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 14, 23, 59));
+
+  // nothing enabled: check again after eight days
+  s[3].enabled = 0;
+  schedule (&a, at (2023, 5, 8, 12, 0, 30));
+  CHECK_EQUAL (a.nextIdx, -1);
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 16, 12, 0));
+}
+
+
+TEST (alarmStart) {
+  AlarmClass a;
+  AlarmEeprom_s s[1] = { { 7, 30, ALARM_DAILY, 1 } };
+  time_t now;
+  tm t;
+
+  a.initialize (s, 1);
+  schedule (&a, at (2023, 5, 1, 7, 29));
+
+  // the alarm starts within its minute and never twice
+  for (now = at (2023, 5, 1, 7, 29); now < at (2023, 5, 1, 7, 32); now++) {
+    gmtime_r (&now, &t);
+    a.loopHandler (now, &t, true);
+    if (now == at (2023, 5, 1, 7, 30)) CHECK (a.alarm);
+    if (a.alarm) {
+      CHECK (now >= at (2023, 5, 1, 7, 30));
+      a.resetAlarm ();
+    }
+  }
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 2, 7, 30));
+
+  // the time jumps backwards into the alarm minute: no second start
+  a.reschedule ();
+  now = at (2023, 5, 1, 7, 30, 10);
+  gmtime_r (&now, &t);
+  a.loopHandler (now, &t, true);
+  CHECK (!a.alarm);
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 2, 7, 30));
+
+  // an alarm that could not start within its minute is skipped
+  now = at (2023, 5, 2, 7, 31);
+  gmtime_r (&now, &t);
+  a.loopHandler (now, &t, false);
+  CHECK (!a.alarm);
+  CHECK_EQUAL (a.nextTime, at (2023, 5, 3, 7, 30));
+}
+
+
+TEST (alarmReference) {
+  AlarmClass a;
+  AlarmEeprom_s s[ALARM_NUM];
+  uint32_t rnd = 1;
+  uint16_t n;
+  uint8_t i;
+  time_t now, ref;
+  int8_t idx;
+
+  a.initialize (s, ALARM_NUM);
+  for (n = 0; n < 2000; n++) {
+    for (i = 0; i < ALARM_NUM; i++) {
+      rnd = rnd * 1103515245 + 12345;
+      s[i].hour    = (rnd >> 8) % 24;
+      s[i].minute  = (rnd >> 16) % 60;
+      s[i].days    = ((rnd >> 22) % 0x7F) + 1;
+      s[i].enabled = (rnd >> 29) % 4 != 0;
+    }
+    rnd = rnd * 1103515245 + 12345;
+    now = at (2023, 0, 1, 0, 0) + (rnd >> 4) % (366 * ONE_DAY);
+    schedule (&a, now);
+    ref = refNext (s, ALARM_NUM, now, 0, &idx);
+    CHECK_EQUAL (a.nextIdx < 0, idx < 0);
+    if (idx < 0) continue;
+    CHECK_EQUAL (a.nextTime, ref);
+    CHECK (s[a.nextIdx].hour == s[idx].hour && s[a.nextIdx].minute == s[idx].minute);
+  }
+}
+
+
+TEST (alarmDisplayComma) {
+  AlarmClass a;
+  AlarmEeprom_s s[ALARM_NUM] = { { 7, 30, ALARM_WEEKDAYS, 0 }, { 9, 0, ALARM_WEEKENDS, 1 },
+                                 { 6, 0, ALARM_DAILY, 0 },     { 23, 59, 0x08, 0 } };
+
+  a.initialize (s, ALARM_NUM);
+
+  // disabled alarm selected: mode digit 0, the comma shows the other enabled alarm
+  a.sel = 0;
+  a.displayRefresh ();
+  CHECK_EQUAL (a.digits[0].value, 0);
+  CHECK (Nixie.getComma (0));
+
+  a.sel = 1;
+  a.displayRefresh ();
+  CHECK_EQUAL (a.digits[0].value, 2);
+  CHECK (Nixie.getComma (0));
+
+  // no alarm enabled
+  s[1].enabled = 0;
+  a.displayRefresh ();
+  CHECK_EQUAL (a.digits[0].value, 0);
+  CHECK (!Nixie.getComma (0));
+}
+
+
+/*
+ * Advance the buzzer playback by the given number of 1 ms ticks
+ */
+static void buzzerTicks (uint16_t ticks) {
+  while (ticks-- > 0) Buzzer.isrHandler ();
+}
+
+
+TEST (buzzerPriority) {
+  Buzzer.initialize (1);
+
+  // the alarm interrupts a key click and keeps repeating
+  Buzzer.play (BUZZER_CLICK);
+  Buzzer.play (BUZZER_ALARM);
+  buzzerTicks (1000);
+  CHECK (Buzzer.active);
+
+  // no effect while the alarm is being played
+  Buzzer.play (BUZZER_CLICK);
+  Buzzer.play (BUZZER_TIMER);
+  buzzerTicks (5000);
+  CHECK (Buzzer.active);
+  Buzzer.stop ();
+  CHECK (!Buzzer.active);
+
+  // a key click interrupts the confirmation chirp
+  Buzzer.play (BUZZER_CONFIRM);
+  Buzzer.play (BUZZER_CLICK);
+  buzzerTicks (20);
+  CHECK (!Buzzer.active);
+  Buzzer.play (BUZZER_CONFIRM);
+  buzzerTicks (20);
+  CHECK (Buzzer.active);
+  buzzerTicks (200);
+  CHECK (!Buzzer.active);
+}
@@ -0,0 +1,253 @@
+/*
+ * Host benchmarks of the firmware modules
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "host/NixieDriver.h"
+#include "DcfTrace.h"
+#include "../Calendar.h"
+#include "../DcfStream.h"
+#include "../EepromQueue.h"
+#include "../Features.h"
+#include "../Journal.h"
+#include "../Scheduler.h"
+#include <chrono>
+#include <new>
+
+/*
+ * Usage: benchmark
+ *   prints the host execution time per call of the hot paths, which tracks relative
+ *   changes only: the figures do not translate into ATmega328P cycles
+ *   followed by the anode on-times of the simulated display multiplexing
+ */
+
+
+/*
+ * Anode pins of HostNixiePins (tube 0..5)
+ */
+static const uint8_t anodePins[NIXIE_NUM_TUBES] = { 12, 11, 10, 7, 4, 2 };
+
+
+static std::chrono::steady_clock::time_point benchStart;
+static double benchNs = 0;  // accumulated time of the measured sections
+
+static void resume (void) { benchStart = std::chrono::steady_clock::now (); }
+static void pause (void) {
+  benchNs += std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now () - benchStart).count ();
+}
+
+/*
+ * Print the time per call, func () measures its own sections through resume () and pause ()
+ */
+static void bench (const char *name, uint32_t calls, void (*func)(uint32_t calls)) {
+  hostReset ();
+  benchNs = 0;
+  func (calls);
+  printf ("%-36s %10.1f ns\n", name, benchNs / calls);
+}
+
+
+/*
+ * DCF77 pulse edges of a clean minute, separated by 1 s
+ */
+static void dcfIsr (uint32_t calls) {
+  uint32_t i, ts = 0;
+  DcfStream.reset ();
+  resume ();
+  for (i = 0; i < calls / 2; i++) {
+    ts += 1000000;
+    DcfStream.start (ts);
+    DcfStream.stop (ts + ((i & 3) == 0 ? 200000 : 100000));
+  }
+  pause ();
+}
+
+/*
+ * Telegram decoding out of the votes, one call per minute
+ */
+static void dcfGetTime (uint32_t calls) {
+  DcfTrace_s trace;
+  uint32_t i, n = 0;
+  uint64_t ts;
+
+  dcfTraceSynthesize (&trace, 1700000000, calls + 1, 0, 0, 1);
+  new (&DcfStream) DcfStreamClass ();
+  for (i = 0; i < trace.edges.size (); i++) {
+    ts = trace.edges[i].us;
+    if (trace.edges[i].level == LOW) DcfStream.start ((uint32_t)ts);
+    else                             DcfStream.stop ((uint32_t)ts);
+    resume ();
+    if (DcfStream.getTime () != 1) n++;
+    pause ();
+  }
+  // getTime () returns 1 (nothing to do) after most of the edges: count the telegrams only
+  benchNs = benchNs * calls / (n > 0 ? n : 1);
+}
+
+static void calendarUpdate (uint32_t calls) {
+  uint32_t i;
+  time_t ts = 1700000000;
+  tm t;
+  for (i = 0; i < calls; i++) {
+    gmtime_r (&ts, &t);
+    resume ();
+    Calendar.update (&t, 1 + i % 7);
+    pause ();
+    ts += ONE_DAY;
+  }
+}
+
+static void calendarDstUpdate (uint32_t calls) {
+  uint32_t i;
+  resume ();
+  for (i = 0; i < calls; i++) Calendar.dstUpdate ((time_t)i * 7919 * 60);
+  pause ();
+}
+
+static void nop (void) { }
+
+static void schedulerRun (uint32_t calls) {
+  SchedulerClass s;
+  uint32_t i;
+  uint8_t t;
+  for (t = 0; t < SCHEDULER_MAX_TASKS; t++) s.add (nop, t == 0 ? 0 : 10 * t, t & 1 ? SCHEDULER_SECOND : 0);
+  for (i = 0; i < calls; i++) {
+    if (i % 1000 == 0) s.signal (SCHEDULER_SECOND);
+    hostAdvance (10);
+    resume ();
+    s.run ();
+    pause ();
+  }
+}
+
+static void journalWrite (uint32_t calls) {
+  uint8_t data[JOURNAL_MAX_DATA_SIZE] = { };
+  JournalClass j;
+  uint32_t i;
+
+  new (&EepromQueue) EepromQueueClass ();
+  j.initialize (0, 512, 512, data, sizeof (data));
+  for (i = 0; i < calls; i++) {
+    // one changed byte, the EEPROM write cycles of the queue are excluded
+    while (EepromQueue.pending () > 0) hostAdvance (1000);
+    data[i % sizeof (data)]++;
+    resume ();
+    j.write ();
+    j.loopHandler ();
+    pause ();
+  }
+}
+
+static void alarmSchedule (uint32_t calls) {
+  AlarmEeprom_s s[ALARM_NUM] = { { 7, 30, ALARM_WEEKDAYS, 1 }, { 9, 0, ALARM_WEEKENDS, 1 },
+                                 { 6, 0, ALARM_DAILY, 0 },     { 23, 59, 0x08, 1 } };
+  AlarmClass a;
+  uint32_t i;
+  time_t ts = 1700000000;
+  tm t;
+
+  a.initialize (s, ALARM_NUM);
+  for (i = 0; i < calls; i++) {
+    ts += 12345;
+    gmtime_r (&ts, &t);
+    a.reschedule ();
+    resume ();
+    a.loopHandler (ts, &t, false);
+    pause ();
+  }
+}
+
+static void nixieDec2bcd (uint32_t calls) {
+  NixieDigit_s digits[NIXIE_NUM_TUBES];
+  uint32_t i;
+  resume ();
+  for (i = 0; i < calls; i++) Nixie.dec2bcd (i * 7 % 1000000, digits, NIXIE_NUM_TUBES, 6);
+  pause ();
+}
+
+static void nixieIsr (uint32_t calls) {
+  NixieDigit_s digits[NIXIE_NUM_TUBES];
+  uint32_t i;
+
+  new (&Nixie) NixieClass ();
+  Nixie.initialize<HostNixiePins> (digits, NIXIE_NUM_TUBES);
+  Nixie.dec2bcd (123456, digits, NIXIE_NUM_TUBES, 6);
+  resume ();
+  for (i = 0; i < calls; i++) Nixie.isrHandler<HostNixiePins> ();
+  pause ();
+  TIMSK0 = 0;
+}
+
+
+/*
+ * Simulated display multiplexing: anode on-time per digit slot, sampled at every Timer0 tick
+ */
+static void displayDuty (void) {
+  static const uint16_t duty[] = { NIXIE_DUTY_MAX, 500, 100, 10, 0 };
+  NixieDigit_s digits[NIXIE_NUM_TUBES];
+  uint32_t on[NIXIE_NUM_TUBES], ticks, t;
+  uint8_t i, k;
+  volatile uint8_t *port;
+
+  printf ("\nanode on-time per %u µs digit slot, tube 0..5:\n", NIXIE_DIGIT_PERIOD);
+  for (k = 0; k < sizeof (duty) / sizeof (duty[0]); k++) {
+    hostReset ();
+    new (&Nixie) NixieClass ();
+    Nixie.initialize<HostNixiePins> (digits, NIXIE_NUM_TUBES);
+    Nixie.dec2bcd (123456, digits, NIXIE_NUM_TUBES, 6);
+    Nixie.setDuty (duty[k]);
+    hostAdvance (10 * NIXIE_DIGIT_PERIOD);
+
+    // a whole number of display cycles
+    ticks = 100 * NIXIE_NUM_TUBES * NIXIE_DIGIT_PERIOD / HOST_TIMER0_TICK_US;
+    memset (on, 0, sizeof (on));
+    for (t = 0; t < ticks; t++) {
+      hostAdvance (HOST_TIMER0_TICK_US);
+      for (i = 0; i < NIXIE_NUM_TUBES; i++) {
+        port = portOutputRegister (digitalPinToPort (anodePins[i]));
+        if (*port & digitalPinToBitMask (anodePins[i])) on[i]++;
+      }
+    }
+    printf ("duty %4u:", duty[k]);
+    for (i = 0; i < NIXIE_NUM_TUBES; i++) printf (" %5.0f", on[i] * HOST_TIMER0_TICK_US / 100.0);
+    printf (" µs\n");
+  }
+  TIMSK0 = 0;
+}
+
+
+int main (void) {
+  bench ("DcfStream.start/stop (ISR)",    2000000, dcfIsr);
+  bench ("DcfStream.getTime (telegram)",  2000,    dcfGetTime);
+  bench ("Calendar.update",               1000000, calendarUpdate);
+  bench ("Calendar.dstUpdate",            1000000, calendarDstUpdate);
+  bench ("Scheduler.run (12 tasks)",      1000000, schedulerRun);
+  bench ("Journal.write + loopHandler",   20000,   journalWrite);
+  bench ("Alarm.loopHandler (reschedule)", 1000000, alarmSchedule);
+  bench ("Nixie.dec2bcd",                 1000000, nixieDec2bcd);
+  bench ("Nixie.isrHandler (Timer0 ISR)", 1000000, nixieIsr);
+  displayDuty ();
+  return 0;
+}
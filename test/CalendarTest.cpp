@@ -0,0 +1,151 @@
+/*
+ * Calendar arithmetics unit tests
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+#include "../Calendar.h"
+
+
+/*
+ * Reference values derived from the host C library
+ */
+static time_t refUtc (int16_t year, uint8_t mon, uint8_t mday, uint8_t hour = 0) {
+  tm t = { };
+  t.tm_year = year - 1900;
+  t.tm_mon  = mon;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  return timegm (&t) - UNIX_OFFSET;  // firmware epoch: January 1st 2000
+}
+
+static uint8_t refWeekDay (int16_t year, uint8_t mon, uint8_t mday) {
+  time_t ts = refUtc (year, mon, mday) + UNIX_OFFSET;
+  tm t;
+  gmtime_r (&ts, &t);
+  return t.tm_wday;  // 0 = Sunday
+}
+
+// 01:00 UTC on the last Sunday of a month
+static time_t refLastSunday (int16_t year, uint8_t mon) {
+  uint8_t mday = Calendar.monthLength (year, mon);
+  while (refWeekDay (year, mon, mday) != 0) mday--;
+  return refUtc (year, mon, mday, 1);
+}
+
+
+TEST (calendarDays) {
+  int16_t year;
+  uint8_t mon, mday, len;
+  time_t ts;
+  tm t;
+
+  for (year = 2000; year < 2100; year++) {
+    CHECK_EQUAL (Calendar.leapYear (year), year % 4 == 0);
+    for (mon = 0; mon < 12; mon++) {
+      // the month length matches the first day of the following month
+      len = Calendar.monthLength (year, mon);
+      ts  = refUtc (year, mon, len) + UNIX_OFFSET;
+      gmtime_r (&ts, &t);
+      CHECK_EQUAL (t.tm_mon, mon);
+      ts += ONE_DAY;
+      gmtime_r (&ts, &t);
+      CHECK_EQUAL (t.tm_mday, 1);
+      for (mday = 1; mday <= len; mday++) {
+        CHECK_EQUAL ((time_t)Calendar.days (year, mon, mday) * ONE_DAY, refUtc (year, mon, mday));
+      }
+    }
+  }
+  CHECK (Calendar.leapYear (2000));
+  CHECK (!Calendar.leapYear (2100));
+  CHECK_EQUAL (Calendar.dayOfYear (2024, 11, 31), 365);
+}
+
+
+TEST (calendarIsoWeek) {
+  int16_t year;
+  uint16_t yday;
+  time_t ts;
+  tm t;
+  char buf[4];
+
+  for (year = 2000; year < 2100; year++) {
+    ts = refUtc (year, 0, 1) + UNIX_OFFSET;
+    for (yday = 0; yday < 365 + Calendar.leapYear (year); yday++, ts += ONE_DAY) {
+      gmtime_r (&ts, &t);
+      Calendar.update (&t, 1);
+      strftime (buf, sizeof (buf), "%V", &t);
+      CHECK_EQUAL (Calendar.week, atoi (buf));
+      CHECK_EQUAL (Calendar.weekDay, t.tm_wday == 0 ? 7 : t.tm_wday);
+    }
+    // December 28th always lies within the last ISO week of the year
+    ts = refUtc (year, 11, 28) + UNIX_OFFSET;
+    gmtime_r (&ts, &t);
+    strftime (buf, sizeof (buf), "%V", &t);
+    CHECK_EQUAL (Calendar.isoWeeks (year), atoi (buf));
+  }
+}
+
+
+TEST (calendarWeekStart) {
+  int16_t year;
+  uint16_t yday;
+  uint8_t weekStart, rel;
+  time_t ts;
+  tm t;
+
+  // week 1 contains January 1st, the following weeks begin on weekStart
+  for (weekStart = 2; weekStart <= 7; weekStart++) {
+    for (year = 2020; year < 2030; year++) {
+      rel = (refWeekDay (year, 0, 1) + 7 - weekStart % 7) % 7;
+      ts = refUtc (year, 0, 1) + UNIX_OFFSET;
+      for (yday = 0; yday < 365 + Calendar.leapYear (year); yday++, ts += ONE_DAY) {
+        gmtime_r (&ts, &t);
+        Calendar.update (&t, weekStart);
+        CHECK_EQUAL (Calendar.week, (yday + rel) / 7 + 1);
+      }
+    }
+  }
+}
+
+
+TEST (calendarDst) {
+  int16_t year;
+  time_t start, end;
+
+  for (year = 2000; year < 2100; year++) {
+    start = refLastSunday (year, 2);
+    end   = refLastSunday (year, 9);
+    CHECK (!Calendar.dstUpdate (start - 1));
+    CHECK_EQUAL (Calendar.dstNext, start);
+    CHECK (Calendar.dstUpdate (start));
+    CHECK_EQUAL (Calendar.dstNext, end);
+    CHECK (Calendar.dstUpdate (end - 1));
+    CHECK (!Calendar.dstUpdate (end));
+    CHECK_EQUAL (Calendar.dstNext, refLastSunday (year + 1, 2));
+    CHECK (!Calendar.dstUpdate (refUtc (year, 0, 1)));
+    CHECK (!Calendar.dstUpdate (refUtc (year, 11, 31, 23)));
+  }
+}
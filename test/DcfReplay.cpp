@@ -0,0 +1,104 @@
+/*
+ * DCF77 receiver trace replay tool
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "DcfTrace.h"
+#include <math.h>
+#include <unistd.h>
+
+/*
+ * Usage:
+ *   dcf_replay [-v] [-c <min. decoded>] [-w <max. wrong>] [-e <max. drift error ppm>] <trace file>
+ *     replay a trace file (see DcfTrace.h), - reads from stdin
+ *     fails if less than <min. decoded> times have been decoded or more than <max. wrong> are wrong
+ *     or if the drift compensated by TimeBase deviates by more than <max. drift error ppm> from the
+ *     drift of the trace, or from the least-squares estimate if the trace does not specify it
+ *   dcf_replay -s <minutes> [-n <noise %>] [-p <drift ppm>] [-r <seed>] [-t <Unix UTC time>]
+ *     write a synthetic trace to stdout
+ */
+
+
+int main (int argc, char **argv) {
+  DcfTrace_s trace;
+  DcfReplay_s result;
+  long minutes = 0, noise = 0, minDecoded = 0, maxWrong = 0;
+  unsigned long seed = 1;
+  long long start = 1679792400 - 30 * 60;  // 30 minutes before the DST transition of March 26th 2023
+  double ppm = 0, maxError = -1, ref, error;
+  bool verbose = false;
+  FILE *f;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "vc:w:e:s:n:p:r:t:")) != -1) {
+    switch (opt) {
+      case 'v': verbose = true; break;
+      case 'c': minDecoded = atol (optarg); break;
+      case 'w': maxWrong = atol (optarg); break;
+      case 'e': maxError = atof (optarg); break;
+      case 's': minutes = atol (optarg); break;
+      case 'n': noise = atol (optarg); break;
+      case 'p': ppm = atof (optarg); break;
+      case 'r': seed = strtoul (optarg, NULL, 0); break;
+      case 't': start = atoll (optarg); break;
+      default:
+        fprintf (stderr, "usage: %s [-v] [-c min_decoded] [-w max_wrong] [-e max_drift_error] <trace>\n"
+                         "       %s -s minutes [-n noise] [-p ppm] [-r seed] [-t utc]\n", argv[0], argv[0]);
+        return 2;
+    }
+  }
+
+  if (minutes > 0) {
+    dcfTraceSynthesize (&trace, (time_t)start / 60 * 60, (uint16_t)minutes, (uint8_t)noise, ppm, (uint32_t)seed);
+    dcfTraceWrite (stdout, &trace);
+    return 0;
+  }
+
+  if (optind >= argc) {
+    fprintf (stderr, "%s: no trace file\n", argv[0]);
+    return 2;
+  }
+  f = strcmp (argv[optind], "-") == 0 ? stdin : fopen (argv[optind], "r");
+  if (f == NULL || !dcfTraceRead (f, &trace)) {
+    fprintf (stderr, "%s: cannot read %s\n", argv[0], argv[optind]);
+    return 2;
+  }
+  if (f != stdin) fclose (f);
+
+  dcfTraceReplay (&trace, &result, verbose);
+  printf ("minutes=%u decoded=%u wrong=%u first=%.1fs conf=%u drift=%.2fppm edges=%u isr=%llu\n",
+          result.marks, result.decoded, result.wrong, result.firstUs * 1e-6, result.confidence,
+          result.driftPpm, result.edges, (unsigned long long)result.isrCalls);
+
+  // convergence of the drift compensation
+  ref   = trace.hasDrift ? trace.driftPpm : result.driftPpm;
+  error = result.periodPpm - ref;
+  printf ("timebase: calibrations=%u period=%.2fppm %s=%.2fppm error=%.2fppm var=%u\n", result.calibrations,
+          result.periodPpm, trace.hasDrift ? "trace" : "estimate", ref, error, result.driftVar);
+
+  if (result.decoded < (uint32_t)minDecoded || result.wrong > (uint32_t)maxWrong) return 1;
+  if (maxError >= 0 && (result.calibrations == 0 || fabs (error) > maxError)) return 1;
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Streaming DCF77 decoder unit tests
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+#include "DcfTrace.h"
+#include "../DcfStream.h"
+#include <algorithm>
+#include <math.h>
+
+
+/*
+ * Unix UTC times of the reference minute marks
+ */
+#define SPRING_FORWARD 1679790600  // 2023-03-26 00:30 UTC, 30 minutes before the DST start
+#define FALL_BACK      1698539400  // 2023-10-29 00:30 UTC, 30 minutes before the DST end
+#define NEW_YEAR       1704065400  // 2023-12-31 23:30 UTC, 00:30 CET on January 1st
+
+
+/*
+ * Remove the edges within [fromUs, toUs)
+ */
+static void cut (DcfTrace_s *trace, uint64_t fromUs, uint64_t toUs) {
+  std::vector<DcfEdge_s> e;
+  for (const DcfEdge_s &x : trace->edges) if (x.us < fromUs || x.us >= toUs) e.push_back (x);
+  trace->edges = e;
+}
+
+
+TEST (dcfStreamClean) {
+  static const time_t start[] = { SPRING_FORWARD, FALL_BACK, NEW_YEAR };
+  DcfTrace_s trace;
+  DcfReplay_s r;
+  uint8_t i;
+
+  // every telegram is decoded once two votes have been gathered: the first minute mark
+  // synchronizes the decoder, the telegram of the following minute gives the first vote
+  // the prediction does not anticipate a daylight saving time change, the flipped votes
+  // of the time zone and hour bits take three minutes to gather a majority again
+  for (i = 0; i < sizeof (start) / sizeof (start[0]); i++) {
+    dcfTraceSynthesize (&trace, start[i], 90, 0, 0, 1);
+    dcfTraceReplay (&trace, &r, false);
+    CHECK_EQUAL (r.marks, 88);
+    CHECK_EQUAL (r.decoded, r.marks - (start[i] == NEW_YEAR ? 1 : 4));
+    CHECK_EQUAL (r.wrong, 0);
+    CHECK_EQUAL (r.firstUs, 181000000);
+    CHECK_EQUAL (r.confidence, DCF_STREAM_VOTE_MAX);
+  }
+}
+
+
+TEST (dcfStreamNoise) {
+  DcfTrace_s trace;
+  DcfReplay_s r;
+  uint8_t noise;
+  uint32_t seed;
+
+  // noisy telegrams are decoded by voting, never into a wrong time
+  for (noise = 5; noise <= 20; noise += 5) {
+    for (seed = 1; seed <= 4; seed++) {
+      dcfTraceSynthesize (&trace, SPRING_FORWARD, 120, noise, 0, seed);
+      dcfTraceReplay (&trace, &r, false);
+      CHECK_EQUAL (r.wrong, 0);
+      if (noise <= 10) CHECK (r.decoded >= (noise == 5 ? 100 : 85));
+    }
+  }
+}
+
+
+TEST (dcfStreamEarlyEdge) {
+  DcfTrace_s trace;
+  DcfReplay_s r;
+
+  // a glitch 0.9 s after a pulse start must not complete the minute early
+  dcfTraceSynthesize (&trace, SPRING_FORWARD, 10, 0, 0, 1);
+  trace.edges.push_back (DcfEdge_s { 245900000, LOW });
+  trace.edges.push_back (DcfEdge_s { 245920000, HIGH });
+  std::sort (trace.edges.begin (), trace.edges.end (), [](const DcfEdge_s &a, const DcfEdge_s &b) { return a.us < b.us; });
+  dcfTraceReplay (&trace, &r, false);
+  CHECK_EQUAL (r.marks, 8);
+  CHECK_EQUAL (r.wrong, 0);
+
+  // a receiver clock running fast makes every start edge early
+  dcfTraceSynthesize (&trace, SPRING_FORWARD, 10, 0, -100, 1);
+  dcfTraceReplay (&trace, &r, false);
+  CHECK_EQUAL (r.marks, 8);
+  CHECK_EQUAL (r.decoded, 7);
+  CHECK_EQUAL (r.wrong, 0);
+}
+
+
+TEST (dcfStreamDroppedMinute) {
+  DcfTrace_s trace;
+  DcfReplay_s r;
+
+  // the votes remain aligned across a minute lost by resynchronization
+  dcfTraceSynthesize (&trace, SPRING_FORWARD, 20, 0, 0, 1);
+  cut (&trace, 400000000, 470000000);
+  dcfTraceReplay (&trace, &r, false);
+  CHECK_EQUAL (r.wrong, 0);
+  CHECK_EQUAL (r.decoded, 15);
+}
+
+
+TEST (dcfStreamDrift) {
+  static const double ppm[] = { 0, 50, -30, 200 };
+  DcfTrace_s trace;
+  DcfReplay_s r;
+  uint8_t i;
+
+  // the drift is estimated out of the phase of the second edges relative to the system second
+  for (i = 0; i < sizeof (ppm) / sizeof (ppm[0]); i++) {
+    dcfTraceSynthesize (&trace, SPRING_FORWARD, 60, 5, ppm[i], 3);
+    dcfTraceReplay (&trace, &r, false);
+    CHECK (fabs (r.driftPpm - ppm[i]) < 0.5);
+    CHECK (r.edges > 3000);
+    CHECK_EQUAL (r.wrong, 0);
+  }
+}
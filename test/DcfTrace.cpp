@@ -0,0 +1,282 @@
+/*
+ * DCF77 receiver trace synthesis and replay
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "DcfTrace.h"
+#include "../Calendar.h"
+#include "../DcfCapture.h"
+#include "../DcfStream.h"
+#include <math.h>
+#include <new>
+
+
+#define PULSE_0_US  100000   // bit value 0
+#define PULSE_1_US  200000   // bit value 1
+#define GLITCH_US   20000    // duration of a noise pulse
+#define MAX_PHASE_STEP 20000 // maximum deviation of a second edge from the preceding ones in µs
+
+
+/*
+ * Deterministic pseudo random numbers
+ */
+static uint32_t randomNext (uint32_t *state) {
+  *state = *state * 1103515245 + 12345;
+  return *state >> 8;
+}
+
+
+/*
+ * Number of minutes between two minute marks
+ */
+static time_t minutesBetween (uint64_t fromUs, uint64_t toUs) {
+  return (time_t)(((int64_t)(toUs - fromUs) + 30000000) / 60000000);
+}
+
+
+/*
+ * DCF77 telegram of a local time
+ */
+static void telegram (const tm *t, bool summer, uint32_t *rnd, uint8_t *bits) {
+  uint8_t i, p;
+
+  for (i = 0; i < 60; i++) bits[i] = 0;
+  for (i = 1; i < 16; i++) bits[i] = randomNext (rnd) & 1;  // weather and call bits
+
+  #define BCD(FIRST, LEN, VALUE) { uint8_t b = (((VALUE) / 10) << 4) | ((VALUE) % 10); \
+    for (i = 0; i < (LEN); i++) bits[(FIRST) + i] = (b >> i) & 1; }
+
+  bits[17] = summer;
+  bits[18] = !summer;
+  bits[20] = 1;
+  BCD (21, 7, t->tm_min);
+  BCD (29, 6, t->tm_hour);
+  BCD (36, 6, t->tm_mday);
+  BCD (42, 3, t->tm_wday == 0 ? 7 : t->tm_wday);
+  BCD (45, 5, t->tm_mon + 1);
+  BCD (50, 8, t->tm_year - 100);
+
+  #undef BCD
+
+  for (i = 21, p = 0; i < 28; i++) p ^= bits[i];
+  bits[28] = p;
+  for (i = 29, p = 0; i < 35; i++) p ^= bits[i];
+  bits[35] = p;
+  for (i = 36, p = 0; i < 58; i++) p ^= bits[i];
+  bits[58] = p;
+}
+
+
+void dcfTraceSynthesize (DcfTrace_s *trace, time_t startUtc, uint16_t minutes, uint8_t noise, double driftPpm, uint32_t seed) {
+  uint32_t rnd = seed;
+  uint8_t bits[60], s, kind;
+  uint16_t m;
+  uint64_t us, width;
+  double scale = 1.0 + driftPpm * 1e-6;
+  time_t utc, local;
+  bool summer;
+  tm t;
+
+  #define EDGE(US, LEVEL) trace->edges.push_back (DcfEdge_s { (uint64_t)((US) * scale), (LEVEL) })
+
+  trace->edges.clear ();
+  trace->startUtc = startUtc;
+  trace->startUs  = (uint64_t)(1000000 * scale);
+  trace->hasDrift = true;
+  trace->driftPpm = driftPpm;
+
+  for (m = 0; m < minutes; m++) {
+    // the telegram transmitted during a minute carries the time of the following minute
+    utc    = startUtc + (time_t)(m + 1) * 60;
+    summer = Calendar.dstUpdate (utc - UNIX_OFFSET);
+    local  = utc + (summer ? 2 : 1) * ONE_HOUR;
+    gmtime_r (&local, &t);
+    telegram (&t, summer, &rnd, bits);
+
+    for (s = 0; s < 59; s++) {
+      us    = trace->startUs + ((uint64_t)m * 60 + s) * 1000000;
+      width = bits[s] ? PULSE_1_US : PULSE_0_US;
+      kind  = randomNext (&rnd) % 100 < noise ? randomNext (&rnd) % 3 : 3;
+      if (kind == 0) continue;                           // missing pulse
+      if (kind == 1) width = PULSE_0_US + PULSE_1_US - width;  // wrong pulse width
+      EDGE (us, LOW);
+      EDGE (us + width, HIGH);
+      if (kind == 2) {                                   // glitch within the rest of the second
+        us += width + GLITCH_US + randomNext (&rnd) % (1000000 - width - 3 * GLITCH_US);
+        EDGE (us, LOW);
+        EDGE (us + GLITCH_US, HIGH);
+      }
+    }
+  }
+
+  #undef EDGE
+}
+
+
+bool dcfTraceRead (FILE *f, DcfTrace_s *trace) {
+  char line[128];
+  unsigned long long us;
+  long long utc;
+  unsigned level;
+  double ppm;
+
+  trace->edges.clear ();
+  trace->startUtc = 0;
+  trace->startUs  = 0;
+  trace->hasDrift = false;
+
+  while (fgets (line, sizeof (line), f) != NULL) {
+    if (line[0] == '#') {
+      if (sscanf (line, "# start %lld %llu", &utc, &us) == 2) {
+        trace->startUtc = (time_t)utc;
+        trace->startUs  = us;
+      }
+      if (sscanf (line, "# drift %lf", &ppm) == 1) {
+        trace->hasDrift = true;
+        trace->driftPpm = ppm;
+      }
+      continue;
+    }
+    if (line[0] == '\n' || line[0] == '\r') continue;
+    if (sscanf (line, "%llu %u", &us, &level) != 2 || level > 1) return false;
+    if (!trace->edges.empty () && us < trace->edges.back ().us) return false;
+    trace->edges.push_back (DcfEdge_s { us, (uint8_t)level });
+  }
+  return true;
+}
+
+
+void dcfTraceWrite (FILE *f, const DcfTrace_s *trace) {
+  fprintf (f, "# DCF77 receiver trace: <µs> <level>\n");
+  if (trace->startUtc != 0) fprintf (f, "# start %lld %llu\n", (long long)trace->startUtc, (unsigned long long)trace->startUs);
+  if (trace->hasDrift) fprintf (f, "# drift %.3f\n", trace->driftPpm);
+  for (const DcfEdge_s &e : trace->edges) fprintf (f, "%llu %u\n", (unsigned long long)e.us, e.level);
+}
+
+
+void dcfTraceReplay (const DcfTrace_s *trace, DcfReplay_s *result, bool verbose) {
+  uint64_t nextTick = 1000000, markUs, lastMarkUs = 0, lastUs = 0, syncUs = 0;
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0, x, y, phase, last = 0, offsetUs;
+  time_t utc, expected, lastUtc = 0, syncUtc = 0;
+  uint32_t timerPeriod = TIMER_DEFAULT_PERIOD;
+  uint32_t phaseUs;
+  time_t edgeTime;
+  uint8_t rv;
+  size_t i;
+
+  *result = DcfReplay_s ();
+  hostReset ();
+  new (&DcfStream) DcfStreamClass ();
+  new (&DcfCapture) DcfCaptureClass ();
+  pinMode (DCF_TRACE_PIN, INPUT);
+  hostPinWrite (DCF_TRACE_PIN, HIGH);
+  DcfCapture.initialize (DCF_TRACE_PIN, DCF_TRACE_START_EDGE);
+  new (&TimeBase) TimeBaseClass ();
+  TimeBase.initialize (&timerPeriod, 1);
+
+  for (i = 0; i < trace->edges.size (); i++) {
+    const DcfEdge_s &e = trace->edges[i];
+
+    // system second ticks up to the edge
+    while (nextTick <= e.us) {
+      hostAdvance ((uint32_t)(nextTick - hostMicros ()));
+      DcfCapture.secondTick ();
+      nextTick += 1000000;
+    }
+    hostAdvance ((uint32_t)(e.us - hostMicros ()));
+    hostPinWrite (DCF_TRACE_PIN, e.level);
+    result->isrCalls++;
+
+    // drift estimation out of the phase of the second edges relative to the system second tick
+    if (e.level == LOW && DcfCapture.read (&edgeTime, &phaseUs, 1000)) {
+      phase = phaseUs;
+      if (n > 0) {
+        while (phase - last >  500000) phase -= 1000000;
+        while (phase - last < -500000) phase += 1000000;
+      }
+      if (n == 0 || fabs (phase - last) < MAX_PHASE_STEP + (e.us - lastUs) * 1e-4) {
+        x = e.us * 1e-6;
+        y = phase;
+        n++; sx += x; sy += y; sxx += x * x; sxy += x * y;
+        last   = phase;
+        lastUs = e.us;
+      }
+    }
+
+    // main loop
+    rv = DcfStream.getTime ();
+    if (rv == 1) continue;
+    result->marks++;
+    if (rv != 0) continue;
+
+    // the decoded time refers to the latest minute mark, DcfStream.markDelay seconds before the edge
+    markUs = e.us;
+    tm t = DcfStream.currentTm;
+    utc = mk_gmtime (&t) - t.tm_isdst;
+    if (trace->startUtc != 0) {
+      expected = trace->startUtc + minutesBetween (trace->startUs, markUs) * 60;
+    }
+    else if (result->decoded > 0) {
+      expected = lastUtc + minutesBetween (lastMarkUs, markUs) * 60;
+    }
+    else {
+      expected = utc;
+    }
+    if (utc != expected) result->wrong++;
+    if (result->decoded == 0) result->firstUs = markUs;
+    result->decoded++;
+    result->confidence = DcfStream.confidence;
+    lastUtc    = utc;
+    lastMarkUs = markUs;
+
+    // synchronization: the first one sets the Timer1 clock, the following ones calibrate it,
+    // the time of the edge delivering the telegram is used like by syncToDcf ()
+    utc += DcfStream.markDelay;
+    if (syncUtc == 0) {
+      syncUtc = utc;
+      syncUs  = markUs;
+    }
+    else if (utc - syncUtc > DCF_TRACE_SYNC_INTERVAL) {
+      // the Timer1 clock counts one second every timerPeriod / TIMER1_DIVIDER µs of receiver clock time
+      offsetUs = (double)(markUs - syncUs) * TIMER_DEFAULT_PERIOD / timerPeriod - (double)(utc - syncUtc) * 1e6;
+      if (fabs (offsetUs) < 60e6) {
+        TimeBase.calibrate (utc - syncUtc, (int32_t)lround (offsetUs));
+        result->calibrations++;
+      }
+      syncUtc = utc;
+      syncUs  = markUs;
+    }
+    if (verbose) {
+      printf ("%10llu %04d-%02d-%02d %02d:%02d %s conf=%u%s\n", (unsigned long long)markUs, t.tm_year + 1900, t.tm_mon + 1,
+              t.tm_mday, t.tm_hour, t.tm_min, DcfStream.cest ? "CEST" : "CET ", DcfStream.confidence, utc != expected ? " WRONG" : "");
+    }
+  }
+
+  // least-squares slope of the phase in µs per second equals the drift in ppm
+  if (n >= 2 && n * sxx - sx * sx > 0) result->driftPpm = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+  result->edges = (uint32_t)n;
+  result->periodPpm = ((double)timerPeriod - TIMER_DEFAULT_PERIOD) / TIMER1_DIVIDER;
+  result->driftVar  = TimeBase.driftVar;
+}
@@ -0,0 +1,123 @@
+/*
+ * DCF77 receiver trace synthesis and replay
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __DCF_TRACE_H
+#define __DCF_TRACE_H
+
+#include "host/Host.h"
+#include "../TimeBase.h"
+#include <stdio.h>
+#include <vector>
+
+/*
+ * DCF77 receiver pin and start edge, as configured in nixie-clock.ino
+ * the receiver output is HIGH while idle and LOW during the carrier reduction
+ */
+#define DCF_TRACE_PIN        3
+#define DCF_TRACE_START_EDGE FALLING
+
+/*
+ * Minimum time between two drift calibrations in s (as required by syncToDcf ())
+ */
+#define DCF_TRACE_SYNC_INTERVAL 1800
+
+/*
+ * Trace file format (text, one entry per line):
+ *   <µs> <level>            : the receiver pin changes to level (0 or 1) at the given
+ *                             receiver clock time, entries are sorted by time
+ *   # start <utc> <µs>      : optional, Unix UTC time of the minute mark at the given
+ *                             receiver clock time, used for checking the decoded times
+ *   # drift <ppm>           : optional, drift of the receiver clock, used for checking
+ *                             the drift compensation
+ *   # <comment>
+ */
+struct DcfEdge_s {
+  uint64_t us;
+  uint8_t  level;
+};
+
+struct DcfTrace_s {
+  std::vector<DcfEdge_s> edges;
+  time_t   startUtc = 0;  // Unix UTC time of the reference minute mark, 0 if unknown
+  uint64_t startUs  = 0;  // receiver clock time of the reference minute mark
+  bool     hasDrift = false;
+  double   driftPpm = 0;  // drift of the receiver clock, valid if hasDrift
+};
+
+/*
+ * Replay statistics
+ */
+struct DcfReplay_s {
+  uint32_t marks      = 0;  // complete minutes seen by the decoder
+  uint32_t decoded    = 0;  // times returned by DcfStream.getTime ()
+  uint32_t wrong      = 0;  // decoded times contradicting the reference or the previous decoded time
+  uint64_t firstUs    = 0;  // receiver clock time of the first decoded time
+  uint8_t  confidence = 0;  // confidence of the last decoded time
+  double   driftPpm   = 0;  // drift of the receiver clock relative to the DCF77 seconds
+  uint32_t edges      = 0;  // second edges used for the drift estimation
+  uint64_t isrCalls   = 0;  // calls to the pin change interrupt handler
+  uint32_t calibrations = 0;  // TimeBase.calibrate () calls
+  double   periodPpm  = 0;  // drift compensated by TimeBase through the timer period
+  uint32_t driftVar   = 0;  // TimeBase.driftVar after the last calibration
+};
+
+/*
+ * Synthesize a trace
+ * Parameters:
+ *   trace    : returns the trace
+ *   startUtc : Unix UTC time of the first minute mark
+ *   minutes  : trace duration in minutes
+ *   noise    : percentage of the seconds having a missing pulse, a glitch or a wrong pulse width
+ *   driftPpm : the receiver clock runs fast by driftPpm
+ *   seed     : random seed
+ */
+void dcfTraceSynthesize (DcfTrace_s *trace, time_t startUtc, uint16_t minutes, uint8_t noise, double driftPpm, uint32_t seed);
+
+/*
+ * Read and write a trace file
+ * Return value:
+ *   false upon a syntax error
+ */
+bool dcfTraceRead (FILE *f, DcfTrace_s *trace);
+void dcfTraceWrite (FILE *f, const DcfTrace_s *trace);
+
+/*
+ * Replay a trace through the DCF77 edge capture and the streaming decoder
+ * the mocked microcontroller is reset, the system second ticks every 1000000 µs
+ * of receiver clock time
+ * the drift compensation is fed like by syncToDcf () with the offset of a Timer1 clock
+ * running at TimeBase.timerPeriod, the synchronization interval being shortened to
+ * DCF_TRACE_SYNC_INTERVAL in order to fit several calibrations into a trace
+ * Parameters:
+ *   trace   : trace to be replayed
+ *   result  : returns the statistics
+ *   verbose : print every decoded time to stdout
+ */
+void dcfTraceReplay (const DcfTrace_s *trace, DcfReplay_s *result, bool verbose);
+
+
+#endif // __DCF_TRACE_H
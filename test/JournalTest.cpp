@@ -0,0 +1,220 @@
+/*
+ * Journaled EEPROM storage unit tests
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+#include "../EepromQueue.h"
+#include "../Journal.h"
+#include <new>
+
+
+/*
+ * EEPROM layout of the test cases
+ */
+#define BASE_ADDR     0
+#define JOURNAL_ADDR  64
+#define JOURNAL_SLOTS 8
+#define JOURNAL_SIZE  (3 + JOURNAL_SLOTS * 4)
+#define DATA_SIZE     16
+
+
+/*
+ * Restart the firmware after a reset or a power cut: the RAM contents are lost
+ */
+static void powerUp (JournalClass *j, uint8_t *data) {
+  new (&EepromQueue) EepromQueueClass ();
+  new (j) JournalClass ();
+  memset (data, 0, DATA_SIZE);
+  j->initialize (BASE_ADDR, JOURNAL_ADDR, JOURNAL_SIZE, data, DATA_SIZE);
+}
+
+/*
+ * Let the EEPROM write queue commit all the pending writes
+ */
+static void drain (void) {
+  while (EepromQueue.pending () > 0) hostAdvance (1000);
+  hostAdvance (HOST_EEPROM_WRITE_US);
+}
+
+/*
+ * Power cut after the given number of µs, optionally leaving the interrupted cell erased
+ */
+static void cutAfter (uint32_t us, bool erased) {
+  hostAdvance (us);
+  if (hostPowerCut () && erased) hostEeprom ()[EEAR] = 0xFF;
+}
+
+
+TEST (journalWriteReplay) {
+  JournalClass j;
+  uint8_t data[DATA_SIZE], ref[DATA_SIZE];
+  uint8_t i;
+
+  // first-time boot formats the journal
+  powerUp (&j, data);
+  drain ();
+  for (i = 0; i < DATA_SIZE; i++) data[i] = ref[i] = i * 3;
+  j.write ();
+  drain ();
+
+  powerUp (&j, data);
+  CHECK (memcmp (data, ref, DATA_SIZE) == 0);
+
+  // unchanged bytes are not journaled
+  uint32_t writes = hostEepromWrites ();
+  j.write ();
+  drain ();
+  CHECK_EQUAL (hostEepromWrites (), writes);
+
+  data[5] = ref[5] = 0xAA;
+  j.write ();
+  drain ();
+  powerUp (&j, data);
+  CHECK (memcmp (data, ref, DATA_SIZE) == 0);
+}
+
+
+TEST (journalCompaction) {
+  JournalClass j;
+  uint8_t data[DATA_SIZE], ref[DATA_SIZE];
+  uint16_t n;
+
+  powerUp (&j, data);
+  memcpy (ref, data, DATA_SIZE);
+  drain ();
+
+  // background compaction through loopHandler () and immediate compaction when running full
+  for (n = 0; n < 300; n++) {
+    data[n % DATA_SIZE] = ref[n % DATA_SIZE] = n;
+    data[(n * 7) % DATA_SIZE] = ref[(n * 7) % DATA_SIZE] = n >> 1;
+    j.write ();
+    if (n % 5 != 0) j.loopHandler ();
+    drain ();
+    if (n % 7 == 0) {
+      powerUp (&j, data);
+      CHECK (memcmp (data, ref, DATA_SIZE) == 0);
+    }
+  }
+}
+
+
+TEST (journalPowerCutWrite) {
+  JournalClass j;
+  uint8_t data[DATA_SIZE], old[DATA_SIZE], ref[DATA_SIZE];
+  uint8_t i, step, variant;
+  bool prefix;
+
+  // the changed bytes are journaled in ascending order, an interrupted update must
+  // restore the new values of a prefix of them and the old values of the others
+  for (variant = 0; variant < 2; variant++) {
+    for (step = 0; step <= 66; step++) {
+      hostReset ();
+      powerUp (&j, data);
+      for (i = 0; i < DATA_SIZE; i++) data[i] = old[i] = 0x10 + i;
+      j.write ();
+      drain ();
+      memcpy (ref, old, DATA_SIZE);
+      for (i = 0; i < 5; i++) data[i * 3] = ref[i * 3] = 0xC0 + i;
+      j.write ();
+      cutAfter (step * (HOST_EEPROM_WRITE_US / 3), variant == 1);
+
+      powerUp (&j, data);
+      prefix = true;
+      for (i = 0; i < DATA_SIZE; i++) {
+        CHECK (data[i] == old[i] || data[i] == ref[i]);
+        if (ref[i] == old[i]) continue;
+        if (data[i] == ref[i]) CHECK (prefix);
+        else                   prefix = false;
+      }
+      // 5 records of 4 bytes take 20 write cycles
+      if (step == 66) CHECK (memcmp (data, ref, DATA_SIZE) == 0);
+    }
+  }
+}
+
+
+TEST (journalPowerCutCompaction) {
+  JournalClass j;
+  uint8_t data[DATA_SIZE], ref[DATA_SIZE];
+  uint8_t i, step, variant;
+  uint64_t start;
+
+  // an interrupted compaction must not lose any committed record
+  for (variant = 0; variant < 2; variant++) {
+    for (step = 0; step <= 48; step++) {
+      hostReset ();
+      powerUp (&j, data);
+      drain ();
+      for (i = 0; i < JOURNAL_SLOTS - 1; i++) data[i] = 0x50 + i;
+      memcpy (ref, data, DATA_SIZE);
+      j.write ();
+      drain ();
+
+      // background compaction, one byte write per main loop pass:
+      // 7 bytes of the base copy and 3 bytes of the header take 10 write cycles
+      start = hostMicros ();
+      while (hostMicros () - start < step * (HOST_EEPROM_WRITE_US / 4)) {
+        j.loopHandler ();
+        hostAdvance (500);
+      }
+      if (step == 48) CHECK_EQUAL (hostEeprom ()[JOURNAL_ADDR], 1);
+      cutAfter (0, variant == 1);
+
+      powerUp (&j, data);
+      CHECK (memcmp (data, ref, DATA_SIZE) == 0);
+    }
+  }
+}
+
+
+TEST (journalEpochWrap) {
+  JournalClass j;
+  uint8_t data[DATA_SIZE], ref[DATA_SIZE];
+  uint8_t k;
+  uint16_t n, wraps = 0;
+
+  powerUp (&j, data);
+  memcpy (ref, data, DATA_SIZE);
+  drain ();
+
+  // every compaction starts a new epoch, the journal is formatted when the epoch wraps around
+  for (n = 0; n < 600; n++) {
+    data[n % DATA_SIZE] = ref[n % DATA_SIZE] = n ^ 0x5A;
+    data[(n + 1) % DATA_SIZE] = ref[(n + 1) % DATA_SIZE] = n;
+    j.write ();
+    for (k = 0; k < 2 * DATA_SIZE; k++) {
+      j.loopHandler ();
+      hostAdvance (HOST_EEPROM_WRITE_US);
+    }
+    drain ();
+    if (hostEeprom ()[JOURNAL_ADDR] == 0) wraps++;
+    if (n % 11 == 0 || hostEeprom ()[JOURNAL_ADDR] <= 1) {
+      powerUp (&j, data);
+      CHECK (memcmp (data, ref, DATA_SIZE) == 0);
+    }
+  }
+  CHECK (wraps > 0);
+}
@@ -0,0 +1,104 @@
+/*
+ * Nixie tube display driver unit tests
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+#include "../Nixie.h"
+#include <new>
+
+
+/*
+ * Pin map passed to the runtime NixieClass::initialize (), same as nixie-clock.ino
+ */
+static const uint8_t anodePins[NIXIE_NUM_TUBES] = { 12, 11, 10, 7, 4, 2 };
+static const uint8_t bcdPins[4] = { 9, 6, 5, 8 };
+static const uint8_t commaPin = 13;
+
+static NixieDigit_s digits[NIXIE_NUM_TUBES];
+
+/*
+ * Output level of a pin written through its port register
+ */
+static bool pinLevel (uint8_t pin) {
+  return (*portOutputRegister (digitalPinToPort (pin)) & digitalPinToBitMask (pin)) != 0;
+}
+
+static void runtimeInitialize (void) {
+  new (&Nixie) NixieClass ();
+  Nixie.initialize (anodePins[0], anodePins[1], anodePins[2], anodePins[3], anodePins[4], anodePins[5],
+                    bcdPins[0], bcdPins[1], bcdPins[2], bcdPins[3], commaPin, digits, NIXIE_NUM_TUBES);
+  Nixie.dec2bcd (123456, digits, NIXIE_NUM_TUBES, 6);
+}
+
+
+TEST (nixieRuntimeMultiplex) {
+  uint32_t on[NIXIE_NUM_TUBES] = { }, ticks, t;
+  uint8_t i, bcd, lit, tube = 0;
+  bool overlap = false, mismatch = false;
+
+  runtimeInitialize ();
+  hostAdvance (10 * NIXIE_DIGIT_PERIOD);
+
+  // sample the pins at every Timer0 tick during a whole number of display cycles
+  ticks = 100 * NIXIE_NUM_TUBES * NIXIE_DIGIT_PERIOD / HOST_TIMER0_TICK_US;
+  for (t = 0; t < ticks; t++) {
+    hostAdvance (HOST_TIMER0_TICK_US);
+    for (i = 0, lit = 0; i < NIXIE_NUM_TUBES; i++) {
+      if (pinLevel (anodePins[i])) {
+        on[i]++;
+        lit++;
+        tube = i;
+      }
+    }
+    if (lit > 1) overlap = true;
+    if (lit == 1) {
+      for (i = 0, bcd = 0; i < 4; i++) if (pinLevel (bcdPins[i])) bcd |= 1 << i;
+      if (bcd != digits[tube].value) mismatch = true;
+    }
+  }
+  CHECK (!overlap);   // one anode at a time
+  CHECK (!mismatch);  // the BCD pins are settled while the anode is on
+  for (i = 0; i < NIXIE_NUM_TUBES; i++) {
+    // full duty cycle: on during most of the digit slot
+    CHECK (on[i] * HOST_TIMER0_TICK_US / 100 > NIXIE_DIGIT_PERIOD * 3 / 4);
+    CHECK (on[i] * HOST_TIMER0_TICK_US / 100 < NIXIE_DIGIT_PERIOD);
+  }
+  TIMSK0 = 0;
+}
+
+
+TEST (nixieRuntimeBlank) {
+  uint8_t i;
+
+  runtimeInitialize ();
+  digits[0].comma = true;
+  hostAdvance (10 * NIXIE_DIGIT_PERIOD);
+  Nixie.blank ();
+  for (i = 0; i < NIXIE_NUM_TUBES; i++) CHECK (!pinLevel (anodePins[i]));
+  for (i = 0; i < 4; i++) CHECK (!pinLevel (bcdPins[i]));
+  CHECK (!pinLevel (commaPin));
+  TIMSK0 = 0;
+}
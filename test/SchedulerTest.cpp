@@ -0,0 +1,129 @@
+/*
+ * Task scheduler unit tests
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+#include "../Scheduler.h"
+
+
+static uint32_t runs[SCHEDULER_MAX_TASKS + 1];
+
+static void task0 (void) { runs[0]++; }
+static void task1 (void) { runs[1]++; }
+static void task2 (void) { runs[2]++; }
+static void task3 (void) { runs[3]++; }
+
+/*
+ * Execute the scheduler once per ms during the given number of ms
+ */
+static void runFor (SchedulerClass *s, uint32_t ms) {
+  while (ms-- > 0) {
+    hostAdvance (1000);
+    s->run ();
+  }
+}
+
+
+TEST (schedulerPeriod) {
+  SchedulerClass s;
+
+  memset (runs, 0, sizeof (runs));
+  CHECK (s.add (task0, 10));
+  CHECK (s.add (task1, 250));
+  CHECK (s.add (task2, 0));
+  runFor (&s, 1000);
+  CHECK_EQUAL (runs[0], 100);
+  CHECK_EQUAL (runs[1], 4);
+  CHECK_EQUAL (runs[2], 1000);  // period 0: executed on every pass
+}
+
+
+TEST (schedulerEvents) {
+  SchedulerClass s;
+
+  memset (runs, 0, sizeof (runs));
+  s.add (task0, 0, SCHEDULER_SECOND);
+  s.add (task1, 0, SCHEDULER_INPUT | SCHEDULER_TENTH);
+  s.add (task2, 1000, SCHEDULER_INPUT);
+  runFor (&s, 100);
+  CHECK_EQUAL (runs[0], 0);  // period 0 with events: only executed upon an event
+  CHECK_EQUAL (runs[1], 0);
+  CHECK_EQUAL (runs[2], 0);
+
+  s.signal (SCHEDULER_SECOND);
+  s.run ();
+  CHECK_EQUAL (runs[0], 1);
+  CHECK_EQUAL (runs[1], 0);
+
+  s.signal (SCHEDULER_TENTH);
+  s.signal (SCHEDULER_INPUT);
+  s.run ();
+  s.run ();  // the events are consumed by a single pass
+  CHECK_EQUAL (runs[0], 1);
+  CHECK_EQUAL (runs[1], 1);
+  CHECK_EQUAL (runs[2], 1);
+
+  // an event restarts the period (every scheduler pass takes a few µs)
+  runFor (&s, 990);
+  CHECK_EQUAL (runs[2], 1);
+  runFor (&s, 20);
+  CHECK_EQUAL (runs[2], 2);
+}
+
+
+TEST (schedulerTableFull) {
+  SchedulerClass s;
+  uint8_t i;
+
+  memset (runs, 0, sizeof (runs));
+  for (i = 0; i < SCHEDULER_MAX_TASKS; i++) CHECK (s.add (task3, 0));
+  CHECK (!s.add (task0, 0));
+  s.run ();
+  CHECK_EQUAL (runs[3], SCHEDULER_MAX_TASKS);
+  CHECK_EQUAL (runs[0], 0);
+}
+
+
+TEST (schedulerMillisWrap) {
+  SchedulerClass s;
+
+  // the task time stamps are 16 bits wide
+  hostAdvance (65000000);
+  memset (runs, 0, sizeof (runs));
+  s.add (task0, 1000);
+  runFor (&s, 2000);
+  CHECK_EQUAL (runs[0], 2);
+  CHECK ((uint16_t)millis () < 2000);
+
+  // the 32 bit millis () counter wraps after 49 days
+  while (hostMicros () + 1000000000 < 0xFFFFFFFFULL * 1000) hostAdvance (1000000000);
+  hostAdvance (0xFFFFFFFFULL * 1000 - hostMicros () - 500000);
+  s.run ();
+  runs[0] = 0;
+  runFor (&s, 5000);
+  CHECK (millis () < 5000);
+  CHECK_EQUAL (runs[0], 5);
+}
@@ -0,0 +1,73 @@
+/*
+ * Minimal unit test framework for the host build
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __TEST_H
+#define __TEST_H
+
+#include "host/Host.h"
+#include <stdio.h>
+
+/*
+ * Define a test case, test cases are executed in the order of definition
+ * within a source file, the mocked microcontroller is reset before each test case
+ */
+#define TEST(NAME) \
+  static void NAME (void); \
+  static TestCase NAME##Case (#NAME, NAME); \
+  static void NAME (void)
+
+/*
+ * Record a failure if the condition does not hold, the test case continues
+ */
+#define CHECK(COND) testCheck ((COND), #COND, __FILE__, __LINE__)
+
+/*
+ * Record a failure if the integer values differ, printing both values
+ */
+#define CHECK_EQUAL(ACTUAL, EXPECTED) \
+  testCheckEqual ((long long)(ACTUAL), (long long)(EXPECTED), #ACTUAL, #EXPECTED, __FILE__, __LINE__)
+
+
+/*
+ * Test case registration
+ */
+class TestCase {
+  public:
+    TestCase (const char *name, void (*func)(void));
+    static int runAll (const char *filter);  // returns the number of failed test cases
+  private:
+    const char *name;
+    void (*func)(void);
+    TestCase *next = NULL;
+};
+
+bool testCheck (bool cond, const char *expr, const char *file, int line);
+bool testCheckEqual (long long actual, long long expected, const char *actualExpr, const char *expectedExpr,
+                     const char *file, int line);
+
+
+#endif // __TEST_H
@@ -0,0 +1,87 @@
+/*
+ * Unit test runner of the host build
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+
+/*
+ * Usage: host_tests [name filter]
+ */
+
+
+static TestCase *first = NULL;
+static TestCase *last  = NULL;
+static uint32_t failures = 0;  // failed checks of the current test case
+
+
+TestCase::TestCase (const char *name, void (*func)(void)) : name (name), func (func) {
+  if (last == NULL) first = this;
+  else              last->next = this;
+  last = this;
+}
+
+
+int TestCase::runAll (const char *filter) {
+  TestCase *t;
+  int run = 0, failed = 0;
+
+  for (t = first; t != NULL; t = t->next) {
+    if (filter != NULL && strstr (t->name, filter) == NULL) continue;
+    hostReset ();
+    failures = 0;
+    t->func ();
+    run++;
+    if (failures > 0) failed++;
+    printf ("%-40s %s\n", t->name, failures > 0 ? "FAILED" : "ok");
+  }
+  printf ("%d of %d test cases passed\n", run - failed, run);
+  return failed;
+}
+
+
+bool testCheck (bool cond, const char *expr, const char *file, int line) {
+  if (!cond) {
+    // limit the output of checks inside loops
+    if (failures < 10) printf ("%s:%d: check failed: %s\n", file, line, expr);
+    failures++;
+  }
+  return cond;
+}
+
+
+bool testCheckEqual (long long actual, long long expected, const char *actualExpr, const char *expectedExpr,
+                     const char *file, int line) {
+  if (actual != expected) {
+    if (failures < 10) printf ("%s:%d: %s == %lld, expected %s == %lld\n", file, line, actualExpr, actual, expectedExpr, expected);
+    failures++;
+  }
+  return actual == expected;
+}
+
+
+int main (int argc, char **argv) {
+  return TestCase::runAll (argc > 1 ? argv[1] : NULL) == 0 ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/*
+ * Time base and drift compensation unit tests
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.h"
+#include "../TimeBase.h"
+#include <math.h>
+#include <new>
+
+
+/*
+ * Timer1 ticks of the phase accumulator of timer1ISR () during the given number of ticks in µs
+ */
+static uint64_t tickSum (uint32_t ticks) {
+  uint32_t phase = 0;
+  uint64_t sum = 0;
+
+  while (ticks-- > 0) {
+    phase += TimeBase.tickPhaseInc;
+    if (phase >= TimeBase.tickPhaseMod) {
+      phase -= TimeBase.tickPhaseMod;
+      sum += TimeBase.tickPeriodHigh;
+    }
+    else {
+      sum += TimeBase.tickPeriodLow;
+    }
+  }
+  return sum;
+}
+
+/*
+ * Offset of a clock running at timerPeriod after the given number of seconds, the crystal
+ * running fast by driftPpm
+ */
+static int32_t offsetUs (uint32_t timerPeriod, double driftPpm, uint32_t seconds) {
+  return (int32_t)lround (seconds * (TIMER_DEFAULT_PERIOD * (1 + driftPpm * 1e-6) / timerPeriod - 1) * 1e6);
+}
+
+
+TEST (timeBaseTicks) {
+  static const uint32_t period[] = { TIMER_DEFAULT_PERIOD, TIMER_DEFAULT_PERIOD + 3201, TIMER_DEFAULT_PERIOD - 77 };
+  uint32_t timerPeriod, step;
+  uint8_t i;
+
+  new (&TimeBase) TimeBaseClass ();
+  for (step = 1; step <= 8; step *= 2) {
+    for (i = 0; i < sizeof (period) / sizeof (period[0]); i++) {
+      timerPeriod = period[i];
+      TimeBase.initialize (&timerPeriod, step);
+      CHECK_EQUAL (TimeBase.timerPeriodUs * TIMER1_DIVIDER + TimeBase.timerPeriodFract, timerPeriod);
+      CHECK_EQUAL (TimeBase.tickPeriodHigh - TimeBase.tickPeriodLow, step);
+      // the average tick period equals timerPeriod / (TIMER1_DIVIDER * TIMER1_TICKS) within one step
+      CHECK (llabs ((long long)tickSum (TIMER1_DIVIDER * TIMER1_TICKS) - timerPeriod) <= step);
+    }
+  }
+
+  // the timer period is kept within its limits
+  timerPeriod = TIMER_MAX_PERIOD + 1;
+  TimeBase.initialize (&timerPeriod, 1);
+  CHECK_EQUAL (timerPeriod, TIMER_MAX_PERIOD);
+  timerPeriod = TIMER_MIN_PERIOD - 1;
+  TimeBase.calculate ();
+  CHECK_EQUAL (timerPeriod, TIMER_MIN_PERIOD);
+}
+
+
+TEST (timeBaseConverge) {
+  const double driftPpm = 50;
+  const uint32_t target = (uint32_t)lround (TIMER_DEFAULT_PERIOD * (1 + driftPpm * 1e-6));
+  uint32_t timerPeriod = TIMER_DEFAULT_PERIOD, last;
+  uint8_t i;
+
+  new (&TimeBase) TimeBaseClass ();
+  TimeBase.initialize (&timerPeriod, 1);
+  CHECK_EQUAL (TimeBase.syncInterval, 0);
+
+  // the first calibration is trusted almost entirely, a short one yields a low confidence
+  TimeBase.calibrate (1800, offsetUs (timerPeriod, driftPpm, 1800));
+  CHECK (labs ((long)timerPeriod - (long)target) < TIMER1_DIVIDER);
+  CHECK_EQUAL (TimeBase.syncInterval, DCF_SYNC_MIN_INTERVAL);
+
+  // daily calibrations: the confidence outweighs the crystal aging
+  for (i = 0; i < 10; i++) TimeBase.calibrate (ONE_DAY, offsetUs (timerPeriod, driftPpm, ONE_DAY));
+  CHECK (labs ((long)timerPeriod - (long)target) <= 1);
+  CHECK (TimeBase.driftVar < DRIFT_VAR_INIT / 10000);
+  CHECK_EQUAL (TimeBase.syncInterval, DCF_SYNC_MAX_INTERVAL);
+
+  // an edge jitter within a short measurement barely moves the converged estimate
+  last = timerPeriod;
+  TimeBase.calibrate (1800, offsetUs (timerPeriod, driftPpm, 1800) + DCF_EDGE_JITTER);
+  CHECK (labs ((long)timerPeriod - (long)last) < DCF_EDGE_JITTER * TIMER1_DIVIDER / 1800 / 10);
+  CHECK_EQUAL (TimeBase.correction, (long)timerPeriod - (long)last);
+
+  // a manual adjustment discards the confidence
+  TimeBase.reset ();
+  CHECK_EQUAL (TimeBase.driftVar, DRIFT_VAR_INIT);
+  CHECK_EQUAL (TimeBase.syncInterval, DCF_SYNC_MIN_INTERVAL);
+}
@@ -0,0 +1,99 @@
+/*
+ * Host replacement of the Arduino core
+ *
+ * Provides the subset of the Arduino API used by the firmware modules
+ * that are built on the host (see Host.h for the mock control functions).
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ARDUINO_H
+#define __ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+typedef uint8_t byte;
+
+#define HIGH         1
+#define LOW          0
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define CHANGE       1
+#define FALLING      2
+#define RISING       3
+
+#define NUM_DIGITAL_PINS 20
+
+
+/*
+ * Digital pins 0..7 are located on PORTD, 8..13 on PORTB and 14..19 on PORTC
+ * direct port register accesses are not reflected by the mocked pin levels
+ */
+#define PB 2
+#define PC 3
+#define PD 4
+#define digitalPinToPort(p)     (((p) <= 7) ? PD : (((p) <= 13) ? PB : PC))
+#define digitalPinToBitMask(p)  _BV(digitalPinToPCMSKbit (p))
+#define portOutputRegister(P)   (((P) == PB) ? &PORTB : (((P) == PC) ? &PORTC : &PORTD))
+#define digitalPinToPCICR(p)    (&PCICR)
+#define digitalPinToPCICRbit(p) (((p) <= 7) ? 2 : (((p) <= 13) ? 0 : 1))
+#define digitalPinToPCMSK(p)    ((((p) <= 7) ? (&PCMSK2) : (((p) <= 13) ? (&PCMSK0) : (&PCMSK1))))
+#define digitalPinToPCMSKbit(p) (((p) <= 7) ? (p) : (((p) <= 13) ? ((p) - 8) : ((p) - 14)))
+
+
+/*
+ * Mocked timing and I/O functions (see Host.cpp)
+ */
+uint32_t micros (void);
+uint32_t millis (void);
+void     delay (uint32_t ms);
+void     delayMicroseconds (uint16_t us);
+void     pinMode (uint8_t pin, uint8_t mode);
+void     digitalWrite (uint8_t pin, uint8_t value);
+int      digitalRead (uint8_t pin);
+
+inline long map (long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+
+/*
+ * avr-libc time.h extensions
+ * the host C library keeps the Unix epoch, mk_gmtime () matches gmtime_r ()
+ */
+#define ONE_HOUR    3600
+#define ONE_DAY     86400
+#define UNIX_OFFSET 946684800
+
+extern "C" time_t mk_gmtime (const struct tm *timeptr);
+
+
+#endif // __ARDUINO_H
@@ -0,0 +1,22 @@
+/*
+ * Host replacement of the Arduino EEPROM library
+ * accesses the mocked EEPROM cells (see Host.h)
+ */
+
+#ifndef __HOST_EEPROM_H
+#define __HOST_EEPROM_H
+
+#include <stdint.h>
+
+#define HOST_EEPROM_SIZE 1024
+
+struct EEPROMClass {
+  uint16_t length (void) { return HOST_EEPROM_SIZE; }
+  uint8_t  read (int idx);
+  void     write (int idx, uint8_t value);
+  void     update (int idx, uint8_t value) { if (read (idx) != value) write (idx, value); }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // __HOST_EEPROM_H
@@ -0,0 +1,308 @@
+/*
+ * Host mock layer of the microcontroller
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Host.h"
+
+#define SREG_I 0x80  // global interrupt enable bit
+
+/*
+ * Interrupt vectors of the firmware modules, not every module is linked into every binary
+ */
+extern "C" void EE_READY_vect (void) __attribute__((weak));
+extern "C" void PCINT2_vect (void) __attribute__((weak));
+extern "C" void TIMER0_COMPA_vect (void) __attribute__((weak));
+extern "C" void TIMER0_COMPB_vect (void) __attribute__((weak));
+
+
+volatile uint8_t SREG = SREG_I;
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t DDRB, DDRC, DDRD;
+volatile uint8_t PINB, PINC, PIND;
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0;
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t EEDR;
+volatile uint16_t EEAR;
+
+HostEecr    EECR;
+HostFlags   TIFR0;
+EEPROMClass EEPROM;
+
+
+static struct {
+  uint64_t now;                           // simulated time in µs
+  bool     inIsr;                         // an interrupt handler is being executed
+  uint8_t  pinMode[NUM_DIGITAL_PINS];
+  uint8_t  pinLevel[NUM_DIGITAL_PINS];
+  uint32_t pinToggles[NUM_DIGITAL_PINS];
+  bool     pinChange;                     // pin change interrupt pending
+  uint8_t  eeprom[HOST_EEPROM_SIZE];
+  bool     eeBusy;                        // EEPROM write cycle in progress
+  uint64_t eeDone;                        // end of the write cycle
+  uint16_t eeAddr;
+  uint8_t  eeData;
+  uint8_t  eeMode;                        // EEPM1..0 bits of the write cycle
+  uint32_t eeWrites;
+} H;
+
+
+static void eepromComplete (void) {
+  uint8_t *cell = &H.eeprom[H.eeAddr % HOST_EEPROM_SIZE];
+
+  if      (H.eeMode == 0) *cell  = H.eeData;  // erase and write
+  else if (H.eeMode == 1) *cell  = 0xFF;      // erase only
+  else                    *cell &= H.eeData;  // write only
+  H.eeBusy = false;
+  H.eeWrites++;
+  EECR.value &= ~_BV(EEPE);
+}
+
+
+/*
+ * Timer0 is only simulated while one of its compare match interrupts is enabled
+ */
+static bool timer0Active (void) {
+  return (TIMSK0 & (_BV(OCIE0A) | _BV(OCIE0B))) != 0;
+}
+
+
+static void timer0Tick (void) {
+  TCNT0++;
+  if (TCNT0 == OCR0A) TIFR0.value |= _BV(OCF0A);
+  if (TCNT0 == OCR0B) TIFR0.value |= _BV(OCF0B);
+}
+
+
+/*
+ * Deliver the interrupts that are due
+ */
+static void deliver (void) {
+  bool pending = true;
+
+  if (H.eeBusy && H.now >= H.eeDone) eepromComplete ();
+  if (H.inIsr || !(SREG & SREG_I)) return;
+
+  // interrupt handlers are executed with the interrupts disabled
+  while (pending) {
+    H.inIsr = true;
+    SREG   &= ~SREG_I;
+    if ((TIFR0.value & _BV(OCF0A)) && (TIMSK0 & _BV(OCIE0A)) && TIMER0_COMPA_vect) {
+      TIFR0.value &= ~_BV(OCF0A);
+      TIMER0_COMPA_vect ();
+    }
+    else if ((TIFR0.value & _BV(OCF0B)) && (TIMSK0 & _BV(OCIE0B)) && TIMER0_COMPB_vect) {
+      TIFR0.value &= ~_BV(OCF0B);
+      TIMER0_COMPB_vect ();
+    }
+    else if (H.pinChange && PCINT2_vect) {
+      H.pinChange = false;
+      PCINT2_vect ();
+    }
+    else if ((EECR.value & _BV(EERIE)) && !(EECR.value & _BV(EEPE)) && EE_READY_vect) {
+      EE_READY_vect ();
+    }
+    else {
+      pending = false;
+    }
+    SREG   |= SREG_I;
+    H.inIsr = false;
+  }
+}
+
+
+HostEecr &HostEecr::operator = (uint8_t v) {
+  // read strobe
+  if (v & _BV(EERE)) {
+    EEDR = H.eeprom[EEAR % HOST_EEPROM_SIZE];
+    v &= ~_BV(EERE);
+  }
+  // a write cycle is started by setting EEPE while EEMPE is set
+  if ((v & _BV(EEPE)) && !H.eeBusy) {
+    if (value & _BV(EEMPE)) {
+      H.eeBusy = true;
+      H.eeAddr = EEAR;
+      H.eeData = EEDR;
+      H.eeMode = (v >> EEPM0) & 3;
+      H.eeDone = H.now + (H.eeMode == 0 ? HOST_EEPROM_WRITE_US : H.eeMode == 1 ? HOST_EEPROM_ERASE_US : HOST_EEPROM_PROGRAM_US);
+      v &= ~_BV(EEMPE);
+    }
+    else {
+      v &= ~_BV(EEPE);
+    }
+  }
+  value = v;
+  return *this;
+}
+
+
+void hostReset (void) {
+  memset (&H, 0, sizeof (H));
+  memset (H.eeprom, 0xFF, sizeof (H.eeprom));
+  EECR.value  = 0;
+  TIFR0.value = 0;
+  SREG = SREG_I;
+  PCICR = PCIFR = PCMSK0 = PCMSK1 = PCMSK2 = 0;
+  TCCR0A = TCCR0B = TCNT0 = OCR0A = OCR0B = TIMSK0 = 0;
+  PORTB = PORTC = PORTD = DDRB = DDRC = DDRD = 0;
+}
+
+
+void hostAdvance (uint32_t us) {
+  uint64_t target = H.now + us, next, tick;
+
+  // step from event to event: EEPROM write cycle completion and Timer0 ticks
+  while (H.now < target) {
+    next = target;
+    if (H.eeBusy && H.eeDone < next) next = H.eeDone;
+    if (timer0Active ()) {
+      tick = (H.now / HOST_TIMER0_TICK_US + 1) * HOST_TIMER0_TICK_US;
+      if (tick < next) next = tick;
+    }
+    H.now = next;
+    if (timer0Active () && H.now % HOST_TIMER0_TICK_US == 0) timer0Tick ();
+    deliver ();
+  }
+  deliver ();
+}
+
+
+uint64_t hostMicros (void) {
+  return H.now;
+}
+
+
+void hostPinWrite (uint8_t pin, uint8_t value) {
+  value = (value != LOW);
+  if (pin >= NUM_DIGITAL_PINS || H.pinLevel[pin] == value) return;
+  H.pinLevel[pin] = value;
+  H.pinToggles[pin]++;
+  if (pin <= 7 && (PCICR & _BV(2)) && (PCMSK2 & _BV(pin))) {
+    H.pinChange = true;
+    deliver ();
+  }
+}
+
+
+uint8_t hostPinRead (uint8_t pin) {
+  return pin < NUM_DIGITAL_PINS ? H.pinLevel[pin] : LOW;
+}
+
+
+uint32_t hostPinToggles (uint8_t pin) {
+  return pin < NUM_DIGITAL_PINS ? H.pinToggles[pin] : 0;
+}
+
+
+bool hostPowerCut (void) {
+  bool aborted = H.eeBusy;
+  H.eeBusy   = false;
+  EECR.value = 0;
+  return aborted;
+}
+
+
+uint32_t hostEepromWrites (void) {
+  return H.eeWrites;
+}
+
+
+uint8_t *hostEeprom (void) {
+  return H.eeprom;
+}
+
+
+void hostCli (void) {
+  SREG &= ~SREG_I;
+}
+
+
+void hostSei (void) {
+  SREG |= SREG_I;
+  if (!H.inIsr) hostAdvance (HOST_CRITICAL_US);
+}
+
+
+uint32_t micros (void) {
+  return (uint32_t)H.now;
+}
+
+
+uint32_t millis (void) {
+  return (uint32_t)(H.now / 1000);
+}
+
+
+void delay (uint32_t ms) {
+  hostAdvance (ms * 1000);
+}
+
+
+void delayMicroseconds (uint16_t us) {
+  hostAdvance (us);
+}
+
+
+void pinMode (uint8_t pin, uint8_t mode) {
+  if (pin < NUM_DIGITAL_PINS) H.pinMode[pin] = mode;
+}
+
+
+void digitalWrite (uint8_t pin, uint8_t value) {
+  if (pin < NUM_DIGITAL_PINS && H.pinMode[pin] == OUTPUT) hostPinWrite (pin, value);
+}
+
+
+int digitalRead (uint8_t pin) {
+  return hostPinRead (pin);
+}
+
+
+uint8_t eeprom_read_byte (const uint8_t *addr) {
+  return H.eeprom[(uintptr_t)addr % HOST_EEPROM_SIZE];
+}
+
+
+bool eeprom_is_ready (void) {
+  // the CPU spins until the write cycle completes
+  if (H.eeBusy && H.eeDone > H.now) hostAdvance ((uint32_t)(H.eeDone - H.now));
+  return !(EECR.value & _BV(EEPE));
+}
+
+
+uint8_t EEPROMClass::read (int idx) {
+  return H.eeprom[idx % HOST_EEPROM_SIZE];
+}
+
+
+void EEPROMClass::write (int idx, uint8_t value) {
+  H.eeprom[idx % HOST_EEPROM_SIZE] = value;
+  H.eeWrites++;
+}
+
+
+extern "C" time_t mk_gmtime (const struct tm *timeptr) {
+  struct tm t = *timeptr;
+  return timegm (&t);
+}
@@ -0,0 +1,116 @@
+/*
+ * Host mock layer of the microcontroller
+ *
+ * Simulates the time base, the digital pins, the EEPROM and the interrupt
+ * delivery for running the firmware modules on the build host:
+ * - the time only advances by calling hostAdvance (), except for every
+ *   critical section (cli ()...sei ()) which takes HOST_CRITICAL_US
+ * - EEPROM writes take the ATmega328P cycle times and the EE_READY
+ *   interrupt is delivered as soon as the interrupts are enabled and
+ *   the EEPROM is ready
+ * - the pin change interrupt of PORTD is delivered upon hostPinWrite ()
+ *   of an input pin having its PCMSK2 bit set
+ * - Timer0 counts in steps of HOST_TIMER0_TICK_US and delivers its compare
+ *   match interrupts while at least one of them is enabled
+ * - EepromQueue.flush () spins forever, as the ISR cannot be delivered
+ *   from within a plain busy loop
+ *
+ * This source file is part of the Nixie Clock Arduino firmware
+ * found under http://www.github.com/microfarad-de/nixie-clock
+ *
+ * Please visit:
+ *   http://www.microfarad.de
+ *   http://www.github.com/microfarad-de
+ *
+ * Copyright (C) 2023 Karim Hraibi (khraibi at gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_H
+#define __HOST_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+/*
+ * Duration of a critical section in µs
+ * lets the busy waiting loops of the firmware advance the time
+ */
+#define HOST_CRITICAL_US      1
+
+/*
+ * Timer0 tick duration in µs (prescaler 64 as set by the Arduino core)
+ */
+#define HOST_TIMER0_TICK_US   (64000000UL / F_CPU)
+
+/*
+ * EEPROM cycle times in µs
+ */
+#define HOST_EEPROM_WRITE_US  3400  // erase and write
+#define HOST_EEPROM_ERASE_US  1800  // erase only
+#define HOST_EEPROM_PROGRAM_US 1800 // write only
+
+
+/*
+ * Reset the time base, the pins, the interrupt state and erase the EEPROM
+ */
+void hostReset (void);
+
+/*
+ * Advance the time, delivering the interrupts that become due
+ * Parameters:
+ *   us : number of µs
+ */
+void hostAdvance (uint32_t us);
+
+/*
+ * Current simulated time in µs
+ */
+uint64_t hostMicros (void);
+
+/*
+ * Set the level of an input pin
+ * Parameters:
+ *   pin   : digital pin
+ *   value : HIGH or LOW
+ */
+void hostPinWrite (uint8_t pin, uint8_t value);
+
+/*
+ * Level and number of transitions of an output pin
+ */
+uint8_t  hostPinRead (uint8_t pin);
+uint32_t hostPinToggles (uint8_t pin);
+
+/*
+ * Simulate a power cut
+ * aborts the ongoing EEPROM write cycle, the cell keeps its previous value
+ * Return value:
+ *   true if a write cycle has been aborted
+ */
+bool hostPowerCut (void);
+
+/*
+ * Number of completed EEPROM write cycles
+ */
+uint32_t hostEepromWrites (void);
+
+/*
+ * Direct access to the EEPROM cells, bypassing the timing model
+ */
+uint8_t *hostEeprom (void);
+
+
+#endif // __HOST_H
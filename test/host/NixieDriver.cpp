@@ -0,0 +1,9 @@
+/*
+ * Nixie tube display driver of the host build
+ * replaces the runtime pin map versions of the Timer0 ISRs and NixieClass::blank ()
+ * by the compile-time pin map of nixie-clock.ino, linked into the benchmark
+ */
+
+#include "NixieDriver.h"
+
+NIXIE_DRIVER (HostNixiePins)
@@ -0,0 +1,15 @@
+/*
+ * Nixie tube display driver of the host build
+ * uses the pin map of nixie-clock.ino
+ */
+
+#ifndef __HOST_NIXIE_DRIVER_H
+#define __HOST_NIXIE_DRIVER_H
+
+#include "../../NixiePinMap.h"
+
+typedef NixiePinMap<12, 11, 10, 7, 4, 2,  // anodes
+                    9, 6, 5, 8,           // BCD decoder
+                    13> HostNixiePins;    // comma
+
+#endif // __HOST_NIXIE_DRIVER_H
@@ -0,0 +1,15 @@
+/*
+ * Host replacement of avr/eeprom.h
+ */
+
+#ifndef __HOST_AVR_EEPROM_H
+#define __HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+
+uint8_t eeprom_read_byte (const uint8_t *addr);
+bool    eeprom_is_ready (void);
+
+#define eeprom_busy_wait() do {} while (!eeprom_is_ready ())
+
+#endif // __HOST_AVR_EEPROM_H
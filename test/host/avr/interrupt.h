@@ -0,0 +1,17 @@
+/*
+ * Host replacement of avr/interrupt.h
+ * interrupts are delivered synchronously by sei () and hostAdvance () (see Host.h)
+ */
+
+#ifndef __HOST_AVR_INTERRUPT_H
+#define __HOST_AVR_INTERRUPT_H
+
+#define ISR(vector, ...) extern "C" void vector (void) __VA_ARGS__; extern "C" void vector (void)
+
+void hostCli (void);
+void hostSei (void);
+
+#define cli() hostCli ()
+#define sei() hostSei ()
+
+#endif // __HOST_AVR_INTERRUPT_H
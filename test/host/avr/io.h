@@ -0,0 +1,75 @@
+/*
+ * Host replacement of avr/io.h
+ *
+ * The I/O registers are plain variables, except for the EEPROM control
+ * register whose accesses drive the mocked EEPROM and the Timer0 interrupt
+ * flag register (see Host.cpp).
+ */
+
+#ifndef __HOST_AVR_IO_H
+#define __HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+extern volatile uint8_t PINB, PINC, PIND;
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0;
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+extern volatile uint8_t EEDR;
+extern volatile uint16_t EEAR;
+
+// Timer0
+#define WGM00  0
+#define WGM01  1
+#define OCIE0A 1
+#define OCIE0B 2
+#define OCF0A  1
+#define OCF0B  2
+
+// EEPROM control register
+#define EERE   0
+#define EEPE   1
+#define EEMPE  2
+#define EERIE  3
+#define EEPM0  4
+#define EEPM1  5
+
+#define E2END  0x3FF
+
+
+/*
+ * EEPROM control register
+ * setting EERE reads the cell at EEAR into EEDR,
+ * setting EEPE after EEMPE starts a timed write cycle
+ */
+class HostEecr {
+  public:
+    operator uint8_t () const { return value; }
+    HostEecr &operator = (uint8_t v);
+    HostEecr &operator |= (uint8_t v) { return *this = value | v; }
+    HostEecr &operator &= (uint8_t v) { return *this = value & v; }
+    uint8_t value = 0;
+};
+
+extern HostEecr EECR;
+
+
+/*
+ * Interrupt flag register
+ * writing a one clears the corresponding flag
+ */
+class HostFlags {
+  public:
+    operator uint8_t () const { return value; }
+    HostFlags &operator = (uint8_t v) { value &= ~v; return *this; }
+    uint8_t value = 0;
+};
+
+extern HostFlags TIFR0;
+
+
+#endif // __HOST_AVR_IO_H
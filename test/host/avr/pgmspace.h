@@ -0,0 +1,21 @@
+/*
+ * Host replacement of avr/pgmspace.h
+ * flash memory is accessed like RAM
+ */
+
+#ifndef __HOST_AVR_PGMSPACE_H
+#define __HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr)   (*(void * const *)(addr))
+#define memcpy_P             memcpy
+
+#endif // __HOST_AVR_PGMSPACE_H
@@ -0,0 +1,17 @@
+/*
+ * Host replacement of avr/sleep.h
+ * sleeping returns immediately
+ */
+
+#ifndef __HOST_AVR_SLEEP_H
+#define __HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_PWR_DOWN 2
+
+inline void set_sleep_mode (uint8_t mode) { (void)mode; }
+inline void sleep_enable (void) { }
+inline void sleep_disable (void) { }
+inline void sleep_cpu (void) { }
+
+#endif // __HOST_AVR_SLEEP_H
@@ -0,0 +1,16 @@
+/*
+ * Host replacement of avr/wdt.h
+ */
+
+#ifndef __HOST_AVR_WDT_H
+#define __HOST_AVR_WDT_H
+
+#define WDTO_15MS 0
+#define WDTO_1S   6
+#define WDTO_4S   8
+
+inline void wdt_reset (void) { }
+inline void wdt_enable (uint8_t timeout) { (void)timeout; }
+inline void wdt_disable (void) { }
+
+#endif // __HOST_AVR_WDT_H
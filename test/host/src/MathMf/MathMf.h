@@ -0,0 +1,14 @@
+/*
+ * Host fallback of the MathMf library header
+ * only used if the MathMf submodule has not been checked out
+ */
+
+#ifndef __HOST_MATH_MF_H
+#define __HOST_MATH_MF_H
+
+#include <stdint.h>
+
+inline uint8_t dec2bcdLow  (uint8_t value) { return value % 10; }
+inline uint8_t dec2bcdHigh (uint8_t value) { return (value / 10) % 10; }
+
+#endif // __HOST_MATH_MF_H
@@ -0,0 +1,20 @@
+/*
+ * Host replacement of util/crc16.h
+ */
+
+#ifndef __HOST_UTIL_CRC16_H
+#define __HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+/*
+ * CRC-8 CCITT (polynomial 0x07), same as the avr-libc implementation
+ */
+inline uint8_t _crc8_ccitt_update (uint8_t crc, uint8_t data) {
+  uint8_t i;
+  crc ^= data;
+  for (i = 0; i < 8; i++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  return crc;
+}
+
+#endif // __HOST_UTIL_CRC16_H